@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+
+// Подсчёт выделений динамической памяти для тестов и бенчмарков.
+// Счётчик работает в программах, в которые скомпонован src/alloc_counter.cpp,
+// замещающий глобальный operator new
+namespace alloc_counter {
+
+// Возвращает количество вызовов operator new с момента запуска программы
+size_t Allocations();
+
+// Считает выделения памяти, выполненные за время жизни объекта
+class AllocationScope {
+public:
+    AllocationScope()
+        : start_(Allocations()) {
+    }
+
+    [[nodiscard]] size_t Count() const {
+        return Allocations() - start_;
+    }
+
+private:
+    size_t start_;
+};
+
+}  // namespace alloc_counter
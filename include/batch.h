@@ -0,0 +1,68 @@
+#pragma once
+
+#include "budget.h"
+#include "interpreter.h"
+#include "runtime.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace mython {
+
+// Задание пакетного запуска: программа из файла input выводит результат в файл output
+struct BatchJob {
+    std::filesystem::path input;
+    std::filesystem::path output;
+};
+
+/*
+ * Читает список заданий: по строке "<файл программы> <файл результата>" на задание.
+ * Пустые строки и строки, начинающиеся с #, пропускаются. Относительные пути
+ * отсчитываются от каталога base_directory.
+ * При ошибке в строке выбрасывает исключение runtime_error с номером строки
+ */
+[[nodiscard]] std::vector<BatchJob> ReadManifest(std::istream& input,
+                                                 const std::filesystem::path& base_directory);
+
+struct BatchOptions {
+    CompileOptions compile;
+    runtime::FlushPolicy flush = runtime::FlushPolicy::Threshold;
+    // количество потоков; 0 - по количеству ядер процессора
+    size_t threads = 0;
+    // статистика, к которой подключаются контексты всех заданий; nullptr - не собирается
+    runtime::ExecutionStats* stats = nullptr;
+    // пределы выполнения каждого задания; задание, превысившее предел, завершается с ошибкой
+    runtime::ExecutionLimits limits;
+};
+
+struct BatchReport {
+    size_t jobs = 0;
+    size_t failed = 0;
+    // количество различных программ, которые пришлось разобрать и скомпилировать
+    size_t compiled = 0;
+    // задания, выполненные не тем потоком, которому были назначены
+    size_t stolen = 0;
+    size_t threads = 0;
+    uint64_t source_bytes = 0;
+    std::chrono::nanoseconds elapsed{0};
+    // сообщения об ошибках заданий в порядке заданий; пустая строка - задание выполнено
+    std::vector<std::string> errors;
+
+    [[nodiscard]] double JobsPerSecond() const;
+};
+
+/*
+ * Выполняет задания jobs в пуле потоков. Каждое задание выполняется с собственными
+ * контекстом и областью видимости глобальных переменных. Программа, которая встречается
+ * в нескольких заданиях, разбирается и компилируется один раз, после чего её выполнения
+ * разделяют скомпилированную программу.
+ * Ошибка в одном задании не прерывает выполнение остальных
+ */
+[[nodiscard]] BatchReport RunBatch(const std::vector<BatchJob>& jobs, const BatchOptions& options);
+
+}  // namespace mython
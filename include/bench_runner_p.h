@@ -0,0 +1,141 @@
+#pragma once
+
+#include "alloc_counter_p.h"
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace BenchRunnerPrivate {
+// Возвращает наибольший объём резидентной памяти процесса с момента запуска в килобайтах
+// или 0, если на данной платформе он не измеряется
+inline uint64_t PeakRssKb() {
+#if defined(__unix__) || defined(__APPLE__)
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#if defined(__APPLE__)
+    // macOS сообщает ru_maxrss в байтах
+    return static_cast<uint64_t>(usage.ru_maxrss) / 1024;
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss);
+#endif
+#else
+    return 0;
+#endif
+}
+
+inline void WriteJsonString(std::ostream& os, std::string_view str) {
+    os << '"';
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            os << '\\';
+        }
+        os << c;
+    }
+    os << '"';
+}
+}  // namespace BenchRunnerPrivate
+
+// Простейший замер производительности: функция бенчмарка запускается iterations раз,
+// в поток ошибок выводится суммарное время, среднее время одной итерации, среднее
+// количество выделений памяти за итерацию и пиковый объём памяти процесса.
+// Если задан путь json_path, по завершении результаты записываются туда в формате JSON.
+// Если задан фильтр, запускаются только бенчмарки, имя которых содержит его как подстроку
+class BenchRunner {
+public:
+    struct Result {
+        std::string name;
+        uint64_t iterations = 0;
+        int64_t ns_per_op = 0;
+        uint64_t allocs_per_op = 0;
+        // пиковая память процесса после выполнения бенчмарка; не убывает от бенчмарка
+        // к бенчмарку, поэтому рост показывает бенчмарк, которому потребовалось больше памяти
+        uint64_t peak_rss_kb = 0;
+    };
+
+    BenchRunner() = default;
+    explicit BenchRunner(std::string json_path, std::string filter = {})
+        : json_path_(std::move(json_path)), filter_(std::move(filter)) {
+    }
+
+    template <class BenchFunc>
+    void RunBench(BenchFunc func, const std::string& bench_name, uint64_t iterations) {
+        using Clock = std::chrono::steady_clock;
+        if (bench_name.find(filter_) == std::string::npos) {
+            return;
+        }
+        try {
+            func();  // прогрев
+            alloc_counter::AllocationScope allocations;
+            auto start = Clock::now();
+            for (uint64_t i = 0; i < iterations; ++i) {
+                func();
+            }
+            auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start);
+            Result result{bench_name, iterations,
+                          elapsed.count() / static_cast<int64_t>(iterations),
+                          allocations.Count() / iterations, BenchRunnerPrivate::PeakRssKb()};
+            std::cerr << bench_name << ": " << iterations << " iterations, "
+                      << elapsed.count() / 1000000 << " ms, "
+                      << result.ns_per_op << " ns/op, "
+                      << result.allocs_per_op << " allocs/op, "
+                      << result.peak_rss_kb << " KB peak RSS" << std::endl;
+            results_.push_back(std::move(result));
+        } catch (std::exception& e) {
+            ++fail_count;
+            std::cerr << bench_name << " fail: " << e.what() << std::endl;
+        }
+    }
+
+    [[nodiscard]] const std::vector<Result>& GetResults() const {
+        return results_;
+    }
+
+    // Записывает результаты в os в формате JSON
+    void WriteJson(std::ostream& os) const {
+        os << "{\n  \"benchmarks\": [";
+        bool first = true;
+        for (const auto& result : results_) {
+            os << (first ? "\n" : ",\n") << "    {\"name\": ";
+            first = false;
+            BenchRunnerPrivate::WriteJsonString(os, result.name);
+            os << ", \"iterations\": " << result.iterations
+               << ", \"ns_per_op\": " << result.ns_per_op
+               << ", \"allocs_per_op\": " << result.allocs_per_op
+               << ", \"peak_rss_kb\": " << result.peak_rss_kb << "}";
+        }
+        os << "\n  ],\n  \"failed\": " << fail_count << "\n}\n";
+    }
+
+    ~BenchRunner() {
+        if (!json_path_.empty()) {
+            std::ofstream out(json_path_);
+            WriteJson(out);
+            if (!out) {
+                std::cerr << "Can't write " << json_path_ << std::endl;
+            }
+        }
+        if (fail_count > 0) {
+            std::cerr << fail_count << " benchmarks failed. Terminate" << std::endl;
+            exit(1);
+        }
+    }
+
+private:
+    std::string json_path_;
+    std::string filter_;
+    std::vector<Result> results_;
+    int fail_count = 0;
+};
+
+#define RUN_BENCH(br, func, iterations) br.RunBench(func, #func, iterations)
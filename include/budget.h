@@ -0,0 +1,166 @@
+#pragma once
+
+#include "stats.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+
+namespace runtime {
+
+// Исключение, которое выбрасывается, когда программа исчерпала один из пределов бюджета
+struct ExecutionLimitError : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+// Пределы выполнения одной программы. Нулевое значение означает отсутствие предела
+struct ExecutionLimits {
+    // шаги выполнения: интерпретатор дерева считает выполненные инструкции составных
+    // инструкций, VM при каждом входе в байт-код метода или программы - все его инструкции
+    uint64_t max_steps = 0;
+    // глубина вложенных вызовов методов; хвостовые вызовы глубину не увеличивают
+    size_t max_depth = 0;
+    // объём памяти строк и экземпляров классов, созданных и ещё не уничтоженных потоком,
+    // выполняющим программу
+    uint64_t max_heap_bytes = 0;
+    // время выполнения без учёта времени, проведённого в обработчике переключения
+    std::chrono::nanoseconds max_time{0};
+    // промежуток времени, через который вызывается обработчик переключения
+    std::chrono::nanoseconds time_slice{0};
+
+    [[nodiscard]] bool IsUnlimited() const {
+        return max_steps == 0 && max_depth == 0 && max_heap_bytes == 0 && max_time.count() == 0
+               && time_slice.count() == 0;
+    }
+};
+
+/*
+ * Бюджет выполнения программы, подключаемый к контексту методом Context::SetBudget.
+ * Точки проверки - вход в метод и каждая инструкция составной инструкции - обычно обходятся
+ * уменьшением счётчика шагов. Раз в CHECK_INTERVAL шагов бюджет проверяет время, объём памяти
+ * и запрос на остановку, а по истечении time_slice вызывает обработчик переключения:
+ * планировщик может в нём приостановить поток, чтобы дать выполниться другим программам,
+ * или прервать программу, выбросив исключение.
+ * Бюджет и объём памяти отсчитываются с момента создания, поэтому бюджет должен создаваться
+ * в потоке, который будет выполнять программу. Метод Cancel можно вызывать из любого потока
+ */
+class Budget {
+public:
+    static constexpr uint32_t CHECK_INTERVAL = 1024;
+
+    using YieldHandler = std::function<void()>;
+
+    explicit Budget(const ExecutionLimits& limits, YieldHandler on_yield = {});
+    Budget(const Budget&) = delete;
+    Budget& operator=(const Budget&) = delete;
+
+    // Учитывает count шагов выполнения
+    void Step(uint32_t count = 1) {
+        if (count < countdown_) {
+            countdown_ -= count;
+            return;
+        }
+        Check(count);
+    }
+
+    // Учитывает вход в метод. Выбрасывает ExecutionLimitError, если превышена глубина вызовов
+    void EnterCall() {
+        if (depth_ == max_depth_) {
+            Fail("Recursion depth limit exceeded");
+        }
+        ++depth_;
+        Step();
+    }
+
+    void LeaveCall() {
+        --depth_;
+    }
+
+    // Проверяет объём памяти вне периодической проверки. Вызывается после операций,
+    // которые могут выделить много памяти за один шаг
+    void CheckHeap() const {
+        if (GetHeapBytes() > max_heap_bytes_) {
+            Fail("Heap limit exceeded");
+        }
+    }
+
+    // Просит остановить программу: она завершится с ExecutionLimitError в ближайшей
+    // периодической проверке
+    void Cancel() {
+        cancelled_.store(true, std::memory_order_relaxed);
+    }
+
+    // Возвращает количество учтённых шагов выполнения
+    [[nodiscard]] uint64_t GetSteps() const {
+        return steps_ + (interval_ - countdown_);
+    }
+
+    // Возвращает текущую глубину вызовов методов
+    [[nodiscard]] size_t GetDepth() const {
+        return depth_;
+    }
+
+    // Возвращает объём памяти объектов, созданных потоком с момента создания бюджета
+    // и ещё не уничтоженных
+    [[nodiscard]] uint64_t GetHeapBytes() const {
+        int64_t bytes = heap_bytes - heap_base_;
+        return bytes > 0 ? static_cast<uint64_t>(bytes) : 0;
+    }
+
+    // Возвращает время выполнения без учёта времени, проведённого в обработчике переключения
+    [[nodiscard]] std::chrono::nanoseconds GetElapsed() const;
+
+    // Учитывает вход в метод и его завершение, в том числе исключением
+    class CallScope {
+    public:
+        explicit CallScope(Budget& budget)
+            : budget_(budget) {
+            budget_.EnterCall();
+        }
+        ~CallScope() {
+            budget_.LeaveCall();
+        }
+
+        CallScope(const CallScope&) = delete;
+        CallScope& operator=(const CallScope&) = delete;
+
+    private:
+        Budget& budget_;
+    };
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // Периодическая проверка: учитывает шаги интервала и count, проверяет все пределы
+    // и при необходимости вызывает обработчик переключения
+    void Check(uint32_t count);
+    // Начинает следующий интервал шагов, не выходящий за предел шагов
+    void StartInterval();
+    [[noreturn]] static void Fail(const char* message);
+
+    uint64_t max_steps_;
+    size_t max_depth_;
+    uint64_t max_heap_bytes_;
+    std::chrono::nanoseconds max_time_;
+    std::chrono::nanoseconds time_slice_;
+    YieldHandler on_yield_;
+
+    // шаги, учтённые до начала текущего интервала
+    uint64_t steps_ = 0;
+    // длина текущего интервала и количество шагов до его окончания
+    uint32_t interval_ = 0;
+    uint32_t countdown_ = 0;
+    size_t depth_ = 0;
+    int64_t heap_base_;
+
+    Clock::time_point start_;
+    Clock::time_point next_yield_;
+    // время, проведённое в обработчике переключения
+    Clock::duration paused_{0};
+    std::atomic<bool> cancelled_{false};
+};
+
+}  // namespace runtime
@@ -0,0 +1,196 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ast {
+class Statement;
+}
+
+namespace vm {
+
+/*
+ * Набор инструкций стековой виртуальной машины Mython.
+ * В комментарии указано действие инструкции над стеком и смысл операндов a и b
+ */
+#define MYTHON_OPCODES(X)                                                              \
+    X(Const)          /* -> constants[a] */                                           \
+    X(None)           /* -> None */                                                   \
+    X(True)           /* -> True */                                                   \
+    X(False)          /* -> False */                                                  \
+    X(LoadGlobal)     /* -> closure[names[a]] */                                      \
+    X(StoreGlobal)    /* value -> value, closure[names[a]] = value */                 \
+    X(LoadLocal)      /* -> locals[a], names[b] - имя переменной для сообщений */     \
+    X(StoreLocal)     /* value -> value, locals[a] = value */                         \
+    X(LoadField)      /* object -> object.names[a], names[b] - имя объекта */         \
+    X(StoreField)     /* object value -> value, object.names[a] = value */            \
+    X(Pop)            /* value -> */                                                  \
+    X(Add)            /* lhs rhs -> lhs + rhs */                                      \
+    X(Sub)            /* lhs rhs -> lhs - rhs */                                      \
+    X(Mult)           /* lhs rhs -> lhs * rhs */                                      \
+    X(Div)            /* lhs rhs -> lhs / rhs */                                      \
+    X(Equal)          /* lhs rhs -> lhs == rhs */                                     \
+    X(NotEqual)       /* lhs rhs -> lhs != rhs */                                     \
+    X(Less)           /* lhs rhs -> lhs < rhs */                                      \
+    X(Greater)        /* lhs rhs -> lhs > rhs */                                      \
+    X(LessOrEqual)    /* lhs rhs -> lhs <= rhs */                                     \
+    X(GreaterOrEqual) /* lhs rhs -> lhs >= rhs */                                     \
+    X(Compare)        /* lhs rhs -> comparators[a](lhs, rhs) */                       \
+    X(Not)            /* value -> not value */                                        \
+    X(ToBool)         /* value -> Bool(value) */                                      \
+    X(Jump)           /* переход на инструкцию a */                                   \
+    X(JumpIfFalse)    /* value -> , переход на a, если value ложно */                 \
+    X(JumpIfTrue)     /* value -> , переход на a, если value истинно */               \
+    X(PrintSpace)     /* выводит разделитель аргументов print */                      \
+    X(PrintItem)      /* value -> , выводит value */                                  \
+    X(PrintEnd)       /* -> None, выводит конец строки */                             \
+    X(Stringify)      /* value -> str(value) */                                       \
+    X(CallMethod)     /* object arg1..argb -> object.names[a](arg1..argb) */          \
+    X(TailCall)       /* object arg1..argb -> , завершает метод вызовом CallMethod */ \
+    X(NewInstance)    /* -> новый экземпляр classes[a] */                             \
+    X(Construct)      /* object arg1..arga -> object, вызывает object.__init__ */     \
+    X(DefineClass)    /* -> None, closure[names[b]] = constants[a] */                 \
+    X(Return)         /* value -> , завершает метод, возвращая value */               \
+    X(ReturnNone)     /* завершает метод, возвращая None */
+
+enum class OpCode : uint8_t {
+#define MYTHON_OPCODE_ENUM(name) name,
+    MYTHON_OPCODES(MYTHON_OPCODE_ENUM)
+#undef MYTHON_OPCODE_ENUM
+};
+
+// Возвращает имя инструкции
+const char* OpCodeName(OpCode op);
+
+// Инструкция байт-кода: код операции и до двух целочисленных операндов
+struct Instruction {
+    OpCode op;
+    uint32_t a = 0;
+    uint32_t b = 0;
+};
+
+using Comparator = std::function<bool(const runtime::ObjectHolder&, const runtime::ObjectHolder&,
+                                      runtime::Context&)>;
+
+// Единица компиляции: тело метода либо программа верхнего уровня
+struct Chunk {
+    std::vector<Instruction> code;
+    std::vector<runtime::ObjectHolder> constants;
+    std::vector<runtime::Symbol> names;
+    std::vector<const runtime::Class*> classes;
+    std::vector<Comparator> comparators;
+    // Кол-во локальных переменных (включая self и параметры). Для программы верхнего уровня
+    // равно нулю - её переменные хранятся в Closure
+    uint32_t locals_count = 0;
+    // Кол-во параметров метода (без self)
+    uint32_t params_count = 0;
+    // Максимальная глубина стека вычислений
+    uint32_t max_stack = 0;
+    // Кэши обращений к полям объектов, индексируются позицией инструкции LoadField или
+    // StoreField в code. Обновляются во время исполнения
+    mutable std::vector<runtime::FieldCache> field_caches;
+    // Кэши вызовов методов, индексируются позицией инструкции CallMethod, TailCall
+    // или Construct в code
+    mutable std::vector<runtime::MethodCache> method_caches;
+};
+
+// Скомпилированная программа. После компиляции не изменяется
+class Program {
+public:
+    // Возвращает байт-код программы верхнего уровня
+    [[nodiscard]] const Chunk& Main() const;
+
+    // Возвращает байт-код тела метода либо nullptr, если тело метода не было скомпилировано
+    [[nodiscard]] const Chunk* FindMethod(const runtime::Executable* body) const;
+
+    // Выводит в os листинг байт-кода программы
+    void Disassemble(std::ostream& os) const;
+
+private:
+    friend class Compiler;
+
+    Chunk main_;
+    std::vector<std::unique_ptr<Chunk>> methods_;
+    std::unordered_map<const runtime::Executable*, const Chunk*> method_index_;
+};
+
+/*
+ * Компилятор синтаксического дерева в байт-код.
+ * Каждый узел AST генерирует код для себя в методе ast::Statement::Compile, пользуясь
+ * методами компилятора. Сгенерированный узлом код оставляет на стеке ровно одно значение
+ */
+class Compiler {
+public:
+    // Компилирует программу верхнего уровня, построенную функцией ParseProgram
+    [[nodiscard]] static Program Compile(const ast::Statement& program);
+
+    // Добавляет в стек константу value
+    void EmitConstant(runtime::ObjectHolder value);
+    // Добавляет в код инструкцию op с операндами a и b
+    void Emit(OpCode op, uint32_t a = 0, uint32_t b = 0);
+
+    // Генерирует код узла node, оставляющий его значение на стеке
+    void CompileExpression(const ast::Statement& node);
+    // Генерирует код узла node, значение которого не используется
+    void CompileStatement(const ast::Statement& node);
+
+    // Генерирует загрузку переменной name и цепочки её полей tail
+    void CompileVariable(runtime::Symbol name, const std::vector<runtime::Symbol>& tail);
+    // Генерирует сохранение значения с вершины стека в переменную name
+    void CompileStore(runtime::Symbol name);
+    // Генерирует сохранение значения rv в поле field объекта, находящегося на вершине стека
+    void CompileFieldStore(runtime::Symbol field, const ast::Statement& rv);
+    // Генерирует вызов метода method у объекта, находящегося на вершине стека
+    void CompileCall(runtime::Symbol method,
+                     const std::vector<std::unique_ptr<ast::Statement>>& args);
+    // Генерирует создание экземпляра класса cls с вызовом __init__, если он есть
+    void CompileNewInstance(const runtime::Class& cls,
+                            const std::vector<std::unique_ptr<ast::Statement>>& args);
+    // Генерирует объявление класса, компилируя тела его методов
+    void CompileClassDefinition(const runtime::ObjectHolder& cls);
+    // Генерирует вывод значений args командой print
+    void CompilePrint(const std::vector<std::unique_ptr<ast::Statement>>& args);
+    // Генерирует сравнение двух значений с вершины стека
+    void CompileComparison(const Comparator& cmp);
+    // Генерирует ветвление
+    void CompileIfElse(const ast::Statement& condition, const ast::Statement& if_body,
+                       const ast::Statement* else_body);
+    // Генерирует логические операции с вычислением по короткой схеме
+    void CompileOr(const ast::Statement& lhs, const ast::Statement& rhs);
+    void CompileAnd(const ast::Statement& lhs, const ast::Statement& rhs);
+
+private:
+    Compiler(Program& program, Chunk& chunk);
+    Compiler(Program& program, Chunk& chunk, const runtime::Method& method);
+
+    // Возвращает индекс имени name в таблице имён
+    uint32_t NameIndex(runtime::Symbol name);
+    // Возвращает индекс локальной переменной name, добавляя её при необходимости
+    uint32_t LocalIndex(runtime::Symbol name);
+    // Добавляет инструкцию перехода и возвращает её позицию для последующего исправления
+    size_t EmitJump(OpCode op);
+    // Направляет переход, добавленный в позиции at, на следующую инструкцию
+    void PatchJump(size_t at);
+    // Учитывает изменение глубины стека
+    void AdjustStack(int delta);
+
+    Program& program_;
+    Chunk& chunk_;
+    bool in_method_ = false;
+    std::unordered_map<runtime::Symbol, uint32_t> names_;
+    std::unordered_map<runtime::Symbol, uint32_t> locals_;
+    int stack_depth_ = 0;
+    // Позиция, на которую может указывать переход. Инструкции перед ней нельзя удалять
+    size_t jump_target_ = 0;
+};
+
+// Компилирует программу верхнего уровня. Эквивалентно Compiler::Compile(program)
+[[nodiscard]] Program Compile(const ast::Statement& program);
+
+}  // namespace vm
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace runtime {
+
+class ClassInstance;
+
+// Параметры запуска сборщика циклических ссылок
+struct CollectorOptions {
+    // сборщик запускается автоматически при создании экземпляров классов
+    bool enabled = true;
+    // наименьшее количество новых экземпляров между двумя сборками
+    size_t threshold = 10000;
+    // следующая сборка начинается не раньше, чем количество отслеживаемых экземпляров вырастет
+    // на growth_percent процентов от количества, оставшегося после предыдущей сборки.
+    // Благодаря этому суммарное время сборок пропорционально количеству созданных экземпляров
+    size_t growth_percent = 100;
+};
+
+struct CollectorStats {
+    uint64_t collections = 0;
+    // экземпляры, уничтоженные сборщиком
+    uint64_t collected = 0;
+    // экземпляры, которые отслеживаются в данный момент
+    size_t tracked = 0;
+    std::chrono::nanoseconds total_pause{0};
+    std::chrono::nanoseconds max_pause{0};
+    std::chrono::nanoseconds last_pause{0};
+};
+
+/*
+ * Сборщик циклических ссылок между экземплярами классов. Время жизни объектов определяется
+ * счётчиком ссылок, а сборщик дополнительно находит экземпляры, которые удерживают друг
+ * друга (например, после a.peer = b и b.peer = a), но недоступны программе, и уничтожает их.
+ *
+ * У каждого потока собственный сборщик, который отслеживает экземпляры, созданные потоком
+ * методом Class::CreateInstance. Экземпляр, помеченный методом ShareWithThreads,
+ * перестаёт отслеживаться, поэтому циклы из объектов, доступных нескольким потокам,
+ * не собираются. При сборке с MYTHON_ATOMIC_REFCOUNT экземпляры не отслеживаются.
+ *
+ * Сборка выполняется так же, как в CPython: из счётчика ссылок каждого экземпляра
+ * вычитаются ссылки из полей других отслеживаемых экземпляров. Экземпляры, у которых
+ * остались внешние ссылки, и всё, что из них достижимо, продолжают жить, у остальных
+ * очищаются поля, после чего их уничтожает счётчик ссылок
+ */
+class CycleCollector {
+public:
+    CycleCollector() = default;
+    CycleCollector(const CycleCollector&) = delete;
+    CycleCollector& operator=(const CycleCollector&) = delete;
+    // Перестаёт отслеживать оставшиеся экземпляры
+    ~CycleCollector();
+
+    // Возвращает сборщик текущего потока
+    static CycleCollector& ForCurrentThread();
+
+    void SetOptions(const CollectorOptions& options);
+
+    [[nodiscard]] const CollectorOptions& GetOptions() const {
+        return options_;
+    }
+
+    // Уничтожает недоступные программе экземпляры и возвращает их количество
+    size_t Collect();
+
+    [[nodiscard]] CollectorStats GetStats() const;
+
+    // Вызывается перед созданием экземпляра и при необходимости запускает сборку
+    void BeforeAllocation() {
+        if (tracked_count_ >= next_collection_ && options_.enabled) {
+            Collect();
+        }
+    }
+
+    // Начинает отслеживать экземпляр instance
+    void Track(const ClassInstance& instance);
+    // Перестаёт отслеживать экземпляр instance
+    void Untrack(const ClassInstance& instance);
+
+private:
+    void ScheduleNext();
+
+    CollectorOptions options_;
+    // отслеживаемые экземпляры образуют двусвязный список
+    const ClassInstance* head_ = nullptr;
+    size_t tracked_count_ = 0;
+    size_t next_collection_ = CollectorOptions{}.threshold;
+    bool collecting_ = false;
+    CollectorStats stats_;
+};
+
+}  // namespace runtime
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "optimizer.h"
+#include "runtime.h"
+
+#include <filesystem>
+#include <memory>
+#include <string_view>
+
+namespace ast {
+class Statement;
+}
+
+namespace vm {
+class Program;
+}
+
+/*
+ * Интерфейс для встраивания интерпретатора Mython в другие программы (библиотека libmython).
+ * Программа компилируется один раз функцией Compile и затем может многократно выполняться
+ * функцией Run, в том числе одновременно в нескольких потоках. Каждое выполнение использует
+ * собственные контекст и область видимости
+ */
+namespace mython {
+
+// Способ исполнения программы
+enum class Engine {
+    Ast,  // интерпретатор синтаксического дерева
+    Vm,   // компиляция в байт-код и исполнение виртуальной машиной
+};
+
+struct CompileOptions {
+    Engine engine = Engine::Ast;
+    opt::Level optimization = opt::Level::O1;
+    // каталог кэша разобранных программ; пустой путь - кэш не используется
+    std::filesystem::path cache_directory;
+    // количество потоков разбора (см. ParseProgramParallel); 0 - по количеству ядер процессора,
+    // 1 - последовательный разбор. Кэш программ разбирает программы последовательно
+    size_t parse_threads = 1;
+};
+
+/*
+ * Скомпилированная программа. После создания не изменяется, кроме кэшей мест обращения
+ * к полям и методам, которые безопасно обновлять из нескольких потоков.
+ * Классы, объявленные в программе, разделяются всеми её выполнениями
+ */
+class Program {
+public:
+    // Создаёт программу из дерева tree, построенного функцией ParseProgram:
+    // оптимизирует дерево и при необходимости компилирует его в байт-код
+    Program(std::unique_ptr<ast::Statement> tree, const CompileOptions& options);
+
+    Program(Program&&) noexcept;
+    Program& operator=(Program&&) noexcept;
+    ~Program();
+
+    [[nodiscard]] Engine GetEngine() const {
+        return engine_;
+    }
+
+    // Выполняет программу, используя closure для хранения её глобальных переменных
+    void Run(runtime::Context& context, runtime::Closure& closure) const;
+
+private:
+    Engine engine_;
+    std::unique_ptr<ast::Statement> tree_;
+    // байт-код программы; nullptr, если она исполняется интерпретатором дерева
+    std::unique_ptr<vm::Program> bytecode_;
+};
+
+// Разбирает и компилирует программу с текстом source.
+// Ошибки разбора сообщаются исключениями parse::LexerError и ParseError
+[[nodiscard]] Program Compile(std::string_view source, const CompileOptions& options = {});
+
+// Выполняет программу program в контексте context. Эквивалентно program.Run(context, closure).
+// Значения, которые передаются через closure выполнениям в разных потоках, должны быть
+// предварительно помечены методом ObjectHolder::ShareWithThreads
+void Run(const Program& program, runtime::Context& context, runtime::Closure& closure);
+
+}  // namespace mython
@@ -1,11 +1,16 @@
 #pragma once
 
+#include "symbol.h"
+
+#include <cstdint>
+#include <deque>
+#include <filesystem>
 #include <iosfwd>
 #include <optional>
 #include <sstream>
 #include <stdexcept>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <variant>
 
 namespace parse {
@@ -15,16 +20,19 @@ struct Number {  // Лексема «число»
     int value;   // число
 };
 
-struct Id {             // Лексема «идентификатор»
-    std::string value;  // Имя идентификатора
+struct Id {                 // Лексема «идентификатор»
+    runtime::Symbol value;  // Интернированное имя идентификатора
 };
 
 struct Char {    // Лексема «символ»
     char value;  // код символа
 };
 
+// Значение ссылается на исходный текст (либо, для строк с экранированными символами,
+// на буфер лексера) и действительно, пока живы лексер и исходный текст. Если лексер читает
+// поток, значение действительно только до получения следующей лексемы
 struct String {  // Лексема «строковая константа»
-    std::string value;
+    std::string_view value;
 };
 
 struct Class {};    // Лексема «class»
@@ -88,9 +96,32 @@ public:
     using std::runtime_error::runtime_error;
 };
 
+// Исходный текст программы, отображённый в память. Там, где отображение файлов недоступно,
+// файл целиком считывается в память
+class MappedSource {
+public:
+    explicit MappedSource(const std::filesystem::path& path);
+    MappedSource(const MappedSource&) = delete;
+    MappedSource& operator=(const MappedSource&) = delete;
+    ~MappedSource();
+
+    [[nodiscard]] std::string_view View() const {
+        return {data_, size_};
+    }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    std::string buffer_;  // содержимое файла, если отображение недоступно
+};
+
 class Lexer {
 public:
+    // Разбирает поток, считывая его построчно по мере необходимости. Строка читается только
+    // тогда, когда требуется следующая за концом предыдущей строки лексема
     explicit Lexer(std::istream& input);
+    // Разбирает текст без копирования. Текст должен жить дольше лексера и полученных лексем
+    explicit Lexer(std::string_view source);
 
     // Возвращает ссылку на текущий токен или token_type::Eof, если поток токенов закончился
     [[nodiscard]] const Token& CurrentToken() const;
@@ -138,7 +169,11 @@ public:
     }
 
 private:
-    std::istream &input_;
+    std::istream* input_ = nullptr; // поток с исходным текстом или nullptr при разборе буфера
+    std::string buffer_; // текущая строка, считанная из потока
+    const char* pos_; // текущая позиция в исходном тексте
+    const char* end_; // конец исходного текста
+    std::deque<std::string> unescaped_; // строковые константы с экранированными символами
     bool start_of_line_ = true; // Является ли текущая лексема первой на строке
     uint32_t current_indent_ = 0; // текущий отступ
     uint32_t line_indent_ = 0; // кол-во отступов в начале текущей строки
@@ -146,6 +181,9 @@ private:
 
     // считывает следующий токен из потока и сохраняет его его в current_token_
     void ReadNextToken();
+    // считывает из потока следующую строку, заменяя ею буфер либо дописывая её в конец буфера.
+    // Возвращает false, если поток закончился или лексер разбирает буфер
+    bool ReadInputLine(bool append);
     // переход к следующей строке
     void NextLine();
     // обрабатывает комментарий
@@ -162,6 +200,8 @@ private:
     void ParseToken();
     // обрабатывает имя (ключевое слово либо идентификатор)
     void ParseName();
+    // обрабатывает строковую константу
+    void ParseString();
     // обрабатывает символ
     void ParseChar();
 };
@@ -170,29 +210,10 @@ private:
 
 namespace util {
 
-static std::unordered_map<std::string, parse::Token> KeyWords =
-{
- {"class",   parse::token_type::Class{}},
- {"return",  parse::token_type::Return{}},
- {"if",      parse::token_type::If{}},
- {"else",    parse::token_type::Else{}},
- {"def",     parse::token_type::Def{}},
- {"print",   parse::token_type::Print{}},
- {"and",     parse::token_type::And{}},
- {"or",      parse::token_type::Or{}},
- {"not",     parse::token_type::Not{}},
- {"None",    parse::token_type::None{}},
- {"True",    parse::token_type::True{}},
- {"False",   parse::token_type::False{}}
-};
-
-static std::unordered_map<std::string, parse::Token> DualSymbols =
-{
- {"==",  parse::token_type::Eq{}},
- {"!=",  parse::token_type::NotEq{}},
- {">=",  parse::token_type::GreaterOrEq{}},
- {"<=",  parse::token_type::LessOrEq{}}
-};
+// возвращает лексему ключевого слова, либо nullopt, если name - не ключевое слово
+std::optional<parse::Token> FindKeyWord(std::string_view name);
+// возвращает лексему оператора из двух символов, либо nullopt, если такого оператора нет
+std::optional<parse::Token> FindDualSymbol(char first, char second);
 
 // проверяет является ли символ цифрой
 bool IsNum(char ch);
@@ -202,15 +223,21 @@ bool IsAlpha(char ch);
 bool IsAlNum(char ch);
 // проверяет является ли символ цифрой буквой или знаком подчёркивания
 bool IsAlNumLL(char ch);
-// считывает строку от открывающейся кавычки до закрывающейся кавычки с учётом экранированных символов
-std::string ReadString(std::istream &input);
+// Функции ниже читают текст из диапазона [pos, end) и сдвигают pos за прочитанные символы
+
+// считывает строку от открывающейся кавычки до закрывающейся кавычки и возвращает её содержимое
+// без кавычек. Экранированные символы остаются как есть, has_escapes сообщает об их наличии.
+// Если закрывающей кавычки нет, возвращает nullopt и оставляет pos без изменений
+std::optional<std::string_view> ReadString(const char*& pos, const char* end, bool& has_escapes);
+// заменяет экранированные символы в содержимом строки
+std::string Unescape(std::string_view raw);
 // считывает идентификатор, состоящий из букв, цифр и символов подчеркивания
-std::string ReadName(std::istream &input);
+std::string_view ReadName(const char*& pos, const char* end);
 // считывает целое число
-int ReadNumber(std::istream &input);
+int ReadNumber(const char*& pos, const char* end);
 // считает все подряд идущих пробелы в строке и возвращает их кол-во
-size_t CountSpaces(std::istream &input);
+size_t CountSpaces(const char*& pos, const char* end);
 // считывает строку целиком
-std::string ReadLine(std::istream &input);
+std::string_view ReadLine(const char*& pos, const char* end);
 
 } // namespace util
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace ast {
+class Statement;
+}
+
+namespace opt {
+
+// Уровень оптимизации программы
+enum class Level {
+    O0,  // дерево исполняется в том виде, в каком построено при разборе
+    O1,  // свёртка константных выражений и удаление недостижимых веток if
+};
+
+using Comparator = std::function<bool(const runtime::ObjectHolder&, const runtime::ObjectHolder&,
+                                      runtime::Context&)>;
+
+/*
+ * Оптимизатор синтаксического дерева. Каждый узел AST упрощает себя в методе
+ * ast::Statement::Optimize, пользуясь методами оптимизатора: сначала оптимизирует дочерние
+ * узлы, затем, если все операнды оказались константами, вычисляет своё значение.
+ * Выражение, вычисление которого завершается ошибкой (например, делением на ноль),
+ * не сворачивается, чтобы ошибка возникла при выполнении программы, как и без оптимизации
+ */
+class Optimizer {
+public:
+    // Оптимизирует программу, построенную функцией ParseProgram или StatementParser,
+    // включая тела методов объявленных в ней классов. Возвращает количество упрощений
+    static size_t Run(std::unique_ptr<ast::Statement>& program, Level level = Level::O1);
+
+    // Оптимизирует узел node, заменяя его упрощённым, если это возможно
+    void Optimize(std::unique_ptr<ast::Statement>& node);
+    // Оптимизирует каждый узел списка
+    void Optimize(std::vector<std::unique_ptr<ast::Statement>>& nodes);
+    // Оптимизирует тела методов класса cls
+    void OptimizeClass(runtime::Class& cls);
+
+    // Возвращает значение узла node, если он является константой
+    [[nodiscard]] static std::optional<runtime::ObjectHolder> ConstantValue(
+        const ast::Statement& node);
+    // Возвращает true, если узел node является константой
+    [[nodiscard]] static bool IsConstant(const ast::Statement& node) {
+        return ConstantValue(node).has_value();
+    }
+    // Возвращает true, если cmp - стандартная функция сравнения без побочных эффектов
+    [[nodiscard]] static bool IsPure(const Comparator& cmp);
+
+    // Вычисляет узел node, операнды которого - константы, и возвращает константу с его
+    // значением. Если вычисление завершилось ошибкой, возвращает nullptr
+    [[nodiscard]] std::unique_ptr<ast::Statement> Evaluate(ast::Statement& node);
+    // Возвращает узел-константу со значением value, заменяющую свёрнутое выражение
+    [[nodiscard]] std::unique_ptr<ast::Statement> Fold(const runtime::ObjectHolder& value);
+    // Возвращает ветку branch, заменяющую ветвление с константным условием.
+    // Если ветки нет, возвращает узел None
+    [[nodiscard]] std::unique_ptr<ast::Statement> Prune(std::unique_ptr<ast::Statement> branch);
+
+private:
+    Optimizer() = default;
+
+    // контекст и область видимости, в которых вычисляются константные выражения
+    runtime::DummyContext context_;
+    runtime::Closure closure_;
+    size_t simplified_ = 0;
+};
+
+// Оптимизирует программу. Эквивалентно Optimizer::Run(program, level)
+size_t Optimize(std::unique_ptr<ast::Statement>& program, Level level = Level::O1);
+
+}  // namespace opt
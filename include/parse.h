@@ -1,18 +1,60 @@
 #pragma once
 
+#include <cstddef>
 #include <memory>
 #include <stdexcept>
+#include <string_view>
 
 namespace parse {
 class Lexer;
 }
 
-namespace runtime {
-class Executable;
+namespace ast {
+class Statement;
 }
 
 struct ParseError : std::runtime_error {
     using std::runtime_error::runtime_error;
 };
 
-std::unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer);
\ No newline at end of file
+// Разбирает программу. Узлы дерева размещаются в арене, которой владеет возвращаемый
+// корневой узел (ast::Program); тела методов классов программы также удерживают арену
+std::unique_ptr<ast::Statement> ParseProgram(parse::Lexer& lexer);
+
+// Наименьший размер части программы при параллельном разборе
+inline constexpr size_t PARALLEL_PARSE_CHUNK_SIZE = 64 * 1024;
+
+/*
+ * Разбирает программу source в thread_count потоках (0 - по количеству ядер процессора)
+ * и возвращает то же дерево, что и ParseProgram. Текст делится на части не короче
+ * min_chunk_size по строкам без отступа, с которых начинаются инструкции верхнего уровня,
+ * и части разбираются независимо. Классы создаются, а ссылки на них (базовые классы
+ * и создание экземпляров) разрешаются при последовательном связывании частей, поэтому
+ * класс, как и при последовательном разборе, доступен только после своего объявления.
+ * Из нескольких ошибок сообщается та, которую обнаружил бы последовательный разбор.
+ * Небольшие программы, программы, объявляющие класс str, а также разбор в одном потоке
+ * выполняются последовательно
+ */
+std::unique_ptr<ast::Statement> ParseProgramParallel(
+    std::string_view source, size_t thread_count = 0,
+    size_t min_chunk_size = PARALLEL_PARSE_CHUNK_SIZE);
+
+// Разбирает программу по одной инструкции верхнего уровня, что позволяет выполнять каждую
+// инструкцию сразу после разбора. Классы, объявленные в уже разобранных инструкциях,
+// доступны в последующих
+class StatementParser {
+public:
+    explicit StatementParser(parse::Lexer& lexer);
+    StatementParser(const StatementParser&) = delete;
+    StatementParser& operator=(const StatementParser&) = delete;
+    ~StatementParser();
+
+    // Возвращает следующую инструкцию верхнего уровня или nullptr, если программа закончилась.
+    // Каждая инструкция размещается в собственной арене, поэтому выполненную инструкцию
+    // можно сразу уничтожить
+    std::unique_ptr<ast::Statement> ParseNext();
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+};
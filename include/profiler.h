@@ -0,0 +1,107 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace runtime {
+
+/*
+ * Профилировщик вызовов методов Mython-программы. Подключается к контексту методом
+ * Context::SetProfiler; пока он не подключён, вызовы методов выполняются без замеров.
+ * Для каждого метода (Класс.метод, где класс - тот, в котором метод объявлен) считает
+ * количество вызовов, общее время (вместе с вложенными вызовами, без повторного учёта
+ * рекурсии), собственное время и количество созданных объектов.
+ * Кроме того, строит дерево вызовов, которое выводится в формате свёрнутых стеков,
+ * принимаемом flamegraph.pl и аналогичными инструментами
+ */
+class Profiler {
+public:
+    struct MethodStats {
+        std::string name;
+        uint64_t calls = 0;
+        std::chrono::nanoseconds inclusive{0};
+        std::chrono::nanoseconds exclusive{0};
+        // объекты, созданные в куче самим методом, без вложенных вызовов
+        uint64_t allocations = 0;
+    };
+
+    // Сообщает о начале вызова метода method у экземпляра класса cls
+    void Enter(const Class& cls, const Method& method);
+    // Сообщает о завершении последнего начатого вызова, в том числе исключением
+    void Exit();
+
+    // Возвращает статистику методов, упорядоченную по убыванию собственного времени
+    [[nodiscard]] std::vector<MethodStats> GetMethodStats() const;
+
+    // Выводит в os стеки вызовов: по строке "A.f;B.g <собственное время в нс>" на каждую
+    // цепочку вызовов, в которой было потрачено время
+    void WriteCollapsedStacks(std::ostream& os) const;
+
+    // Выводит в os таблицу статистики методов
+    void WriteReport(std::ostream& os) const;
+
+    // Замеряет вызов метода от создания до уничтожения объекта
+    class Scope {
+    public:
+        Scope(Profiler& profiler, const Class& cls, const Method& method)
+            : profiler_(profiler) {
+            profiler_.Enter(cls, method);
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        ~Scope() {
+            profiler_.Exit();
+        }
+
+    private:
+        Profiler& profiler_;
+    };
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr uint32_t ROOT = 0;
+
+    struct MethodEntry {
+        MethodStats stats;
+        // количество незавершённых вызовов метода в стеке
+        uint32_t active = 0;
+    };
+
+    // Узел дерева вызовов: метод, вызванный из узла parent
+    struct Node {
+        uint32_t method;
+        uint32_t parent;
+        std::chrono::nanoseconds exclusive{0};
+    };
+
+    struct ActiveCall {
+        uint32_t method;
+        uint32_t node;
+        Clock::time_point start;
+        uint64_t start_allocations;
+        std::chrono::nanoseconds children_time{0};
+        uint64_t children_allocations = 0;
+    };
+
+    uint32_t MethodIndex(const Class& cls, const Method& method);
+    uint32_t ChildNode(uint32_t parent, uint32_t method);
+
+    std::unordered_map<const Method*, uint32_t> method_index_;
+    std::vector<MethodEntry> methods_;
+    // корень дерева соответствует программе верхнего уровня
+    std::vector<Node> nodes_{Node{0, ROOT}};
+    // дочерние узлы по ключу (родитель << 32 | метод)
+    std::unordered_map<uint64_t, uint32_t> children_;
+    std::vector<ActiveCall> stack_;
+};
+
+}  // namespace runtime
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ast {
+class Statement;
+}
+
+namespace cache {
+
+struct CacheError : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+// Вид узла синтаксического дерева в сериализованной программе
+enum class NodeTag : uint8_t {
+    NumericConst,
+    StringConst,
+    BoolConst,
+    VariableValue,
+    Assignment,
+    FieldAssignment,
+    None,
+    Print,
+    MethodCall,
+    NewInstance,
+    Stringify,
+    Add,
+    Sub,
+    Mult,
+    Div,
+    Or,
+    And,
+    Not,
+    Compound,
+    MethodBody,
+    Return,
+    ClassDefinition,
+    IfElse,
+    Comparison,
+};
+
+using Comparator = std::function<bool(const runtime::ObjectHolder&, const runtime::ObjectHolder&,
+                                      runtime::Context&)>;
+
+/*
+ * Записывает синтаксическое дерево в компактное двоичное представление.
+ * Каждый узел AST записывает себя в методе ast::Statement::Serialize, пользуясь методами
+ * записи. Имена сохраняются один раз в таблице символов, а классы - в таблице классов,
+ * куда класс попадает при первом упоминании вслед за базовым классом и классами,
+ * используемыми в телах его методов
+ */
+class Writer {
+public:
+    // Записывает узел node вместе с его дочерними узлами
+    void WriteNode(const ast::Statement& node);
+    // Записывает список узлов
+    void WriteNodes(const std::vector<std::unique_ptr<ast::Statement>>& nodes);
+    // Записывает узел, который может отсутствовать
+    void WriteOptionalNode(const ast::Statement* node);
+
+    void WriteTag(NodeTag tag);
+    void WriteUint(uint32_t value);
+    void WriteSymbol(runtime::Symbol symbol);
+    void WriteSymbols(const std::vector<runtime::Symbol>& symbols);
+    void WriteSlot(runtime::Slot slot) {
+        WriteUint(slot);
+    }
+
+    // Записывают узел-константу
+    void WriteConstant(const runtime::Number& value);
+    void WriteConstant(const runtime::String& value);
+    void WriteConstant(const runtime::Bool& value);
+
+    // Записывает ссылку на класс cls, добавляя его при необходимости в таблицу классов
+    void WriteClass(const runtime::Class& cls);
+    // Записывает одну из стандартных функций сравнения. Произвольные функции не сохраняются
+    void WriteComparator(const Comparator& cmp);
+
+private:
+    Writer() = default;
+    friend std::string Serialize(const ast::Statement& program, std::string_view source);
+
+    uint32_t ClassIndex(const runtime::Class& cls);
+    void WriteBytes(const void* data, size_t size);
+
+    // буфер, в который сейчас выполняется запись
+    std::string* out_ = &main_;
+    std::string main_;
+    std::string classes_;
+    uint32_t class_count_ = 0;
+    std::unordered_map<const runtime::Class*, uint32_t> class_index_;
+    std::unordered_map<runtime::Symbol, uint32_t> symbol_index_;
+    std::vector<runtime::Symbol> symbols_;
+};
+
+// Возвращает хеш исходного текста программы, по которому ищется запись в кэше
+[[nodiscard]] uint64_t SourceHash(std::string_view source);
+
+// Сериализует программу, построенную функцией ParseProgram из текста source
+[[nodiscard]] std::string Serialize(const ast::Statement& program, std::string_view source);
+
+// Восстанавливает программу из данных data, сохранённых функцией Serialize.
+// Возвращает nullptr, если данные записаны для другого исходного текста или другой
+// версией формата. Если данные повреждены, выбрасывает CacheError
+[[nodiscard]] std::unique_ptr<ast::Statement> Deserialize(std::string_view data,
+                                                          std::string_view source);
+
+/*
+ * Кэш разобранных программ в каталоге на диске. Запись о программе хранится в файле,
+ * имя которого получено из хеша исходного текста, и загружается отображением файла в память.
+ * Ошибки чтения и записи кэша не мешают выполнению: программа разбирается заново
+ */
+class ProgramCache {
+public:
+    explicit ProgramCache(std::filesystem::path directory);
+
+    // Возвращает программу с текстом source, загружая её из кэша. Если подходящей записи нет,
+    // разбирает текст и сохраняет результат в кэш
+    [[nodiscard]] std::unique_ptr<ast::Statement> Load(std::string_view source) const;
+
+    // Возвращает путь к файлу записи для текста source
+    [[nodiscard]] std::filesystem::path EntryPath(std::string_view source) const;
+
+private:
+    void Store(const ast::Statement& program, std::string_view source) const;
+
+    std::filesystem::path directory_;
+};
+
+}  // namespace cache
@@ -1,49 +1,357 @@
 #pragma once
 
+#include "stats.h"
+#include "symbol.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
 namespace runtime {
 
-// Контекст исполнения инструкций Mython
-class Context {
-public:
-    // Возвращает поток вывода для команд print
-    virtual std::ostream& GetOutputStream() = 0;
+class Budget;
+class Context;
+class Class;
+class CycleCollector;
+class InstancePool;
+struct Method;
+class ObjectHolder;
+class Profiler;
 
-protected:
-    ~Context() = default;
+// Выводит в os десятичную запись value, форматируя её с помощью std::to_chars
+void WriteNumber(std::ostream& os, int value);
+
+// Вид объекта, позволяющий проверять тип объекта без dynamic_cast
+enum class ObjectKind : uint8_t {
+    None,      // пустое значение (только для ObjectHolder::GetKind)
+    Other,     // объекты прочих типов
+    Number,
+    String,
+    Bool,
+    Class,
+    Instance,  // экземпляр класса
 };
 
-// Базовый класс для всех объектов языка Mython
+// Вид объектов типа T или ObjectKind::Other, если тип T не имеет собственного вида.
+// Специализации задаются для конкретных классов, наследники которых невозможны
+template <typename T>
+inline constexpr ObjectKind KIND_OF = ObjectKind::Other;
+
+/*
+ * Базовый класс для всех объектов языка Mython.
+ * Объект в куче хранит счётчик ссылок на себя из ObjectHolder. Пока объект используется
+ * одним потоком, счётчик изменяется обычными, неатомарными операциями. Объект, который
+ * может оказаться доступен нескольким потокам (например, класс или константа
+ * скомпилированной программы), должен быть заранее помечен методом ShareWithThreads,
+ * после чего счётчик изменяется атомарно. При сборке с MYTHON_ATOMIC_REFCOUNT атомарные
+ * счётчики используются у всех объектов
+ */
 class Object {
 public:
+    Object() = default;
+    explicit Object(ObjectKind kind)
+        : kind_(kind) {
+    }
+    // копия - новый объект, на который ещё нет ссылок
+    Object(const Object& other)
+        : kind_(other.kind_) {
+    }
+    Object& operator=(const Object& /*other*/) {
+        return *this;
+    }
+
     virtual ~Object() = default;
     // выводит в os своё представление в виде строки
     virtual void Print(std::ostream &os, Context &context) = 0;
+
+    [[nodiscard]] ObjectKind GetKind() const {
+        return kind_;
+    }
+
+    // Разрешает нескольким потокам одновременно копировать и уничтожать ссылки на объект.
+    // Должен вызываться до того, как объект станет доступен другому потоку
+    virtual void ShareWithThreads() const {
+        shared_ = true;
+    }
+
+    // Возвращает true, если счётчик ссылок объекта изменяется атомарно
+    [[nodiscard]] bool IsSharedWithThreads() const {
+        return shared_;
+    }
+
+    // Возвращает объём памяти объекта, учитываемый в heap_bytes. Не должен меняться
+    // за время жизни объекта
+    [[nodiscard]] virtual size_t GetHeapSize() const {
+        return 0;
+    }
+
+protected:
+    // Освобождает объект, когда на него не осталось ссылок
+    virtual void Dispose() noexcept {
+        ++destroyed_objects;
+        heap_bytes -= static_cast<int64_t>(GetHeapSize());
+        delete this;
+    }
+
+private:
+    friend class ObjectHolder;
+    friend class CycleCollector;
+
+#ifdef MYTHON_ATOMIC_REFCOUNT
+    static constexpr bool SHARED_BY_DEFAULT = true;
+#else
+    static constexpr bool SHARED_BY_DEFAULT = false;
+#endif
+
+    void Retain() const noexcept {
+        if (shared_) {
+            refs_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            // объект принадлежит одному потоку, поэтому атомарная операция не нужна
+            refs_.store(refs_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+
+    // Уменьшает счётчик ссылок и возвращает true, если ссылок не осталось
+    [[nodiscard]] bool Release() const noexcept {
+        if (shared_) {
+            return refs_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+        }
+        uint32_t refs = refs_.load(std::memory_order_relaxed) - 1;
+        refs_.store(refs, std::memory_order_relaxed);
+        return refs == 0;
+    }
+
+    mutable std::atomic<uint32_t> refs_{0};
+    ObjectKind kind_ = ObjectKind::Other;
+    mutable bool shared_ = SHARED_BY_DEFAULT;
+};
+
+// Объект-значение, хранящий значение типа T
+template <typename T>
+class ValueObject : public Object {
+public:
+    ValueObject(T v)  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+        : ValueObject(std::move(v), KindOfValue()) {
+    }
+
+    void Print(std::ostream &os, [[maybe_unused]] Context &context) override {
+        if constexpr (std::is_same_v<T, int>) {
+            WriteNumber(os, value_);
+        } else {
+            os << value_;
+        }
+    }
+
+    [[nodiscard]] const T& GetValue() const {
+        return value_;
+    }
+
+protected:
+    ValueObject(T v, ObjectKind kind)
+        : Object(kind), value_(std::move(v)) {
+    }
+
+private:
+    static constexpr ObjectKind KindOfValue() {
+        if constexpr (std::is_same_v<T, int>) {
+            return ObjectKind::Number;
+        } else {
+            return ObjectKind::Other;
+        }
+    }
+
+    T value_;
+};
+
+/*
+ * Строковое значение. Короткие строки хранятся в std::string, которая размещает их без
+ * выделения памяти. Длинный результат сложения строк хранится как начало общего буфера:
+ * если левое слагаемое заканчивается там же, где буфер, правое дописывается в конец буфера
+ * без копирования левого, поэтому цепочка s = s + x выполняется за линейное время.
+ * Print выводит строку прямо из буфера, а GetValue при первом вызове копирует значение
+ * в собственную строку объекта. Перед тем как строка станет доступна нескольким потокам,
+ * её значение копируется (ShareWithThreads), поэтому буфер всегда принадлежит одному потоку.
+ * Хеш значения вычисляется один раз
+ */
+class String : public Object {
+public:
+    String(std::string value)  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+        : Object(ObjectKind::String), value_(std::move(value)) {
+    }
+    // копия всегда хранит значение в собственной строке
+    String(const String& other)
+        : Object(other), value_(other.View()), hash_(other.hash_.load(std::memory_order_relaxed)) {
+    }
+    String(String&& other) noexcept
+        : Object(other),
+          value_(std::move(other.value_)),
+          buffer_(std::move(other.buffer_)),
+          size_(other.size_),
+          hash_(other.hash_.load(std::memory_order_relaxed)) {
+    }
+    String& operator=(const String&) = delete;
+
+    // Возвращает новую строку lhs + rhs
+    [[nodiscard]] static ObjectHolder Concat(const String& lhs, const String& rhs);
+
+    void Print(std::ostream& os, Context& context) override;
+    void ShareWithThreads() const override;
+
+    [[nodiscard]] const std::string& GetValue() const {
+        if (buffer_) {
+            Flatten();
+        }
+        return value_;
+    }
+
+    // Возвращает значение, не копируя его из общего буфера
+    [[nodiscard]] std::string_view View() const {
+        return buffer_ ? std::string_view(buffer_->data(), size_) : std::string_view(value_);
+    }
+
+    [[nodiscard]] size_t GetSize() const {
+        return buffer_ ? size_ : value_.size();
+    }
+
+    [[nodiscard]] size_t GetHash() const;
+
+    // Общий буфер учитывается целиком в каждой ссылающейся на него строке
+    [[nodiscard]] size_t GetHeapSize() const override {
+        return sizeof(String) + GetSize();
+    }
+
+    // Сравнивает значения, не сравнивая символы строк разной длины или с разными хешами
+    [[nodiscard]] bool Equals(const String& other) const;
+
+    // Результат сложения короче этого размера копируется в новую строку
+    static constexpr size_t MIN_BUFFER_SIZE = 64;
+
+private:
+    String(std::shared_ptr<std::string> buffer, size_t size)
+        : Object(ObjectKind::String), buffer_(std::move(buffer)), size_(size) {
+    }
+
+    // Копирует значение из общего буфера в собственную строку
+    void Flatten() const;
+
+    mutable std::string value_;
+    // общий буфер, началом которого является значение, или nullptr
+    mutable std::shared_ptr<std::string> buffer_;
+    size_t size_ = 0;
+    // 0 - хеш ещё не вычислен
+    mutable std::atomic<size_t> hash_{0};
+};
+// Числовое значение
+using Number = ValueObject<int>;
+
+// Логическое значение
+class Bool : public ValueObject<bool> {
+public:
+    Bool(bool v)  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+        : ValueObject<bool>(v, ObjectKind::Bool) {
+    }
+
+    void Print(std::ostream& os, Context& context) override;
 };
 
-// Специальный класс-обёртка, предназначенный для хранения объекта в Mython-программе
+template <>
+inline constexpr ObjectKind KIND_OF<String> = ObjectKind::String;
+template <>
+inline constexpr ObjectKind KIND_OF<Number> = ObjectKind::Number;
+template <>
+inline constexpr ObjectKind KIND_OF<Bool> = ObjectKind::Bool;
+
+/*
+ * Специальный класс-обёртка, предназначенный для хранения объекта в Mython-программе.
+ * Числа и логические значения хранятся непосредственно внутри ObjectHolder и не требуют
+ * выделения памяти, остальные объекты - в куче, где их время жизни определяется
+ * счётчиком ссылок в самом объекте.
+ * Указатели, которые возвращают Get и TryAs для чисел и логических значений, указывают внутрь
+ * ObjectHolder и действительны, пока он существует и не изменяется
+ */
 class ObjectHolder {
 public:
     // Создаёт пустое значение
-    ObjectHolder() = default;
+    ObjectHolder() noexcept {
+    }
+
+    ObjectHolder(const ObjectHolder& other) {
+        CopyFrom(other);
+    }
+
+    ObjectHolder(ObjectHolder&& other) noexcept {
+        MoveFrom(std::move(other));
+    }
+
+    ObjectHolder& operator=(const ObjectHolder& other) {
+        if (this != &other) {
+            // other может принадлежать объекту, который удерживает только *this
+            ObjectHolder copy(other);
+            Reset();
+            MoveFrom(std::move(copy));
+        }
+        return *this;
+    }
+
+    ObjectHolder& operator=(ObjectHolder&& other) noexcept {
+        if (this != &other) {
+            ObjectHolder moved(std::move(other));
+            Reset();
+            MoveFrom(std::move(moved));
+        }
+        return *this;
+    }
+
+    ~ObjectHolder() {
+        Reset();
+    }
+
+    // Числа и логические значения хранятся внутри ObjectHolder
+    template <typename T>
+    static constexpr bool IS_UNBOXED = std::is_same_v<T, Number> || std::is_same_v<T, Bool>;
 
     // Возвращает ObjectHolder, владеющий объектом типа T
     // Тип T - конкретный класс-наследник Object.
-    // object копируется или перемещается в кучу
+    // Числа и логические значения копируются внутрь ObjectHolder,
+    // остальные объекты копируются или перемещаются в кучу
     template <typename T>
     [[nodiscard]] static ObjectHolder Own(T &&object) {
-        return ObjectHolder(std::make_shared<T>(std::forward<T>(object)));
+        using Type = std::decay_t<T>;
+        if constexpr (std::is_same_v<Type, Number>) {
+            return ObjectHolder(object.GetValue());
+        } else if constexpr (std::is_same_v<Type, Bool>) {
+            return ObjectHolder(Bool(object.GetValue()));
+        } else {
+            ++created_objects;
+            auto* created = new Type(std::forward<T>(object));
+            heap_bytes += static_cast<int64_t>(created->Type::GetHeapSize());
+            return ObjectHolder(created);
+        }
     }
 
-    // Создаёт ObjectHolder, не владеющий объектом (аналог слабой ссылки)
+    // Создаёт ObjectHolder, не владеющий объектом (аналог слабой ссылки).
+    // Память при этом не выделяется. Числа и логические значения также сохраняются по ссылке
     [[nodiscard]] static ObjectHolder Share(Object &object);
     // Создаёт пустой ObjectHolder, соответствующий значению None
-    [[nodiscard]] static ObjectHolder None();
+    [[nodiscard]] static ObjectHolder None() {
+        return ObjectHolder();
+    }
 
     // Возвращает ссылку на Object внутри ObjectHolder.
     // ObjectHolder должен быть непустым
@@ -51,52 +359,391 @@ public:
 
     Object* operator->() const;
 
-    [[nodiscard]] Object* Get() const;
+    [[nodiscard]] Object* Get() const {
+        switch (storage_) {
+            case Storage::Number:
+                return const_cast<Number*>(&number_);
+            case Storage::Bool:
+                return const_cast<Bool*>(&bool_);
+            case Storage::Object:
+            case Storage::Borrowed:
+                return object_;
+            default:
+                return nullptr;
+        }
+    }
+
+    // Возвращает вид хранящегося объекта или ObjectKind::None для пустого значения
+    [[nodiscard]] ObjectKind GetKind() const {
+        switch (storage_) {
+            case Storage::Number:
+                return ObjectKind::Number;
+            case Storage::Bool:
+                return ObjectKind::Bool;
+            case Storage::Object:
+            case Storage::Borrowed:
+                return object_->GetKind();
+            default:
+                return ObjectKind::None;
+        }
+    }
 
     // Возвращает указатель на объект типа T либо nullptr, если внутри ObjectHolder не хранится
-    // объект данного типа
+    // объект данного типа. Для типов, имеющих собственный вид, проверяется вид объекта,
+    // для остальных используется dynamic_cast
     template <typename T>
     [[nodiscard]] T* TryAs() const {
-        return dynamic_cast<T*>(this->Get());
+        constexpr ObjectKind kind = KIND_OF<std::remove_cv_t<T>>;
+        if constexpr (kind == ObjectKind::Number) {
+            if (storage_ == Storage::Number) {
+                return const_cast<Number*>(&number_);
+            }
+        } else if constexpr (kind == ObjectKind::Bool) {
+            if (storage_ == Storage::Bool) {
+                return const_cast<Bool*>(&bool_);
+            }
+        }
+        if constexpr (kind != ObjectKind::Other) {
+            return storage_ >= Storage::Object && object_->GetKind() == kind
+                       ? static_cast<T*>(object_)
+                       : nullptr;
+        } else {
+            return dynamic_cast<T*>(Get());
+        }
+    }
+
+    // Превращает невладеющую ссылку на объект, которым владеет другой ObjectHolder,
+    // во владеющую. Вызывается перед сохранением значения, которое может пережить
+    // владельца ссылки, например self в поле объекта или в результате метода.
+    // Ссылки на объекты вне кучи, на которые нет владеющих ссылок, не изменяются
+    void MakeOwning() {
+        if (storage_ == Storage::Borrowed && object_->refs_.load(std::memory_order_relaxed) > 0) {
+            object_->Retain();
+            storage_ = Storage::Object;
+        }
+    }
+
+    // Возвращает true, если ObjectHolder учтён в счётчике ссылок объекта
+    [[nodiscard]] bool IsOwning() const {
+        return storage_ == Storage::Object;
+    }
+
+    // Помечает хранящийся объект доступным нескольким потокам (см. Object::ShareWithThreads)
+    void ShareWithThreads() const {
+        if (storage_ >= Storage::Object) {
+            object_->ShareWithThreads();
+        }
     }
 
     // Возвращает true, если ObjectHolder не пуст
-    explicit operator bool() const;
+    explicit operator bool() const {
+        return storage_ != Storage::None;
+    }
 
 private:
-    explicit ObjectHolder(std::shared_ptr<Object> data);
+    // Способ хранения значения
+    enum class Storage : uint8_t {
+        None,
+        Number,  // число хранится в number_
+        Bool,    // логическое значение хранится в bool_
+        Object,  // объект в куче, на который указывает object_, и ссылка на него учтена
+        Borrowed,  // объект, на который указывает object_, принадлежит кому-то другому
+    };
+
+    friend class Class;
+    friend class CycleCollector;
+
+    // Создаёт ObjectHolder, владеющий объектом data, созданным в куче
+    explicit ObjectHolder(Object* data) noexcept
+        : object_(data), storage_(Storage::Object) {
+        data->Retain();
+    }
+
+    explicit ObjectHolder(int value) noexcept
+        : storage_(Storage::Number) {
+        new (&number_) Number(value);
+    }
+
+    explicit ObjectHolder(Bool value) noexcept
+        : storage_(Storage::Bool) {
+        new (&bool_) Bool(value);
+    }
+
+    // Копирует байты объединения other: число и логическое значение - объекты без ссылок
+    // и без собственных ресурсов, поэтому их можно копировать побайтно, а для указателя
+    // побайтное копирование совпадает с присваиванием. Копирование объекта-значения через
+    // конструктор компилятор не может связать с активным членом объединения и при
+    // встраивании предупреждает о неинициализированных значениях
+    void CopyPayload(const ObjectHolder& other) noexcept {
+        std::memcpy(static_cast<void*>(&number_), static_cast<const void*>(&other.number_),
+                    PAYLOAD_SIZE);
+    }
+
+    void CopyFrom(const ObjectHolder& other) {
+        CopyPayload(other);
+        storage_ = other.storage_;
+        if (storage_ == Storage::Object) {
+            object_->Retain();
+        }
+    }
+
+    // Переносит значение other в пустой *this, оставляя other пустым
+    void MoveFrom(ObjectHolder&& other) noexcept {
+        // ссылка на объект в куче передаётся без изменения счётчика
+        CopyPayload(other);
+        storage_ = other.storage_;
+        other.storage_ = Storage::None;
+    }
+
+    void Reset() noexcept {
+        switch (storage_) {
+            case Storage::Number:
+                number_.~Number();
+                break;
+            case Storage::Bool:
+                bool_.~Bool();
+                break;
+            case Storage::Object:
+                if (object_->Release()) {
+                    object_->Dispose();
+                }
+                break;
+            default:
+                break;
+        }
+        storage_ = Storage::None;
+    }
+
     void AssertIsValid() const;
 
-    std::shared_ptr<Object> data_;
+    union {
+        Number number_;
+        Bool bool_;
+        Object* object_;
+    };
+    static constexpr size_t PAYLOAD_SIZE =
+        std::max({sizeof(Number), sizeof(Bool), sizeof(Object*)});
+    Storage storage_ = Storage::None;
 };
 
-// Объект-значение, хранящий значение типа T
-template <typename T>
-class ValueObject : public Object {
+// Возвращает значение-маркер локальной переменной, которой ещё ничего не присваивалось.
+// В отличие от None, чтение такой переменной - ошибка
+[[nodiscard]] const ObjectHolder& Undefined();
+// Проверяет, является ли value маркером Undefined
+[[nodiscard]] bool IsUndefined(const ObjectHolder& value);
+
+// Номер локальной переменной в кадре вызова метода
+using Slot = uint32_t;
+// Признак переменной, доступ к которой выполняется по имени через Closure
+inline constexpr Slot NO_SLOT = std::numeric_limits<Slot>::max();
+
+// Контекст исполнения инструкций Mython
+// Момент, когда буферизованный вывод передаётся в поток назначения
+enum class FlushPolicy {
+    OnExit,     // только при явном сбросе и при уничтожении буфера; буфер растёт без ограничений
+    Threshold,  // когда в буфере накопилось заданное количество символов
+    Line,       // после каждой строки, выведенной командой print
+};
+
+/*
+ * Буфер вывода, накапливающий символы в большом блоке памяти и передающий их в поток
+ * назначения крупными порциями. Является std::streambuf, поэтому объекты, выводящие себя
+ * в std::ostream, пишут в тот же буфер, и порядок вывода сохраняется.
+ * При уничтожении оставшиеся в буфере символы передаются в поток назначения
+ */
+class OutputBuffer : public std::streambuf {
 public:
-    ValueObject(T v)  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
-        : value_(v) {
+    static constexpr size_t DEFAULT_THRESHOLD = 64 * 1024;
+
+    explicit OutputBuffer(std::ostream& output, FlushPolicy policy = FlushPolicy::Threshold,
+                          size_t threshold = DEFAULT_THRESHOLD);
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+    ~OutputBuffer() override;
+
+    // Сообщает о завершении строки вывода; при политике Line буфер сбрасывается
+    void EndLine() {
+        if (policy_ == FlushPolicy::Line) {
+            Flush();
+        }
     }
 
-    void Print(std::ostream &os, [[maybe_unused]] Context &context) override {
-        os << value_;
+    // Передаёт накопленные символы в поток назначения
+    void Flush();
+
+    [[nodiscard]] FlushPolicy GetPolicy() const {
+        return policy_;
     }
 
-    [[nodiscard]] const T& GetValue() const {
-        return value_;
+    // Возвращает количество символов, записанных в буфер за всё время его существования
+    [[nodiscard]] uint64_t GetWrittenSize() const {
+        return flushed_ + static_cast<uint64_t>(pptr() - pbase());
     }
 
+protected:
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(const char* s, std::streamsize count) override;
+    int sync() override;
+
 private:
-    T value_;
+    // Сдвигает текущую позицию буфера на count символов
+    void Advance(size_t count);
+
+    std::ostream& output_;
+    FlushPolicy policy_;
+    std::vector<char> buffer_;
+    // символы, уже переданные в поток назначения
+    uint64_t flushed_ = 0;
+};
+
+class Context {
+public:
+    // Возвращает поток вывода для команд print
+    virtual std::ostream& GetOutputStream() = 0;
+
+    // Возвращает буфер, через который пишет поток GetOutputStream(), или nullptr,
+    // если вывод не буферизуется контекстом
+    virtual OutputBuffer* GetOutputBuffer() {
+        return nullptr;
+    }
+
+    // Возвращает ссылку на локальную переменную slot текущего кадра вызова.
+    // Ссылка действительна до создания следующего кадра
+    ObjectHolder& Local(Slot slot) {
+        return locals_[frame_base_ + slot];
+    }
+
+    // Возвращает профилировщик, которому сообщается о вызовах методов,
+    // или nullptr, если профилирование выключено
+    [[nodiscard]] Profiler* GetProfiler() const {
+        return profiler_;
+    }
+
+    void SetProfiler(Profiler* profiler) {
+        profiler_ = profiler;
+    }
+
+    // Подключает контекст к статистике выполнения stats или отключает от неё, если stats
+    // равен nullptr. Контекст должен выполняться в потоке, который подключил его
+    // к статистике, и отключаться от неё до завершения этого потока
+    void SetStats(ExecutionStats* stats);
+
+    [[nodiscard]] ExecutionStats* GetStats() const {
+        return stats_;
+    }
+
+    // Возвращает счётчики контекста или nullptr, если статистика не собирается
+    [[nodiscard]] StatCounters* GetStatCounters() const {
+        return stat_counters_;
+    }
+
+    // Учитывает в статистике символы, выведенные командами print с предыдущего вызова
+    void CountOutput();
+
+    // Возвращает бюджет выполнения или nullptr, если выполнение не ограничено
+    [[nodiscard]] Budget* GetBudget() const {
+        return budget_;
+    }
+
+    void SetBudget(Budget* budget) {
+        budget_ = budget;
+    }
+
+    // Вызов метода, отложенный инструкцией return до выхода из текущего метода
+    struct TailCall {
+        const Method* method = nullptr;
+        std::vector<ObjectHolder> args;
+    };
+
+    // Возвращает отложенный вызов. Он действителен до выполнения кода Mython
+    TailCall& GetTailCall() {
+        return tail_call_;
+    }
+
+protected:
+    // выведенные символы уже учтены командами print, поэтому отключение от статистики
+    // не обращается к виртуальным методам уничтожаемого наследника
+    ~Context() {
+        SetStats(nullptr);
+    }
+
+private:
+    friend class Frame;
+
+    // Возвращает общее количество символов, выведенных в поток контекста
+    uint64_t GetOutputPosition();
+
+    Profiler* profiler_ = nullptr;
+    ExecutionStats* stats_ = nullptr;
+    StatCounters* stat_counters_ = nullptr;
+    Budget* budget_ = nullptr;
+
+    // Локальные переменные всех активных кадров вызова, расположенные друг за другом
+    std::vector<ObjectHolder> locals_;
+    size_t frame_base_ = 0;
+    size_t frame_top_ = 0;
+
+    TailCall tail_call_;
 };
 
+// Кадр вызова метода, локальные переменные которого получили номера при разборе программы.
+// Пока объект существует, Context::Local обращается к переменным этого кадра
+class Frame {
+public:
+    // Создаёт кадр из size переменных, изначально имеющих значение Undefined
+    Frame(Context& context, Slot size);
+    ~Frame();
+
+    Frame(const Frame&) = delete;
+    Frame& operator=(const Frame&) = delete;
+
+    ObjectHolder& operator[](Slot slot) {
+        return context_.Local(slot);
+    }
+
+private:
+    Context& context_;
+    size_t prev_base_;
+};
+
+// Возвращает значение Number. Числа хранятся внутри ObjectHolder и не требуют выделения памяти
+[[nodiscard]] inline ObjectHolder MakeNumber(int value) {
+    return ObjectHolder::Own(Number(value));
+}
+// Возвращает значение Bool
+[[nodiscard]] inline ObjectHolder MakeBool(bool value) {
+    return ObjectHolder::Own(Bool(value));
+}
+
 // Таблица символов, связывающая имя объекта с его значением
-using Closure = std::unordered_map<std::string, ObjectHolder>;
+using Closure = std::unordered_map<Symbol, ObjectHolder>;
 
 // Проверяет, содержится ли в object значение, приводимое к True
 // Для отличных от нуля чисел, True и непустых строк возвращается true. В остальных случаях - false.
 bool IsTrue(const ObjectHolder &object);
 
+// Выводит в os значение value так, как его выводит команда print (None - как "None").
+// Числа, строки и логические значения записываются без форматированного вывода
+void PrintValue(const ObjectHolder& value, std::ostream& os, Context& context);
+
+// Возвращает строковое представление value, совпадающее с выводом PrintValue
+[[nodiscard]] std::string ToString(const ObjectHolder& value, Context& context);
+
+// Способ, которым завершилось выполнение инструкции
+enum class ExecStatus {
+    Normal,  // управление переходит к следующей инструкции
+    Return,  // была выполнена инструкция return, метод должен вернуть value
+    // инструкция return в хвостовой позиции отложила вызов метода (Context::GetTailCall)
+    // у объекта value; метод должен вернуть результат этого вызова
+    TailCall,
+};
+
+// Результат выполнения инструкции вместе с признаком завершения
+struct ExecResult {
+    ObjectHolder value;
+    ExecStatus status = ExecStatus::Normal;
+};
+
 // Интерфейс для выполнения действий над объектами Mython
 class Executable {
 public:
@@ -104,55 +751,391 @@ public:
     // Выполняет действие над объектами внутри closure, используя context
     // Возвращает результирующее значение либо None
     virtual ObjectHolder Execute(Closure &closure, Context &context) = 0;
-};
 
-// Строковое значение
-using String = ValueObject<std::string>;
-// Числовое значение
-using Number = ValueObject<int>;
+    // Выполняет действие так же, как Execute, но дополнительно сообщает, была ли внутри
+    // выполнена инструкция return. Инструкции, меняющие порядок выполнения (составные
+    // инструкции, ветвления, return), переопределяют этот метод
+    virtual ExecResult Run(Closure &closure, Context &context) {
+        return {Execute(closure, context)};
+    }
+};
 
-// Логическое значение
-class Bool : public ValueObject<bool> {
+/*
+ * Кэш результатов метода, помеченного при объявлении как @memoize. Результат вызова
+ * запоминается по значениям аргументов, если все они - числа, строки, логические значения
+ * или None, и сам результат - значение одного из этих типов. Значение self в ключ
+ * не входит: предполагается, что результат метода зависит только от аргументов.
+ * Когда записей становится больше, чем capacity, вытесняется запись, к которой дольше всего
+ * не обращались. Кэш может использоваться одновременно из нескольких потоков
+ */
+class MemoCache {
 public:
-    using ValueObject<bool>::ValueObject;
-    void Print(std::ostream& os, Context& context) override;
+    static constexpr size_t DEFAULT_CAPACITY = 1024;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t size = 0;
+    };
+
+    explicit MemoCache(size_t capacity = DEFAULT_CAPACITY);
+    MemoCache(const MemoCache&) = delete;
+    MemoCache& operator=(const MemoCache&) = delete;
+
+    // Записывает в key ключ кэша для count аргументов args. Возвращает false, если среди
+    // аргументов есть значения, по которым результат не запоминается
+    [[nodiscard]] static bool MakeKey(const ObjectHolder* args, size_t count, std::string& key);
+
+    // Возвращает результат, запомненный для ключа key, и учитывает попадание или промах
+    [[nodiscard]] std::optional<ObjectHolder> Find(const std::string& key);
+    // Запоминает результат value для ключа key, если value можно запомнить
+    void Insert(std::string key, const ObjectHolder& value);
+
+    [[nodiscard]] size_t GetCapacity() const {
+        return capacity_;
+    }
+
+    [[nodiscard]] Stats GetStats() const;
+
+private:
+    struct Entry {
+        std::string key;
+        ObjectHolder value;
+    };
+
+    size_t capacity_;
+    mutable std::mutex mutex_;
+    // записи в порядке последнего обращения, начиная с самой свежей
+    std::list<Entry> entries_;
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index_;
+    Stats stats_;
 };
 
 // Метод класса
 struct Method {
     // Имя метода
-    std::string name;
+    Symbol name;
     // Имена формальных параметров метода
-    std::vector<std::string> formal_params;
+    std::vector<Symbol> formal_params;
     // Тело метода
     std::unique_ptr<Executable> body;
+    // Кол-во локальных переменных (включая self и параметры), которым при разборе назначены
+    // номера слотов. Если равно нулю, метод выполняется с переменными в Closure
+    Slot locals_count = 0;
+    // Кэш результатов метода, объявленного как @memoize, или nullptr
+    std::unique_ptr<MemoCache> memo;
+};
+
+/*
+ * Форма (скрытый класс) объекта - упорядоченный список имён его полей.
+ * Объекты одного класса, поля которых добавлялись в одинаковом порядке, разделяют одну форму,
+ * а значения полей хранят в векторе в порядке добавления. Формы образуют дерево переходов:
+ * добавление поля к объекту заменяет его форму дочерней, которая создаётся один раз.
+ * Формы принадлежат классу и живут, пока жив класс. Дочерние формы могут создаваться
+ * одновременно из нескольких потоков
+ */
+class Shape {
+public:
+    static constexpr size_t NO_FIELD = std::numeric_limits<size_t>::max();
+
+    Shape() = default;
+    Shape(const Shape&) = delete;
+    Shape& operator=(const Shape&) = delete;
+
+    // Возвращает индекс поля name или NO_FIELD, если такого поля у формы нет
+    [[nodiscard]] size_t FindField(Symbol name) const;
+
+    // Возвращает форму, получающуюся из данной добавлением поля name
+    [[nodiscard]] const Shape* AddField(Symbol name) const;
+
+    [[nodiscard]] size_t FieldCount() const {
+        return names_.size();
+    }
+
+    [[nodiscard]] Symbol FieldName(size_t index) const {
+        return names_[index];
+    }
+
+private:
+    // при большом числе полей поиск по имени ведётся через index_, иначе - перебором
+    static constexpr size_t INDEXED_SIZE = 8;
+
+    std::vector<Symbol> names_;
+    std::unordered_map<Symbol, size_t> index_;
+    mutable std::mutex transitions_mutex_;
+    mutable std::vector<std::pair<Symbol, std::unique_ptr<Shape>>> transitions_;
+};
+
+/*
+ * Кэш обращения к полю объекта из определённого места программы. Запоминает форму объекта,
+ * индекс поля в ней и, для присваивания нового поля, форму, в которую перейдёт объект.
+ * Каждый кэш должен использоваться для обращений к полю с одним и тем же именем.
+ *
+ * Программа может выполняться одновременно в нескольких потоках, поэтому запись защищена
+ * счётчиком версий: чтение, совпавшее с записью из другого потока, считается промахом кэша,
+ * а запись, совпавшая с другой записью, пропускается
+ */
+class FieldCache {
+public:
+    struct Entry {
+        const Shape* shape = nullptr;
+        const Shape* transition = nullptr;
+        size_t index = 0;
+    };
+
+    FieldCache() = default;
+    FieldCache(const FieldCache& other) {
+        Store(other.Load());
+    }
+    FieldCache& operator=(const FieldCache& other) {
+        Store(other.Load());
+        return *this;
+    }
+
+    // Возвращает запомненную запись или пустую запись, если кэш сейчас обновляется
+    [[nodiscard]] Entry Load() const {
+        uint32_t version = version_.load(std::memory_order_acquire);
+        Entry entry{shape_.load(std::memory_order_relaxed),
+                    transition_.load(std::memory_order_relaxed),
+                    index_.load(std::memory_order_relaxed)};
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if ((version & 1) != 0 || version_.load(std::memory_order_relaxed) != version) {
+            return {};
+        }
+        return entry;
+    }
+
+    void Store(const Entry& entry) {
+        uint32_t version = version_.load(std::memory_order_relaxed);
+        if ((version & 1) != 0
+            || !version_.compare_exchange_strong(version, version + 1,
+                                                 std::memory_order_acquire)) {
+            return;
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        shape_.store(entry.shape, std::memory_order_relaxed);
+        transition_.store(entry.transition, std::memory_order_relaxed);
+        index_.store(entry.index, std::memory_order_relaxed);
+        version_.store(version + 2, std::memory_order_release);
+    }
+
+private:
+    // нечётное значение означает, что запись в кэш не завершена
+    std::atomic<uint32_t> version_{0};
+    std::atomic<const Shape*> shape_{nullptr};
+    std::atomic<const Shape*> transition_{nullptr};
+    std::atomic<size_t> index_{0};
 };
 
 // Класс
 class Class : public Object {
 public:
     // Создаёт класс с именем name и набором методов methods, унаследованный от класса parent
-    // Если parent равен nullptr, то создаётся базовый класс
-    explicit Class(std::string name, std::vector<Method> methods, const Class* parent);
+    // Если parent равен nullptr, то создаётся базовый класс.
+    // storage - необязательный владелец памяти, в которой размещены тела методов;
+    // класс удерживает его до уничтожения методов
+    explicit Class(Symbol name, std::vector<Method> methods, const Class* parent,
+                   std::shared_ptr<const void> storage = nullptr);
+    Class(Class&& other) noexcept;
 
     // Возвращает указатель на метод name или nullptr, если метод с таким именем отсутствует
-    [[nodiscard]] const Method* GetMethod(const std::string& name) const;
+    // ни в классе, ни в его родителях
+    [[nodiscard]] const Method* GetMethod(Symbol name) const;
 
     // Возвращает имя класса
     [[nodiscard]] const std::string& GetName() const;
 
+    // Возвращает методы, объявленные непосредственно в этом классе (без унаследованных)
+    [[nodiscard]] const std::vector<Method>& GetOwnMethods() const;
+    // Позволяет заменить тела собственных методов класса, например, оптимизированными.
+    // Добавлять и удалять методы нельзя
+    [[nodiscard]] std::vector<Method>& GetOwnMethods();
+
+    // Возвращает базовый класс или nullptr
+    [[nodiscard]] const Class* GetParent() const;
+
+    // Возвращает форму объекта класса, у которого ещё нет полей
+    [[nodiscard]] const Shape* GetRootShape() const;
+
+    // Создаёт новый экземпляр класса. Память для экземпляров выделяется из пула класса,
+    // который существует, пока жив класс или хотя бы один его экземпляр
+    [[nodiscard]] ObjectHolder CreateInstance() const;
+
     // Выводит в os строку "Class <имя класса>", например "Class cat"
     void Print(std::ostream& os, Context& context) override;
 private:
-    std::string name_;
+    Symbol name_;
+    // объявлен перед methods_, чтобы разрушаться после них
+    std::shared_ptr<const void> storage_;
     std::vector<Method> methods_;
     const Class* parent_;
+    std::unique_ptr<Shape> root_shape_ = std::make_unique<Shape>();
+    // таблица всех методов класса, включая унаследованные; строится при создании класса
+    std::unordered_map<Symbol, const Method*> method_table_;
+    std::shared_ptr<InstancePool> pool_;
+    // наибольшее количество полей, которое было у экземпляров класса
+    mutable std::atomic<size_t> field_count_hint_{0};
+
+    friend class ClassInstance;
+};
+
+/*
+ * Кэш вызовов метода из определённого места программы. Запоминает методы, найденные для
+ * нескольких классов объектов, у которых метод вызывался в этом месте, и позволяет повторно
+ * вызывать метод без поиска по имени. Каждый кэш используется для одного имени метода и
+ * одного количества аргументов.
+ *
+ * Записи только добавляются и публикуются увеличением size_, поэтому кэш можно читать
+ * из нескольких потоков без блокировок. Если кэш одновременно пополняют два потока,
+ * один из них пропускает запись
+ */
+class MethodCache {
+public:
+    static constexpr size_t CAPACITY = 4;
+
+    MethodCache() = default;
+    // Копия кэша пуста: найденные методы будут запомнены заново
+    MethodCache(const MethodCache& /*other*/) {
+    }
+    MethodCache& operator=(const MethodCache&) = delete;
+
+    // Возвращает метод name класса cls, принимающий argument_count параметров,
+    // или nullptr, если такого метода нет
+    [[nodiscard]] const Method* Find(const Class& cls, Symbol name, size_t argument_count) {
+        size_t size = size_.load(std::memory_order_acquire);
+        for (size_t i = 0; i < size; ++i) {
+            if (entries_[i].cls == &cls) {
+                return entries_[i].method;
+            }
+        }
+        return Lookup(cls, name, argument_count);
+    }
+
+private:
+    const Method* Lookup(const Class& cls, Symbol name, size_t argument_count);
+
+    struct Entry {
+        const Class* cls = nullptr;
+        const Method* method = nullptr;
+    };
+    std::array<Entry, CAPACITY> entries_;
+    std::atomic<size_t> size_{0};
+    // занят потоком, который добавляет запись
+    std::atomic_flag writing_ = ATOMIC_FLAG_INIT;
+};
+
+template <>
+inline constexpr ObjectKind KIND_OF<Class> = ObjectKind::Class;
+
+/*
+ * Аргументы вызова метода - непрерывная последовательность значений, на которую ссылается
+ * вызов и которой он не владеет. Аргументы, переданные для перемещения (Arguments::Move
+ * и ArgumentBuffer), вызываемый метод забирает себе без копирования, остальные копирует.
+ * Метод забирает аргументы до выполнения своего тела
+ */
+class Arguments {
+public:
+    Arguments() = default;
+    // Аргументы копируются из values
+    Arguments(const std::vector<ObjectHolder>& values)  // NOLINT(google-explicit-constructor)
+        : data_(values.data()), size_(values.size()) {
+    }
+    Arguments(const ObjectHolder* data, size_t size)
+        : data_(data), size_(size) {
+    }
+
+    // Возвращает аргументы, которые вызываемый метод переместит из data
+    [[nodiscard]] static Arguments Move(ObjectHolder* data, size_t size) {
+        Arguments result(data, size);
+        result.movable_ = true;
+        return result;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return size_;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return size_ == 0;
+    }
+
+    [[nodiscard]] const ObjectHolder& operator[](size_t index) const {
+        return data_[index];
+    }
+
+    [[nodiscard]] const ObjectHolder* data() const {
+        return data_;
+    }
+
+    // Возвращает аргумент index, перемещая его, если это разрешено
+    [[nodiscard]] ObjectHolder Take(size_t index) const {
+        if (movable_) {
+            return std::move(const_cast<ObjectHolder&>(data_[index]));
+        }
+        return data_[index];
+    }
+
+private:
+    const ObjectHolder* data_ = nullptr;
+    size_t size_ = 0;
+    bool movable_ = false;
+};
+
+/*
+ * Буфер для вычисленных аргументов вызова. До INLINE_CAPACITY аргументов хранятся
+ * в самом буфере без выделения памяти, при большем количестве переносятся в кучу.
+ * Передаётся в вызываемый метод как Arguments, и аргументы перемещаются в его кадр
+ */
+class ArgumentBuffer {
+public:
+    static constexpr size_t INLINE_CAPACITY = 4;
+
+    ArgumentBuffer() = default;
+    ArgumentBuffer(const ArgumentBuffer&) = delete;
+    ArgumentBuffer& operator=(const ArgumentBuffer&) = delete;
+
+    void push_back(ObjectHolder value) {
+        if (size_ < INLINE_CAPACITY) {
+            inline_[size_++] = std::move(value);
+            return;
+        }
+        if (heap_.empty()) {
+            heap_.reserve(INLINE_CAPACITY * 2);
+            for (auto& arg : inline_) {
+                heap_.push_back(std::move(arg));
+            }
+        }
+        heap_.push_back(std::move(value));
+        ++size_;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return size_;
+    }
+
+    [[nodiscard]] ObjectHolder* data() {
+        return size_ > INLINE_CAPACITY ? heap_.data() : inline_.data();
+    }
+
+    operator Arguments() {  // NOLINT(google-explicit-constructor)
+        return Arguments::Move(data(), size_);
+    }
+
+private:
+    std::array<ObjectHolder, INLINE_CAPACITY> inline_;
+    std::vector<ObjectHolder> heap_;
+    size_t size_ = 0;
 };
 
 // Экземпляр класса
 class ClassInstance : public Object {
 public:
     explicit ClassInstance(const Class& cls);
+    // Перемещает поля other в новый объект; новый объект не отслеживается сборщиком
+    // циклических ссылок и не связан с пулом памяти класса
+    ClassInstance(ClassInstance&& other) noexcept;
+    ClassInstance& operator=(const ClassInstance&) = delete;
 
     /*
      * Если у объекта есть метод __str__, выводит в os результат, возвращённый этим методом.
@@ -162,30 +1145,113 @@ public:
 
     /*
      * Вызывает у объекта метод method, передавая ему actual_args параметров.
+     * Аргументы, переданные через ArgumentBuffer или Arguments::Move, перемещаются в кадр
+     * метода, остальные копируются.
      * Параметр context задаёт контекст для выполнения метода.
      * Если ни сам класс, ни его родители не содержат метод method, метод выбрасывает исключение
      * runtime_error
      */
-    ObjectHolder Call(const std::string& method, const std::vector<ObjectHolder>& actual_args,
-                      Context& context);
+    ObjectHolder Call(Symbol method, Arguments actual_args, Context& context);
+    ObjectHolder Call(Symbol method, std::initializer_list<ObjectHolder> actual_args,
+                      Context& context) {
+        return Call(method, Arguments(actual_args.begin(), actual_args.size()), context);
+    }
+
+    // Вызывает у объекта метод method его класса без поиска по имени.
+    // Количество actual_args должно совпадать с количеством параметров метода
+    ObjectHolder Call(const Method& method, Arguments actual_args, Context& context);
+    ObjectHolder Call(const Method& method, std::initializer_list<ObjectHolder> actual_args,
+                      Context& context) {
+        return Call(method, Arguments(actual_args.begin(), actual_args.size()), context);
+    }
+
+    // Возвращает результат выполнения тела метода result. Если тело завершилось отложенным
+    // вызовом (ExecStatus::TailCall), выполняет его и следующие за ним отложенные вызовы
+    // друг за другом, не увеличивая глубину стека
+    static ObjectHolder CompleteTailCalls(ExecResult result, Context& context);
 
     // Возвращает true, если объект имеет метод method, принимающий argument_count параметров
-    [[nodiscard]] bool HasMethod(const std::string& method, size_t argument_count) const;
+    [[nodiscard]] bool HasMethod(Symbol method, size_t argument_count) const;
 
-    // Возвращает ссылку на Closure, содержащий поля объекта
+    // Возвращает указатель на значение поля name или nullptr, если такого поля нет
+    [[nodiscard]] ObjectHolder* FindField(Symbol name);
+    // То же, но использует и обновляет кэш cache места обращения к полю
+    [[nodiscard]] ObjectHolder* FindField(Symbol name, FieldCache& cache);
+
+    // Присваивает полю name значение value, добавляя поле при необходимости
+    void SetField(Symbol name, ObjectHolder value);
+    // То же, но использует и обновляет кэш cache места обращения к полю
+    void SetField(Symbol name, ObjectHolder value, FieldCache& cache);
+
+    // Возвращает форму объекта или nullptr, если его поля хранятся в словаре
+    [[nodiscard]] const Shape* GetShape() const {
+        return shape_;
+    }
+
+    /*
+     * Возвращает ссылку на Closure, содержащий поля объекта.
+     * Оставлен для совместимости: при первом вызове объект переводится из представления
+     * на основе формы в словарь полей и остаётся в нём до конца жизни
+     */
     [[nodiscard]] Closure& Fields();
     // Возвращает константную ссылку на Closure, содержащую поля объекта
     [[nodiscard]] const Closure& Fields() const;
 
+    // Возвращает класс, экземпляром которого является объект
+    [[nodiscard]] const Class& GetClass() const;
+
     void PrintClass(std::ostream& os, Context& context) {
         const_cast<Class*>(&cls_)->Print(os, context);
     }
 
+    // Помечает доступными нескольким потокам объект и значения его полей
+    void ShareWithThreads() const override;
+
+    [[nodiscard]] size_t GetHeapSize() const override {
+        return sizeof(ClassInstance);
+    }
+
+protected:
+    // Возвращает память экземпляра, созданного Class::CreateInstance, в пул класса
+    void Dispose() noexcept override;
+
 private:
+    friend class Class;
+    friend class CycleCollector;
+
+    // Выполняет метод, используя кэш результатов, если метод объявлен как @memoize
+    ObjectHolder Dispatch(const Method& method, Arguments actual_args, Context& context);
+    // Выполняет метод, объявленный как @memoize, используя кэш его результатов
+    ObjectHolder CallMemoized(const Method& method, Arguments actual_args, Context& context);
+    // Выполняет метод method, сообщая о вызове профилировщику контекста
+    ObjectHolder CallProfiled(const Method& method, Arguments actual_args, Context& context);
+    // Выполняет метод method без уведомления профилировщика
+    ObjectHolder Invoke(const Method& method, Arguments actual_args, Context& context);
+    // Выполняет тело метода method, не выполняя отложенный им вызов
+    ExecResult Enter(const Method& method, Arguments actual_args, Context& context);
+    // Добавляет объекту новое поле со значением value, переводя объект в форму shape
+    void AppendField(const Shape* shape, ObjectHolder value);
+    // Переводит объект в представление полей словарём
+    void MakeDictionary() const;
+
     const Class &cls_;
-    Closure closure_;
+    // форма объекта; nullptr, если поля хранятся в словаре
+    mutable const Shape* shape_;
+    mutable std::vector<ObjectHolder> values_;
+    mutable std::unique_ptr<Closure> dictionary_;
+    // пул, из которого выделена память экземпляра; nullptr, если экземпляр создан не классом
+    std::shared_ptr<InstancePool> pool_;
+    // сборщик циклических ссылок, отслеживающий экземпляр, или nullptr
+    mutable CycleCollector* collector_ = nullptr;
+    mutable const ClassInstance* gc_prev_ = nullptr;
+    mutable const ClassInstance* gc_next_ = nullptr;
+    // количество ссылок на экземпляр извне отслеживаемых экземпляров; вычисляется при сборке
+    mutable int64_t gc_refs_ = 0;
 };
 
+template <>
+inline constexpr ObjectKind KIND_OF<ClassInstance> = ObjectKind::Instance;
+
 /*
  * Возвращает true, если lhs и rhs содержат одинаковые числа, строки или значения типа Bool.
  * Если lhs - объект с методом __eq__, функция возвращает результат вызова lhs.__eq__(rhs),
@@ -224,19 +1290,26 @@ struct DummyContext : Context {
     std::ostringstream output;
 };
 
-// Простой контекст, в нём вывод происходит в поток output, переданный в конструктор
+// Простой контекст, в нём вывод происходит в поток output, переданный в конструктор.
+// Вывод накапливается в буфере и передаётся в output согласно политике policy,
+// оставшаяся часть - при уничтожении контекста
 class SimpleContext : public runtime::Context {
 public:
-    explicit SimpleContext(std::ostream& output)
-        : output_(output) {
+    explicit SimpleContext(std::ostream& output, FlushPolicy policy = FlushPolicy::Threshold)
+        : buffer_(output, policy), stream_(&buffer_) {
     }
 
     std::ostream& GetOutputStream() override {
-        return output_;
+        return stream_;
+    }
+
+    OutputBuffer* GetOutputBuffer() override {
+        return &buffer_;
     }
 
 private:
-    std::ostream& output_;
+    OutputBuffer buffer_;
+    std::ostream stream_;
 };
 
 }  // namespace runtime
@@ -1,12 +1,71 @@
 #pragma once
 
+#include "bytecode.h"
+#include "program_cache.h"
 #include "runtime.h"
 
+#include <cstddef>
 #include <functional>
+#include <memory>
+#include <vector>
+
+namespace opt {
+class Optimizer;
+}
 
 namespace ast {
 
-using Statement = runtime::Executable;
+/*
+ * Арена для узлов синтаксического дерева: память выделяется последовательно из крупных блоков
+ * и освобождается целиком вместе с ареной. Деструкторы узлов, размещённых в арене, вызываются
+ * как обычно, но освобождение их памяти ничего не делает
+ */
+class Arena {
+public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // Выделяет size байт, выровненных по alignof(std::max_align_t)
+    void* Allocate(size_t size);
+
+    // Забирает память арены other вместе с размещёнными в ней узлами. Узлы остаются
+    // на своих местах, а other остаётся пустой
+    void Merge(Arena& other);
+
+    // Возвращает количество байт, выделенных из арены
+    [[nodiscard]] size_t BytesUsed() const {
+        return bytes_used_;
+    }
+
+private:
+    static constexpr size_t BLOCK_SIZE = 16 * 1024;
+
+    std::vector<std::unique_ptr<std::byte[]>> blocks_;
+    std::byte* current_ = nullptr;
+    size_t left_ = 0;
+    size_t bytes_used_ = 0;
+};
+
+// Узел синтаксического дерева Mython-программы.
+// Узлы создаются как в куче (обычным new), так и в арене (new (arena) T(...)),
+// в обоих случаях ими можно владеть через std::unique_ptr
+class Statement : public runtime::Executable {
+public:
+    // Генерирует байт-код, вычисляющий значение узла и оставляющий его на вершине стека
+    virtual void Compile(vm::Compiler& compiler) const = 0;
+    // Записывает узел и его дочерние узлы для сохранения в кэш программ
+    virtual void Serialize(cache::Writer& writer) const = 0;
+    // Оптимизирует дочерние узлы и возвращает узел, которым следует заменить этот,
+    // либо nullptr, если узел остаётся прежним. По умолчанию узел не изменяется
+    virtual std::unique_ptr<Statement> Optimize(opt::Optimizer& optimizer);
+
+    static void* operator new(size_t size);
+    static void* operator new(size_t size, Arena& arena);
+    static void operator delete(void* p) noexcept;
+    // вызывается, если конструктор узла, размещаемого в арене, выбросил исключение
+    static void operator delete(void* p, Arena& arena) noexcept;
+};
 
 // Выражение, возвращающее значение типа T,
 // используется как основа для создания констант
@@ -14,16 +73,53 @@ template <typename T>
 class ValueStatement : public Statement {
 public:
     explicit ValueStatement(T v)
-        : value_(std::move(v)) {
+        : value_(Store(std::move(v))) {
     }
 
     runtime::ObjectHolder Execute(runtime::Closure& /*closure*/,
                                   runtime::Context& /*context*/) override {
-        return runtime::ObjectHolder::Share(value_);
+        if constexpr (runtime::ObjectHolder::IS_UNBOXED<T>) {
+            return runtime::ObjectHolder::Own(T(value_));
+        } else {
+            return runtime::ObjectHolder::Share(*value_);
+        }
+    }
+
+    void Compile(vm::Compiler& compiler) const override {
+        compiler.EmitConstant(runtime::ObjectHolder::Own(T(GetValue())));
+    }
+
+    void Serialize(cache::Writer& writer) const override {
+        writer.WriteConstant(GetValue());
+    }
+
+    [[nodiscard]] const T& GetValue() const {
+        if constexpr (runtime::ObjectHolder::IS_UNBOXED<T>) {
+            return value_;
+        } else {
+            return *value_.template TryAs<T>();
+        }
     }
 
 private:
-    T value_;
+    // Значения, которые не хранятся в ObjectHolder непосредственно, размещаются в куче:
+    // выполнение возвращает невладеющую ссылку, которую поле объекта может сделать владеющей
+    // (ObjectHolder::MakeOwning), чтобы значение пережило дерево программы.
+    // Константу одновременно используют все потоки, выполняющие программу
+    using Storage = std::conditional_t<runtime::ObjectHolder::IS_UNBOXED<T>, T,
+                                       runtime::ObjectHolder>;
+
+    static Storage Store(T value) {
+        if constexpr (runtime::ObjectHolder::IS_UNBOXED<T>) {
+            return value;
+        } else {
+            auto holder = runtime::ObjectHolder::Own(std::move(value));
+            holder.ShareWithThreads();
+            return holder;
+        }
+    }
+
+    Storage value_;
 };
 
 using NumericConst = ValueStatement<runtime::Number>;
@@ -34,39 +130,58 @@ using BoolConst = ValueStatement<runtime::Bool>;
 Вычисляет значение переменной либо цепочки вызовов полей объектов id1.id2.id3.
 Например, выражение circle.center.x - цепочка вызовов полей объектов в инструкции:
 x = circle.center.x
+Если при разборе программы переменной назначен номер слота slot, её значение берётся из
+текущего кадра вызова, иначе - из closure по имени.
 */
 class VariableValue : public Statement {
 public:
-    explicit VariableValue(const std::string& var_name);
-    explicit VariableValue(std::vector<std::string> dotted_ids);
+    explicit VariableValue(runtime::Symbol var_name, runtime::Slot slot = runtime::NO_SLOT);
+    explicit VariableValue(std::vector<runtime::Symbol> dotted_ids,
+                           runtime::Slot slot = runtime::NO_SLOT);
+    explicit VariableValue(const std::vector<std::string>& dotted_ids,
+                           runtime::Slot slot = runtime::NO_SLOT);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    void Compile(vm::Compiler& compiler) const override;
+    void Serialize(cache::Writer& writer) const override;
 private:
-    std::string var_name_;
-    std::vector<std::string> tail_;
+    runtime::Symbol var_name_;
+    std::vector<runtime::Symbol> tail_;
+    std::vector<runtime::FieldCache> field_caches_;
+    runtime::Slot slot_;
 };
 
 // Присваивает переменной, имя которой задано в параметре var, значение выражения rv
 class Assignment : public Statement {
 public:
-    Assignment(std::string var, std::unique_ptr<Statement> rv);
+    Assignment(runtime::Symbol var, std::unique_ptr<Statement> rv,
+               runtime::Slot slot = runtime::NO_SLOT);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    void Compile(vm::Compiler& compiler) const override;
+    void Serialize(cache::Writer& writer) const override;
+    std::unique_ptr<Statement> Optimize(opt::Optimizer& optimizer) override;
 private:
-    std::string var_;
+    runtime::Symbol var_;
     std::unique_ptr<Statement> rv_;
+    runtime::Slot slot_;
 };
 
 // Присваивает полю object.field_name значение выражения rv
 class FieldAssignment : public Statement {
 public:
-    FieldAssignment(VariableValue object, std::string field_name, std::unique_ptr<Statement> rv);
+    FieldAssignment(VariableValue object, runtime::Symbol field_name,
+                    std::unique_ptr<Statement> rv);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    void Compile(vm::Compiler& compiler) const override;
+    void Serialize(cache::Writer& writer) const override;
+    std::unique_ptr<Statement> Optimize(opt::Optimizer& optimizer) override;
 private:
     VariableValue object_;
-    std::string field_name_;
+    runtime::Symbol field_name_;
     std::unique_ptr<Statement> rv_;
+    runtime::FieldCache cache_;
 };
 
 // Значение None
@@ -76,6 +191,9 @@ public:
                                   [[maybe_unused]] runtime::Context& context) override {
         return {};
     }
+
+    void Compile(vm::Compiler& compiler) const override;
+    void Serialize(cache::Writer& writer) const override;
 };
 
 // Команда print
@@ -87,11 +205,14 @@ public:
     explicit Print(std::vector<std::unique_ptr<Statement>> args);
 
     // Инициализирует команду print для вывода значения переменной name
-    static std::unique_ptr<Print> Variable(const std::string& name);
+    static std::unique_ptr<Print> Variable(runtime::Symbol name);
 
     // Во время выполнения команды print вывод должен осуществляться в поток, возвращаемый из
     // context.GetOutputStream()
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    void Compile(vm::Compiler& compiler) const override;
+    void Serialize(cache::Writer& writer) const override;
+    std::unique_ptr<Statement> Optimize(opt::Optimizer& optimizer) override;
 private:
     std::vector<std::unique_ptr<Statement>> args_;
 };
@@ -99,14 +220,22 @@ private:
 // Вызывает метод object.method со списком параметров args
 class MethodCall : public Statement {
 public:
-    MethodCall(std::unique_ptr<Statement> object, std::string method,
+    MethodCall(std::unique_ptr<Statement> object, runtime::Symbol method,
                std::vector<std::unique_ptr<Statement>> args);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    // Вычисляет объект и аргументы и откладывает вызов до выхода из текущего метода
+    // (ExecStatus::TailCall). Метод, объявленный как @memoize, вызывается сразу,
+    // и его результат возвращается со статусом ExecStatus::Return
+    runtime::ExecResult RunTailCall(runtime::Closure& closure, runtime::Context& context);
+    void Compile(vm::Compiler& compiler) const override;
+    void Serialize(cache::Writer& writer) const override;
+    std::unique_ptr<Statement> Optimize(opt::Optimizer& optimizer) override;
 private:
     std::unique_ptr<Statement> object_;
-    std::string method_;
+    runtime::Symbol method_;
     std::vector<std::unique_ptr<Statement>> args_;
+    runtime::MethodCache cache_;
 };
 
 /*
@@ -126,11 +255,21 @@ class NewInstance : public Statement {
 public:
     explicit NewInstance(const runtime::Class& class_);
     NewInstance(const runtime::Class& class_, std::vector<std::unique_ptr<Statement>> args);
-    // Возвращает объект, содержащий значение типа ClassInstance
+    // Создаёт узел, класс которого задаётся позже методом SetClass. Используется при
+    // параллельном разборе, когда класс объявлен в другой части программы
+    explicit NewInstance(std::vector<std::unique_ptr<Statement>> args);
+
+    void SetClass(const runtime::Class& class_);
+    // Возвращает новый экземпляр класса при каждом выполнении
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    void Compile(vm::Compiler& compiler) const override;
+    void Serialize(cache::Writer& writer) const override;
+    std::unique_ptr<Statement> Optimize(opt::Optimizer& optimizer) override;
 private:
-    runtime::ClassInstance class_instance_;
+    const runtime::Class* class_ = nullptr;
     std::vector<std::unique_ptr<Statement>> args_;
+    // метод __init__ с подходящим количеством параметров или nullptr
+    const runtime::Method* init_ = nullptr;
 };
 
 // Базовый класс для унарных операций
@@ -139,6 +278,9 @@ public:
     explicit UnaryOperation(std::unique_ptr<Statement> argument)
         : argument_{std::move(argument)} {
     }
+
+    // Сворачивает операцию, если её аргумент - константа
+    std::unique_ptr<Statement> Optimize(opt::Optimizer& optimizer) override;
 protected:
     std::unique_ptr<Statement> argument_;
 };
@@ -148,6 +290,8 @@ class Stringify : public UnaryOperation {
 public:
     using UnaryOperation::UnaryOperation;
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    void Compile(vm::Compiler& compiler) const override;
+    void Serialize(cache::Writer& writer) const override;
 };
 
 // Родительский класс Бинарная операция с аргументами lhs и rhs
@@ -156,6 +300,9 @@ public:
     BinaryOperation(std::unique_ptr<Statement> lhs, std::unique_ptr<Statement> rhs)
         : lhs_{std::move(lhs)}, rhs_{std::move(rhs)} {
     }
+
+    // Сворачивает операцию, если оба её аргумента - константы
+    std::unique_ptr<Statement> Optimize(opt::Optimizer& optimizer) override;
 protected:
     std::unique_ptr<Statement> lhs_, rhs_;
 };
@@ -171,6 +318,8 @@ public:
     //  объект1 + объект2, если у объект1 - пользовательский класс с методом _add__(rhs)
     // В противном случае при вычислении выбрасывается runtime_error
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    void Compile(vm::Compiler& compiler) const override;
+    void Serialize(cache::Writer& writer) const override;
 };
 
 // Возвращает результат вычитания аргументов lhs и rhs
@@ -182,6 +331,8 @@ public:
     //  число - число
     // Если lhs и rhs - не числа, выбрасывается исключение runtime_error
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    void Compile(vm::Compiler& compiler) const override;
+    void Serialize(cache::Writer& writer) const override;
 };
 
 // Возвращает результат умножения аргументов lhs и rhs
@@ -193,6 +344,8 @@ public:
     //  число * число
     // Если lhs и rhs - не числа, выбрасывается исключение runtime_error
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    void Compile(vm::Compiler& compiler) const override;
+    void Serialize(cache::Writer& writer) const override;
 };
 
 // Возвращает результат деления lhs и rhs
@@ -205,6 +358,8 @@ public:
     // Если lhs и rhs - не числа, выбрасывается исключение runtime_error
     // Если rhs равен 0, выбрасывается исключение runtime_error
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    void Compile(vm::Compiler& compiler) const override;
+    void Serialize(cache::Writer& writer) const override;
 };
 
 // Возвращает результат вычисления логической операции or над lhs и rhs
@@ -214,6 +369,9 @@ public:
     // Значение аргумента rhs вычисляется, только если значение lhs
     // после приведения к Bool равно False
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    void Compile(vm::Compiler& compiler) const override;
+    void Serialize(cache::Writer& writer) const override;
+    std::unique_ptr<Statement> Optimize(opt::Optimizer& optimizer) override;
 };
 
 // Возвращает результат вычисления логической операции and над lhs и rhs
@@ -223,6 +381,9 @@ public:
     // Значение аргумента rhs вычисляется, только если значение lhs
     // после приведения к Bool равно True
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    void Compile(vm::Compiler& compiler) const override;
+    void Serialize(cache::Writer& writer) const override;
+    std::unique_ptr<Statement> Optimize(opt::Optimizer& optimizer) override;
 };
 
 // Возвращает результат вычисления логической операции not над единственным аргументом операции
@@ -230,6 +391,8 @@ class Not : public UnaryOperation {
 public:
     using UnaryOperation::UnaryOperation;
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    void Compile(vm::Compiler& compiler) const override;
+    void Serialize(cache::Writer& writer) const override;
 };
 
 // Составная инструкция (например: тело метода, содержимое ветки if, либо else)
@@ -247,6 +410,11 @@ public:
 
     // Последовательно выполняет добавленные инструкции. Возвращает None
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    // Последовательно выполняет инструкции до первой выполненной инструкции return
+    runtime::ExecResult Run(runtime::Closure& closure, runtime::Context& context) override;
+    void Compile(vm::Compiler& compiler) const override;
+    void Serialize(cache::Writer& writer) const override;
+    std::unique_ptr<Statement> Optimize(opt::Optimizer& optimizer) override;
 private:
     std::vector<std::unique_ptr<Statement>> args_;
 
@@ -268,6 +436,12 @@ public:
     // Если внутри body была выполнена инструкция return, возвращает результат return
     // В противном случае возвращает None
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    // Выполняет body так же, как Execute, но возвращает отложенный инструкцией return вызов
+    // (ExecStatus::TailCall), не выполняя его. Иначе возвращает результат со статусом Normal
+    runtime::ExecResult Run(runtime::Closure& closure, runtime::Context& context) override;
+    void Compile(vm::Compiler& compiler) const override;
+    void Serialize(cache::Writer& writer) const override;
+    std::unique_ptr<Statement> Optimize(opt::Optimizer& optimizer) override;
 private:
     std::unique_ptr<Statement> body_;
 };
@@ -277,26 +451,48 @@ class Return : public Statement {
 public:
     explicit Return(std::unique_ptr<Statement> statement)
         : statement_{std::move(statement)} {
+        FindTailCall();
     }
 
+    // Вычисляет выражение statement и возвращает его значение
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
     // Останавливает выполнение текущего метода. После выполнения инструкции return метод,
     // внутри которого она была исполнена, должен вернуть результат вычисления выражения statement.
-    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    // Если statement - вызов метода, он откладывается до выхода из текущего метода, так что
+    // цепочка хвостовых вызовов выполняется без роста стека. При включённом профилировщике
+    // вызов выполняется сразу, чтобы время каждого метода учитывалось отдельно
+    runtime::ExecResult Run(runtime::Closure& closure, runtime::Context& context) override;
+    void Compile(vm::Compiler& compiler) const override;
+    void Serialize(cache::Writer& writer) const override;
+    std::unique_ptr<Statement> Optimize(opt::Optimizer& optimizer) override;
 private:
     std::unique_ptr<Statement> statement_;
+    // statement_, если это вызов метода, иначе nullptr
+    MethodCall* tail_call_ = nullptr;
+
+    void FindTailCall() {
+        tail_call_ = dynamic_cast<MethodCall*>(statement_.get());
+    }
 };
 
 // Объявляет класс
 class ClassDefinition : public Statement {
 public:
     // Гарантируется, что ObjectHolder содержит объект типа runtime::Class
-    explicit ClassDefinition(runtime::ObjectHolder cls);
+    explicit ClassDefinition(runtime::ObjectHolder cls, runtime::Slot slot = runtime::NO_SLOT);
+
+    // Задаёт класс узла, созданного с пустым ObjectHolder при параллельном разборе
+    void SetClass(runtime::ObjectHolder cls);
 
     // Создаёт внутри closure новый объект, совпадающий с именем класса и значением, переданным в
     // конструктор
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    void Compile(vm::Compiler& compiler) const override;
+    void Serialize(cache::Writer& writer) const override;
+    std::unique_ptr<Statement> Optimize(opt::Optimizer& optimizer) override;
 private:
     runtime::ObjectHolder cls_;
+    runtime::Slot slot_;
 };
 
 // Инструкция if <condition> <if_body> else <else_body>
@@ -307,6 +503,11 @@ public:
            std::unique_ptr<Statement> else_body);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    // Выполняет выбранную ветку, передавая наружу признак выполненного в ней return
+    runtime::ExecResult Run(runtime::Closure& closure, runtime::Context& context) override;
+    void Compile(vm::Compiler& compiler) const override;
+    void Serialize(cache::Writer& writer) const override;
+    std::unique_ptr<Statement> Optimize(opt::Optimizer& optimizer) override;
 private:
     std::unique_ptr<Statement> condition_, if_body_, else_body_;
 };
@@ -323,8 +524,33 @@ public:
     // Вычисляет значение выражений lhs и rhs и возвращает результат работы comparator,
     // приведённый к типу runtime::Bool
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    void Compile(vm::Compiler& compiler) const override;
+    void Serialize(cache::Writer& writer) const override;
+    std::unique_ptr<Statement> Optimize(opt::Optimizer& optimizer) override;
 private:
     Comparator cmp_;
 };
 
+// Программа, узлы которой размещены в арене. Владеет ареной и корнем дерева,
+// выполнение и компиляцию передаёт корню
+class Program : public Statement {
+public:
+    Program(std::shared_ptr<Arena> arena, std::unique_ptr<Statement> root);
+
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    runtime::ExecResult Run(runtime::Closure& closure, runtime::Context& context) override;
+    void Compile(vm::Compiler& compiler) const override;
+    void Serialize(cache::Writer& writer) const override;
+    std::unique_ptr<Statement> Optimize(opt::Optimizer& optimizer) override;
+
+    [[nodiscard]] const Arena& GetArena() const {
+        return *arena_;
+    }
+
+private:
+    // арена объявлена первой, чтобы разрушаться после узлов дерева
+    std::shared_ptr<Arena> arena_;
+    std::unique_ptr<Statement> root_;
+};
+
 }  // namespace ast
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace runtime {
+
+// Количество объектов, созданных в куче текущим потоком функциями ObjectHolder::Own
+// и Class::CreateInstance. Используется профилировщиком и статистикой выполнения
+inline thread_local uint64_t created_objects = 0;
+// Количество объектов в куче, уничтоженных текущим потоком
+inline thread_local uint64_t destroyed_objects = 0;
+// Объём памяти (Object::GetHeapSize) объектов, созданных текущим потоком, за вычетом
+// уничтоженных им. Используется бюджетом выполнения
+inline thread_local int64_t heap_bytes = 0;
+
+// Значения счётчиков статистики выполнения
+struct StatsSnapshot {
+    uint64_t statements = 0;         // выполненные инструкции (только интерпретатор дерева)
+    uint64_t method_calls = 0;       // вызовы методов, включая __init__ и __str__
+    uint64_t objects_allocated = 0;  // объекты, созданные в куче
+    uint64_t objects_destroyed = 0;  // объекты, уничтоженные в куче
+    uint64_t closure_lookups = 0;    // обращения к переменным в словаре Closure
+    uint64_t output_bytes = 0;       // символы, выведенные командами print
+
+    // Количество созданных и ещё не уничтоженных объектов
+    [[nodiscard]] int64_t LiveObjects() const {
+        return static_cast<int64_t>(objects_allocated) - static_cast<int64_t>(objects_destroyed);
+    }
+
+    StatsSnapshot& operator+=(const StatsSnapshot& other);
+};
+
+// Размер строки кэша: счётчики разных потоков не должны попадать в одну строку
+inline constexpr size_t CACHE_LINE_SIZE = 64;
+
+/*
+ * Счётчики одного контекста. Изменяются только потоком, выполняющим контекст, поэтому
+ * обходятся без атомарных операций чтения-изменения-записи: значения атомарны лишь для того,
+ * чтобы ExecutionStats мог прочитать их из другого потока.
+ * Количество объектов и выведенных символов переносится в счётчики при вызовах методов,
+ * выполнении инструкций и отключении статистики от контекста
+ */
+class alignas(CACHE_LINE_SIZE) StatCounters {
+public:
+    enum Counter : size_t {
+        STATEMENTS,
+        METHOD_CALLS,
+        OBJECTS_ALLOCATED,
+        OBJECTS_DESTROYED,
+        CLOSURE_LOOKUPS,
+        OUTPUT_BYTES,
+        COUNTER_COUNT,
+    };
+
+    StatCounters()
+        : created_base_(created_objects), destroyed_base_(destroyed_objects) {
+    }
+
+    void Add(Counter counter, uint64_t value = 1) {
+        auto& target = values_[counter];
+        target.store(target.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    void CountStatement() {
+        Add(STATEMENTS);
+        SyncObjects();
+    }
+
+    void CountMethodCall() {
+        Add(METHOD_CALLS);
+        SyncObjects();
+    }
+
+    // Учитывает символы, выведенные с предыдущего вызова; position - общее количество
+    // символов, выведенных в поток контекста
+    void SyncOutput(uint64_t position) {
+        if (position > output_mark_) {
+            Add(OUTPUT_BYTES, position - output_mark_);
+        }
+        output_mark_ = position;
+    }
+
+    // Переносит в счётчики количество объектов, созданных и уничтоженных текущим потоком
+    void SyncObjects() {
+        values_[OBJECTS_ALLOCATED].store(created_objects - created_base_,
+                                         std::memory_order_relaxed);
+        values_[OBJECTS_DESTROYED].store(destroyed_objects - destroyed_base_,
+                                         std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] StatsSnapshot Load() const;
+
+private:
+    std::array<std::atomic<uint64_t>, COUNTER_COUNT> values_{};
+    uint64_t created_base_;
+    uint64_t destroyed_base_;
+    uint64_t output_mark_ = 0;
+
+    friend class Context;
+};
+
+/*
+ * Статистика выполнения программ, собираемая из контекстов, подключённых к ней методом
+ * Context::SetStats. Каждый контекст получает собственные счётчики в отдельной строке кэша,
+ * поэтому потоки, одновременно выполняющие разные контексты, не мешают друг другу,
+ * а суммирование происходит только при вызове Collect.
+ * Значения контекста, отключённого от статистики, сохраняются в общем итоге
+ */
+class ExecutionStats {
+public:
+    ExecutionStats() = default;
+    ExecutionStats(const ExecutionStats&) = delete;
+    ExecutionStats& operator=(const ExecutionStats&) = delete;
+
+    // Возвращает сумму счётчиков всех контекстов, которые были подключены к статистике.
+    // Может вызываться из любого потока во время выполнения программ
+    [[nodiscard]] StatsSnapshot Collect() const;
+
+private:
+    friend class Context;
+
+    StatCounters* Attach();
+    void Detach(StatCounters* counters);
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<StatCounters>> active_;
+    StatsSnapshot detached_;
+};
+
+}  // namespace runtime
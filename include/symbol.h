@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+
+namespace runtime {
+
+// Интернированное имя (переменной, поля, метода или класса).
+// Все символы с одинаковым текстом ссылаются на единственную строку в глобальной таблице,
+// поэтому сравнение и хеширование символов сводятся к операциям над адресом этой строки.
+// Создание символа из текста требует поиска в таблице, поэтому символы для часто
+// используемых имён следует создавать заранее
+class Symbol {
+public:
+    Symbol();
+    Symbol(std::string_view name);  // NOLINT(google-explicit-constructor)
+    Symbol(const std::string& name)  // NOLINT(google-explicit-constructor)
+        : Symbol(std::string_view{name}) {
+    }
+    Symbol(const char* name)  // NOLINT(google-explicit-constructor)
+        : Symbol(std::string_view{name}) {
+    }
+
+    [[nodiscard]] const std::string& Name() const {
+        return *name_;
+    }
+
+    // Идентификатор символа, уникальный в пределах процесса
+    [[nodiscard]] size_t Id() const {
+        return reinterpret_cast<size_t>(name_);  // NOLINT
+    }
+
+    friend bool operator==(const Symbol& lhs, const Symbol& rhs) {
+        return lhs.name_ == rhs.name_;
+    }
+
+    friend bool operator!=(const Symbol& lhs, const Symbol& rhs) {
+        return lhs.name_ != rhs.name_;
+    }
+
+    // Упорядочивает символы по тексту, чтобы порядок не зависел от адресов
+    friend bool operator<(const Symbol& lhs, const Symbol& rhs) {
+        return lhs.name_ != rhs.name_ && *lhs.name_ < *rhs.name_;
+    }
+
+private:
+    const std::string* name_;
+};
+
+std::ostream& operator<<(std::ostream& os, const Symbol& symbol);
+
+}  // namespace runtime
+
+namespace std {
+
+template <>
+struct hash<runtime::Symbol> {
+    size_t operator()(const runtime::Symbol& symbol) const noexcept {
+        // адреса строк выровнены, младшие биты не несут информации
+        return symbol.Id() >> 3;
+    }
+};
+
+}  // namespace std
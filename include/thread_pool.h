@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace mython {
+
+/*
+ * Пул потоков с перехватом задач (work stealing) для выполнения набора независимых задач.
+ * Задачи заранее распределяются по очередям потоков поровну. Поток берёт задачи с конца
+ * своей очереди, а когда она опустела - забирает задачи с начала очередей других потоков,
+ * поэтому потоки, которым достались короткие задачи, помогают остальным.
+ * Новые задачи во время выполнения не добавляются, так что поток завершает работу,
+ * когда не находит задач ни в одной очереди
+ */
+class WorkStealingPool {
+public:
+    // Создаёт пул из thread_count потоков; 0 - по количеству ядер процессора
+    explicit WorkStealingPool(size_t thread_count = 0);
+
+    [[nodiscard]] size_t GetThreadCount() const {
+        return thread_count_;
+    }
+
+    // Выполняет task(index) для всех index от 0 до count - 1 и ждёт завершения.
+    // Вызывающий поток участвует в выполнении как один из потоков пула.
+    // Если задачи выбросили исключения, после завершения остальных задач
+    // повторно выбрасывается первое из них
+    void Run(size_t count, const std::function<void(size_t)>& task);
+
+    // Возвращает количество задач, выполненных при последнем вызове Run не тем потоком,
+    // которому они были назначены
+    [[nodiscard]] size_t GetStolenCount() const {
+        return stolen_;
+    }
+
+private:
+    // Очередь задач одного потока занимает отдельную строку кэша
+    struct alignas(64) Queue {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    // Возвращает следующую задачу для потока worker или false, если задач не осталось
+    bool Pop(std::vector<Queue>& queues, size_t worker, size_t& task, bool& stolen);
+
+    size_t thread_count_;
+    size_t stolen_ = 0;
+};
+
+}  // namespace mython
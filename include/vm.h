@@ -0,0 +1,80 @@
+#pragma once
+
+#include "bytecode.h"
+#include "runtime.h"
+
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace vm {
+
+/*
+ * Стековая виртуальная машина, исполняющая байт-код, полученный от vm::Compiler.
+ * Все кадры вызовов располагаются в одном стеке значений: локальные переменные метода
+ * (self, параметры и прочие переменные) занимают начало кадра, за ними следуют
+ * промежуточные значения вычислений.
+ * Методы, тела которых не были скомпилированы, выполняются интерпретатором дерева
+ */
+class VirtualMachine {
+public:
+    VirtualMachine(const Program& program, runtime::Context& context);
+
+    // Выполняет программу верхнего уровня, используя globals для хранения её переменных
+    void Run(runtime::Closure& globals);
+
+private:
+    // Выполняет chunk, кадр которого начинается с позиции base стека.
+    // Для программы верхнего уровня globals указывает на её переменные.
+    // Хвостовой вызов (TailCall) выполняется в том же кадре без рекурсии
+    runtime::ObjectHolder Execute(const Chunk& entry, size_t base, runtime::Closure* globals);
+
+    // Находит метод method объекта stack_[base], принимающий argc аргументов.
+    // Если объект не является экземпляром класса или метода нет, выбрасывает runtime_error
+    const runtime::Method& LookupMethod(size_t base, runtime::Symbol method, uint32_t argc,
+                                        runtime::MethodCache* cache);
+
+    // Вызывает метод method у объекта stack_[base], передавая ему argc аргументов,
+    // расположенных следом за объектом. Результат помещается в stack_[base].
+    // Если задан cache, метод ищется с его помощью
+    void CallMethod(size_t base, runtime::Symbol method, uint32_t argc,
+                    runtime::MethodCache* cache = nullptr);
+
+    // Вызывает метод method, используя стек начиная с позиции top.
+    // Первое из значений values - объект, у которого вызывается метод, остальные - аргументы
+    runtime::ObjectHolder Invoke(size_t top, runtime::Symbol method,
+                                 std::initializer_list<runtime::ObjectHolder> values);
+
+    // Аналоги runtime::Equal и runtime::Less для значений stack_[lhs] и stack_[rhs],
+    // вызывающие методы __eq__ и __lt__ средствами VM
+    bool Equal(size_t top, size_t lhs, size_t rhs);
+    bool Less(size_t top, size_t lhs, size_t rhs);
+
+    // Выводит value в os, вызывая __str__ средствами VM
+    void PrintValue(size_t top, std::ostream& os, const runtime::ObjectHolder& value);
+
+    // Возвращает строковое представление value, вызывая __str__ средствами VM
+    std::string ToString(size_t top, const runtime::ObjectHolder& value);
+
+    // Гарантирует, что в стеке есть место для size значений
+    void Reserve(size_t size);
+
+    void CountClosureLookup() {
+        if (counters_ != nullptr) {
+            counters_->Add(runtime::StatCounters::CLOSURE_LOOKUPS);
+        }
+    }
+
+    const Program& program_;
+    runtime::Context& context_;
+    // счётчики статистики контекста; nullptr, если статистика не собирается
+    runtime::StatCounters* counters_;
+    // бюджет выполнения контекста; nullptr, если выполнение не ограничено
+    runtime::Budget* budget_;
+    std::vector<runtime::ObjectHolder> stack_;
+};
+
+// Выполняет скомпилированную программу program в контексте context
+void Run(const Program& program, runtime::Closure& globals, runtime::Context& context);
+
+}  // namespace vm
@@ -0,0 +1,45 @@
+#include "alloc_counter_p.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+std::atomic<size_t> allocations{0};
+}  // namespace
+
+namespace alloc_counter {
+
+size_t Allocations() {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+}  // namespace alloc_counter
+
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t /*size*/) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t /*size*/) noexcept {
+    std::free(p);
+}
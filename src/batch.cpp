@@ -0,0 +1,154 @@
+#include "batch.h"
+
+#include "lexer.h"
+#include "thread_pool.h"
+
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace std;
+
+namespace mython {
+
+namespace {
+
+// Программа, встречающаяся в заданиях; разбирается первым заданием, которому понадобилась
+struct Script {
+    once_flag compiled;
+    unique_ptr<parse::MappedSource> source;
+    unique_ptr<Program> program;
+    string error;
+};
+
+class ScriptCache {
+public:
+    explicit ScriptCache(const CompileOptions& options)
+        : options_(options) {
+    }
+
+    // Возвращает программу из файла path, компилируя её при первом обращении
+    const Script& Get(const filesystem::path& path) {
+        Script* script = nullptr;
+        {
+            lock_guard lock(mutex_);
+            auto& entry = scripts_[filesystem::weakly_canonical(path).string()];
+            if (!entry) {
+                entry = make_unique<Script>();
+            }
+            script = entry.get();
+        }
+        // пока программа компилируется, остальные задания с ней ждут здесь
+        call_once(script->compiled, [this, script, &path] {
+            compiled_.fetch_add(1, memory_order_relaxed);
+            try {
+                script->source = make_unique<parse::MappedSource>(path);
+                script->program = make_unique<Program>(Compile(script->source->View(), options_));
+            } catch (const exception& e) {
+                script->error = e.what();
+            }
+        });
+        return *script;
+    }
+
+    [[nodiscard]] size_t GetCompiledCount() const {
+        return compiled_.load(memory_order_relaxed);
+    }
+
+private:
+    const CompileOptions& options_;
+    mutex mutex_;
+    unordered_map<string, unique_ptr<Script>> scripts_;
+    atomic<size_t> compiled_{0};
+};
+
+// Выполняет задание job и возвращает сообщение об ошибке или пустую строку
+string RunJob(const BatchJob& job, ScriptCache& cache, const BatchOptions& options,
+              atomic<uint64_t>& source_bytes) {
+    try {
+        const Script& script = cache.Get(job.input);
+        if (!script.program) {
+            return script.error;
+        }
+        source_bytes.fetch_add(script.source->View().size(), memory_order_relaxed);
+        ofstream output(job.output);
+        if (!output) {
+            return "Can't open file "s + job.output.string();
+        }
+        {
+            runtime::Budget budget(options.limits);
+            runtime::SimpleContext context{output, options.flush};
+            if (options.stats != nullptr) {
+                context.SetStats(options.stats);
+            }
+            if (!options.limits.IsUnlimited()) {
+                context.SetBudget(&budget);
+            }
+            runtime::Closure closure;
+            Run(*script.program, context, closure);
+        }
+        if (!output) {
+            return "Can't write file "s + job.output.string();
+        }
+    } catch (const exception& e) {
+        return e.what();
+    }
+    return {};
+}
+
+}  // namespace
+
+vector<BatchJob> ReadManifest(istream& input, const filesystem::path& base_directory) {
+    vector<BatchJob> result;
+    string line;
+    for (size_t line_number = 1; getline(input, line); ++line_number) {
+        istringstream fields(line);
+        string in_path;
+        string out_path;
+        if (!(fields >> in_path) || in_path.front() == '#') {
+            continue;
+        }
+        string extra;
+        if (!(fields >> out_path) || fields >> extra) {
+            throw runtime_error("Manifest line "s + to_string(line_number)
+                                + ": expected <in_file> <out_file>"s);
+        }
+        result.push_back({base_directory / in_path, base_directory / out_path});
+    }
+    return result;
+}
+
+double BatchReport::JobsPerSecond() const {
+    double seconds = chrono::duration<double>(elapsed).count();
+    return seconds > 0 ? static_cast<double>(jobs) / seconds : 0.0;
+}
+
+BatchReport RunBatch(const vector<BatchJob>& jobs, const BatchOptions& options) {
+    BatchReport report;
+    report.jobs = jobs.size();
+    report.errors.resize(jobs.size());
+
+    ScriptCache cache(options.compile);
+    atomic<uint64_t> source_bytes{0};
+    WorkStealingPool pool(options.threads);
+    auto start = chrono::steady_clock::now();
+    pool.Run(jobs.size(), [&](size_t index) {
+        report.errors[index] = RunJob(jobs[index], cache, options, source_bytes);
+    });
+    report.elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start);
+
+    for (const auto& error : report.errors) {
+        report.failed += error.empty() ? 0 : 1;
+    }
+    report.compiled = cache.GetCompiledCount();
+    report.stolen = pool.GetStolenCount();
+    report.threads = pool.GetThreadCount();
+    report.source_bytes = source_bytes.load(memory_order_relaxed);
+    return report;
+}
+
+}  // namespace mython
@@ -0,0 +1,162 @@
+#include "batch.h"
+
+#include "thread_pool.h"
+
+#include <test_runner_p.h>
+
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+namespace mython {
+
+namespace {
+
+void WriteFile(const filesystem::path& path, string_view content) {
+    ofstream out(path, ios::binary);
+    out << content;
+}
+
+string ReadFile(const filesystem::path& path) {
+    ifstream in(path, ios::binary);
+    return {istreambuf_iterator<char>(in), istreambuf_iterator<char>()};
+}
+
+void TestReadManifest() {
+    istringstream input(R"(# программы и результаты
+a.my a.out
+
+  b.my   /tmp/b.out
+)"s);
+    auto jobs = ReadManifest(input, "/base"s);
+    ASSERT_EQUAL(jobs.size(), 2U);
+    ASSERT_EQUAL(jobs[0].input, filesystem::path("/base/a.my"s));
+    ASSERT_EQUAL(jobs[0].output, filesystem::path("/base/a.out"s));
+    ASSERT_EQUAL(jobs[1].input, filesystem::path("/base/b.my"s));
+    ASSERT_EQUAL(jobs[1].output, filesystem::path("/tmp/b.out"s));
+
+    for (const auto* bad : {"a.my\n", "a.my\na.my a.out b.out\n"}) {
+        istringstream bad_input{string(bad)};
+        ASSERT_THROWS((void)ReadManifest(bad_input, "/base"s), runtime_error);
+    }
+    try {
+        istringstream bad_input("a.my a.out\n\nc.my\n"s);
+        (void)ReadManifest(bad_input, "/base"s);
+        ASSERT(false);
+    } catch (const runtime_error& e) {
+        ASSERT(string(e.what()).find("line 3"s) != string::npos);
+    }
+}
+
+void TestPoolRunsEachTaskOnce() {
+    WorkStealingPool pool(4);
+    ASSERT_EQUAL(pool.GetThreadCount(), 4U);
+    const size_t count = 1000;
+    vector<atomic<int>> runs(count);
+    pool.Run(count, [&runs](size_t index) {
+        // задачи первого потока заметно длиннее, остальным потокам есть что перехватить
+        if (index < 10) {
+            this_thread::sleep_for(chrono::milliseconds(5));
+        }
+        runs[index].fetch_add(1);
+    });
+    for (const auto& run : runs) {
+        ASSERT_EQUAL(run.load(), 1);
+    }
+    ASSERT(pool.GetStolenCount() > 0);
+
+    pool.Run(0, [](size_t) {
+        throw logic_error("no tasks"s);
+    });
+    ASSERT_EQUAL(pool.GetStolenCount(), 0U);
+}
+
+void TestPoolPropagatesException() {
+    WorkStealingPool pool(3);
+    atomic<size_t> finished{0};
+    ASSERT_THROWS(pool.Run(30,
+                           [&finished](size_t index) {
+                               if (index == 7) {
+                                   throw runtime_error("task failed"s);
+                               }
+                               ++finished;
+                           }),
+                  runtime_error);
+    // остальные задачи доводятся до конца
+    ASSERT_EQUAL(finished.load(), 29U);
+}
+
+void TestRunBatch() {
+    const auto directory = filesystem::temp_directory_path() / "mython_batch_test";
+    filesystem::remove_all(directory);
+    filesystem::create_directories(directory);
+    WriteFile(directory / "counter.my", R"(
+class Counter:
+  def __init__():
+    self.value = 0
+
+  def add_all(n):
+    if n > 0:
+      self.value = self.value + n
+      self.add_all(n - 1)
+
+c = Counter()
+c.add_all(99)
+print c.value
+)"sv);
+    WriteFile(directory / "hello.my", "print 'hello', x\n"sv);
+    WriteFile(directory / "broken.my", "print 2 +\n"sv);
+
+    ostringstream manifest;
+    const size_t repeats = 20;
+    for (size_t i = 0; i < repeats; ++i) {
+        manifest << "counter.my counter" << i << ".out\n";
+    }
+    manifest << "hello.my hello.out\n";
+    manifest << "broken.my broken.out\n";
+    manifest << "missing.my missing.out\n";
+    istringstream input(manifest.str());
+    auto jobs = ReadManifest(input, directory);
+
+    for (auto engine : {Engine::Ast, Engine::Vm}) {
+        runtime::ExecutionStats stats;
+        BatchOptions options;
+        options.compile.engine = engine;
+        options.threads = 4;
+        options.stats = &stats;
+        auto report = RunBatch(jobs, options);
+
+        ASSERT_EQUAL(report.jobs, repeats + 3);
+        // каждая программа компилируется один раз, сколько бы заданий её ни выполняли
+        ASSERT_EQUAL(report.compiled, 4U);
+        ASSERT_EQUAL(report.threads, 4U);
+        ASSERT_EQUAL(report.failed, 3U);
+        ASSERT(report.JobsPerSecond() > 0);
+        for (size_t i = 0; i < repeats; ++i) {
+            ASSERT(report.errors[i].empty());
+            ASSERT_EQUAL(ReadFile(directory / ("counter"s + to_string(i) + ".out"s)), "4950\n"s);
+        }
+        // переменная x не определена: у каждого задания собственная область видимости
+        ASSERT(!report.errors[repeats].empty());
+        ASSERT(!report.errors[repeats + 1].empty());
+        ASSERT(!report.errors[repeats + 2].empty());
+        ASSERT(report.source_bytes > 0);
+        ASSERT(stats.Collect().method_calls >= repeats * 100);
+    }
+    filesystem::remove_all(directory);
+}
+
+}  // namespace
+
+void RunBatchTests(TestRunner& tr) {
+    RUN_TEST(tr, mython::TestReadManifest);
+    RUN_TEST(tr, mython::TestPoolRunsEachTaskOnce);
+    RUN_TEST(tr, mython::TestPoolPropagatesException);
+    RUN_TEST(tr, mython::TestRunBatch);
+}
+
+}  // namespace mython
@@ -0,0 +1,21 @@
+#include "batch.h"
+#include "test_runner_p.h"
+
+#include <iostream>
+
+using namespace std;
+
+namespace mython {
+void RunBatchTests(TestRunner& tr);
+}
+
+int main() {
+    try {
+        TestRunner tr;
+        mython::RunBatchTests(tr);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include "budget.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+// Переводит предел в значение, которое никогда не будет превышено, если предел не задан
+template <typename T>
+T LimitOrMax(T limit) {
+    return limit == 0 ? numeric_limits<T>::max() : limit;
+}
+}  // namespace
+
+Budget::Budget(const ExecutionLimits& limits, YieldHandler on_yield)
+    : max_steps_(LimitOrMax(limits.max_steps)),
+      max_depth_(LimitOrMax(limits.max_depth)),
+      max_heap_bytes_(LimitOrMax(limits.max_heap_bytes)),
+      max_time_(limits.max_time),
+      time_slice_(limits.time_slice),
+      on_yield_(std::move(on_yield)),
+      heap_base_(heap_bytes),
+      start_(Clock::now()),
+      next_yield_(start_ + time_slice_) {
+    StartInterval();
+}
+
+chrono::nanoseconds Budget::GetElapsed() const {
+    return chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start_ - paused_);
+}
+
+void Budget::Check(uint32_t count) {
+    steps_ += (interval_ - countdown_) + static_cast<uint64_t>(count);
+    interval_ = countdown_ = 0;
+    if (steps_ > max_steps_) {
+        Fail("Step limit exceeded");
+    }
+    if (cancelled_.load(memory_order_relaxed)) {
+        Fail("Execution cancelled");
+    }
+    CheckHeap();
+    if (max_time_.count() != 0 || time_slice_.count() != 0) {
+        auto now = Clock::now();
+        if (max_time_.count() != 0 && now - start_ - paused_ > max_time_) {
+            Fail("Time limit exceeded");
+        }
+        if (time_slice_.count() != 0 && now >= next_yield_) {
+            if (on_yield_) {
+                on_yield_();
+                // пока программа стоит в обработчике, её время не расходуется
+                auto resumed = Clock::now();
+                paused_ += resumed - now;
+                now = resumed;
+            }
+            next_yield_ = now + time_slice_;
+        }
+    }
+    StartInterval();
+}
+
+void Budget::StartInterval() {
+    // шаг, после которого будет превышен предел, должен попасть в проверку
+    uint64_t remaining = max_steps_ - steps_;
+    interval_ = countdown_ = remaining >= CHECK_INTERVAL ? CHECK_INTERVAL
+                                                         : static_cast<uint32_t>(remaining + 1);
+}
+
+void Budget::Fail(const char* message) {
+    throw ExecutionLimitError(message);
+}
+
+}  // namespace runtime
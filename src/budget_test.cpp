@@ -0,0 +1,260 @@
+#include "batch.h"
+#include "budget.h"
+#include "interpreter.h"
+
+#include <test_runner_p.h>
+
+#include <atomic>
+#include <fstream>
+#include <thread>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+using mython::Engine;
+
+const auto ENGINES = {Engine::Ast, Engine::Vm};
+
+const string_view RUNAWAY = R"(
+class Loop:
+  def run(n):
+    return self.run(n + 1)
+
+l = Loop()
+l.run(0)
+)"sv;
+
+const string_view DEEP = R"(
+class Deep:
+  def depth(n):
+    if n == 0:
+      return 0
+    return 1 + self.depth(n - 1)
+
+d = Deep()
+print d.depth(50)
+print d.depth(500)
+)"sv;
+
+// Выполняет программу source с бюджетом budget и возвращает её вывод
+string RunWithBudget(string_view source, Engine engine, Budget& budget) {
+    auto program = mython::Compile(source, {engine});
+    DummyContext context;
+    context.SetBudget(&budget);
+    Closure closure;
+    try {
+        mython::Run(program, context, closure);
+    } catch (const ExecutionLimitError&) {
+        context.output << "limit"sv;
+        throw;
+    }
+    return context.output.str();
+}
+
+void TestStepCounting() {
+    ExecutionLimits limits;
+    limits.max_steps = 2500;
+    Budget budget(limits);
+    for (int i = 0; i < 2000; ++i) {
+        budget.Step();
+    }
+    budget.Step(500);
+    ASSERT_EQUAL(budget.GetSteps(), 2500U);
+    ASSERT_THROWS(budget.Step(), ExecutionLimitError);
+
+    // без пределов бюджет только считает шаги
+    Budget unlimited(ExecutionLimits{});
+    for (int i = 0; i < 5000; ++i) {
+        unlimited.Step();
+    }
+    unlimited.Step(Budget::CHECK_INTERVAL * 3);
+    ASSERT_EQUAL(unlimited.GetSteps(), 5000U + Budget::CHECK_INTERVAL * 3);
+}
+
+void TestStepLimitStopsRunawayScript() {
+    for (auto engine : ENGINES) {
+        ExecutionLimits limits;
+        limits.max_steps = 100000;
+        Budget budget(limits);
+        ASSERT_THROWS(RunWithBudget(RUNAWAY, engine, budget), ExecutionLimitError);
+        ASSERT(budget.GetSteps() > limits.max_steps);
+        // хвостовые вызовы не увеличивают глубину
+        ASSERT_EQUAL(budget.GetDepth(), 0U);
+    }
+}
+
+void TestDepthLimit() {
+    for (auto engine : ENGINES) {
+        ExecutionLimits limits;
+        limits.max_depth = 100;
+        Budget budget(limits);
+        try {
+            RunWithBudget(DEEP, engine, budget);
+            ASSERT(false);
+        } catch (const ExecutionLimitError& e) {
+            ASSERT_EQUAL(string(e.what()), "Recursion depth limit exceeded"s);
+        }
+        // глубина восстанавливается при выходе из методов исключением
+        ASSERT_EQUAL(budget.GetDepth(), 0U);
+
+        ExecutionLimits enough;
+        enough.max_depth = 1000;
+        Budget unrestricted(enough);
+        ASSERT_EQUAL(RunWithBudget(DEEP, engine, unrestricted), "50\n500\n"s);
+    }
+}
+
+void TestHeapLimit() {
+    const string_view strings = R"(
+class Text:
+  def __init__():
+    self.s = 'abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz'
+
+  def grow(n):
+    if n > 0:
+      self.s = self.s + self.s
+      self.grow(n - 1)
+
+t = Text()
+t.grow(30)
+)"sv;
+    const string_view instances = R"(
+class Node:
+  def __init__(next):
+    self.next = next
+
+class List:
+  def build(n, head):
+    if n == 0:
+      return head
+    return self.build(n - 1, Node(head))
+
+l = List()
+head = l.build(1000000, None)
+)"sv;
+    for (auto engine : ENGINES) {
+        for (auto source : {strings, instances}) {
+            ExecutionLimits limits;
+            limits.max_heap_bytes = 256 * 1024;
+            Budget budget(limits);
+            ASSERT_THROWS(RunWithBudget(source, engine, budget), ExecutionLimitError);
+        }
+    }
+    // освобождённая память не расходует бюджет
+    const string_view reuse = R"(
+class Text:
+  def repeat(n, s):
+    if n == 0:
+      return s
+    t = s + 'abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz'
+    return self.repeat(n - 1, str(n))
+
+x = Text()
+print x.repeat(50000, '')
+)"sv;
+    for (auto engine : ENGINES) {
+        ExecutionLimits limits;
+        limits.max_heap_bytes = 64 * 1024;
+        Budget budget(limits);
+        ASSERT_EQUAL(RunWithBudget(reuse, engine, budget), "1\n"s);
+    }
+}
+
+void TestTimeLimit() {
+    for (auto engine : ENGINES) {
+        ExecutionLimits limits;
+        limits.max_time = 50ms;
+        Budget budget(limits);
+        ASSERT_THROWS(RunWithBudget(RUNAWAY, engine, budget), ExecutionLimitError);
+        ASSERT(budget.GetElapsed() >= 50ms);
+    }
+}
+
+void TestYieldHandler() {
+    for (auto engine : ENGINES) {
+        ExecutionLimits limits;
+        limits.time_slice = 1ms;
+        limits.max_time = 30ms;
+        int yields = 0;
+        Budget budget(limits, [&yields] {
+            ++yields;
+            // время, проведённое в обработчике, не входит во время выполнения
+            this_thread::sleep_for(5ms);
+        });
+        auto start = chrono::steady_clock::now();
+        ASSERT_THROWS(RunWithBudget(RUNAWAY, engine, budget), ExecutionLimitError);
+        ASSERT(yields >= 5);
+        ASSERT(chrono::steady_clock::now() - start > budget.GetElapsed() + 20ms);
+
+        // планировщик может прервать программу из обработчика
+        ExecutionLimits slices;
+        slices.time_slice = 1ms;
+        Budget aborted(slices, [] {
+            throw runtime_error("preempted"s);
+        });
+        ASSERT_THROWS(RunWithBudget(RUNAWAY, engine, aborted), runtime_error);
+    }
+}
+
+void TestCancel() {
+    for (auto engine : ENGINES) {
+        atomic<bool> stopped = false;
+        // бюджет создаётся и используется в потоке, выполняющем программу
+        Budget* shared = nullptr;
+        atomic<bool> started = false;
+        thread worker([&] {
+            Budget local(ExecutionLimits{});
+            shared = &local;
+            started = true;
+            try {
+                RunWithBudget(RUNAWAY, engine, local);
+            } catch (const ExecutionLimitError& e) {
+                stopped = string(e.what()) == "Execution cancelled"s;
+            }
+        });
+        while (!started) {
+            this_thread::yield();
+        }
+        this_thread::sleep_for(10ms);
+        shared->Cancel();
+        worker.join();
+        ASSERT(stopped);
+    }
+}
+
+void TestBatchLimits() {
+    auto dir = filesystem::temp_directory_path() / "mython_budget_test"s;
+    filesystem::create_directories(dir);
+    {
+        ofstream(dir / "runaway.my") << RUNAWAY;
+        ofstream(dir / "ok.my") << "print 'ok'\n"sv;
+    }
+    vector<mython::BatchJob> jobs = {{dir / "runaway.my", dir / "runaway.out"},
+                                     {dir / "ok.my", dir / "ok.out"}};
+    mython::BatchOptions options;
+    options.threads = 2;
+    options.limits.max_steps = 10000;
+    auto report = mython::RunBatch(jobs, options);
+    ASSERT_EQUAL(report.failed, 1U);
+    ASSERT_EQUAL(report.errors[0], "Step limit exceeded"s);
+    ASSERT(report.errors[1].empty());
+    filesystem::remove_all(dir);
+}
+
+}  // namespace
+
+void RunBudgetTests(TestRunner& tr) {
+    RUN_TEST(tr, runtime::TestStepCounting);
+    RUN_TEST(tr, runtime::TestStepLimitStopsRunawayScript);
+    RUN_TEST(tr, runtime::TestDepthLimit);
+    RUN_TEST(tr, runtime::TestHeapLimit);
+    RUN_TEST(tr, runtime::TestTimeLimit);
+    RUN_TEST(tr, runtime::TestYieldHandler);
+    RUN_TEST(tr, runtime::TestCancel);
+    RUN_TEST(tr, runtime::TestBatchLimits);
+}
+
+}  // namespace runtime
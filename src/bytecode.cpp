@@ -0,0 +1,459 @@
+#include "bytecode.h"
+
+#include "statement.h"
+
+#include <algorithm>
+#include <ostream>
+
+using namespace std;
+
+namespace vm {
+
+namespace {
+const runtime::Symbol INIT_METHOD{"__init__"sv};
+const runtime::Symbol SELF{"self"sv};
+
+// Изменение глубины стека вычислений при выполнении инструкции
+int StackEffect(const Instruction& instr) {
+    switch (instr.op) {
+        case OpCode::Const:
+        case OpCode::None:
+        case OpCode::True:
+        case OpCode::False:
+        case OpCode::LoadGlobal:
+        case OpCode::LoadLocal:
+        case OpCode::PrintEnd:
+        case OpCode::NewInstance:
+        case OpCode::DefineClass:
+            return 1;
+        case OpCode::StoreField:
+        case OpCode::Pop:
+        case OpCode::Add:
+        case OpCode::Sub:
+        case OpCode::Mult:
+        case OpCode::Div:
+        case OpCode::Equal:
+        case OpCode::NotEqual:
+        case OpCode::Less:
+        case OpCode::Greater:
+        case OpCode::LessOrEqual:
+        case OpCode::GreaterOrEqual:
+        case OpCode::Compare:
+        case OpCode::JumpIfFalse:
+        case OpCode::JumpIfTrue:
+        case OpCode::PrintItem:
+        case OpCode::Return:
+            return -1;
+        case OpCode::CallMethod:
+            return -static_cast<int>(instr.b);
+        case OpCode::TailCall:
+            return -static_cast<int>(instr.b) - 1;
+        case OpCode::Construct:
+            return -static_cast<int>(instr.a);
+        default:
+            return 0;
+    }
+}
+
+// Проверяет, что инструкция только кладёт на стек значение и не имеет побочных эффектов
+bool IsPurePush(OpCode op) {
+    return op == OpCode::Const || op == OpCode::None || op == OpCode::True
+           || op == OpCode::False;
+}
+}  // namespace
+
+const char* OpCodeName(OpCode op) {
+    static const char* const names[] = {
+#define MYTHON_OPCODE_NAME(name) #name,
+        MYTHON_OPCODES(MYTHON_OPCODE_NAME)
+#undef MYTHON_OPCODE_NAME
+    };
+    return names[static_cast<size_t>(op)];
+}
+
+const Chunk& Program::Main() const {
+    return main_;
+}
+
+const Chunk* Program::FindMethod(const runtime::Executable* body) const {
+    if (auto it = method_index_.find(body); it != method_index_.end()) {
+        return it->second;
+    }
+    return nullptr;
+}
+
+void Program::Disassemble(std::ostream& os) const {
+    auto print_chunk = [&os](const Chunk& chunk) {
+        for (size_t i = 0; i < chunk.code.size(); ++i) {
+            const auto& instr = chunk.code[i];
+            os << "  "sv << i << ": "sv << OpCodeName(instr.op) << ' ' << instr.a << ' ' << instr.b
+               << '\n';
+        }
+    };
+    os << "main:\n"sv;
+    print_chunk(main_);
+    for (const auto& [body, chunk] : method_index_) {
+        os << "method "sv << body << " (locals: "sv << chunk->locals_count << "):\n"sv;
+        print_chunk(*chunk);
+    }
+}
+
+Compiler::Compiler(Program& program, Chunk& chunk)
+    : program_(program), chunk_(chunk) {
+}
+
+Compiler::Compiler(Program& program, Chunk& chunk, const runtime::Method& method)
+    : program_(program), chunk_(chunk), in_method_(true) {
+    locals_[SELF] = 0;
+    uint32_t index = 1;
+    for (const auto& param : method.formal_params) {
+        locals_[param] = index++;
+    }
+    chunk_.params_count = static_cast<uint32_t>(method.formal_params.size());
+    chunk_.locals_count = index;
+}
+
+Program Compiler::Compile(const ast::Statement& program) {
+    Program result;
+    Compiler compiler(result, result.main_);
+    compiler.CompileStatement(program);
+    compiler.Emit(OpCode::ReturnNone);
+    return result;
+}
+
+void Compiler::EmitConstant(runtime::ObjectHolder value) {
+    // скомпилированная программа может выполняться в нескольких потоках одновременно
+    value.ShareWithThreads();
+    chunk_.constants.push_back(std::move(value));
+    Emit(OpCode::Const, static_cast<uint32_t>(chunk_.constants.size() - 1));
+}
+
+void Compiler::Emit(OpCode op, uint32_t a, uint32_t b) {
+    if (op == OpCode::Return && in_method_ && !chunk_.code.empty()
+        && chunk_.code.back().op == OpCode::CallMethod && jump_target_ < chunk_.code.size()) {
+        // return вызова метода выполняется хвостовым вызовом в кадре текущего метода
+        chunk_.code.back().op = OpCode::TailCall;
+        AdjustStack(-1);
+        return;
+    }
+    chunk_.code.push_back({op, a, b});
+    if (op == OpCode::LoadField || op == OpCode::StoreField) {
+        chunk_.field_caches.resize(chunk_.code.size());
+    }
+    if (op == OpCode::CallMethod || op == OpCode::Construct) {
+        chunk_.method_caches.resize(chunk_.code.size());
+    }
+    AdjustStack(StackEffect(chunk_.code.back()));
+}
+
+void Compiler::CompileExpression(const ast::Statement& node) {
+    node.Compile(*this);
+}
+
+void Compiler::CompileStatement(const ast::Statement& node) {
+    node.Compile(*this);
+    auto& code = chunk_.code;
+    if (code.size() > jump_target_ && IsPurePush(code.back().op)) {
+        // значение-константу не нужно сначала класть на стек, чтобы потом снять
+        code.pop_back();
+        AdjustStack(-1);
+    } else {
+        Emit(OpCode::Pop);
+    }
+}
+
+void Compiler::CompileVariable(runtime::Symbol name, const std::vector<runtime::Symbol>& tail) {
+    if (in_method_) {
+        Emit(OpCode::LoadLocal, LocalIndex(name), NameIndex(name));
+    } else {
+        Emit(OpCode::LoadGlobal, NameIndex(name));
+    }
+    runtime::Symbol owner = name;
+    for (runtime::Symbol field : tail) {
+        Emit(OpCode::LoadField, NameIndex(field), NameIndex(owner));
+        owner = field;
+    }
+}
+
+void Compiler::CompileStore(runtime::Symbol name) {
+    if (in_method_) {
+        Emit(OpCode::StoreLocal, LocalIndex(name));
+    } else {
+        Emit(OpCode::StoreGlobal, NameIndex(name));
+    }
+}
+
+void Compiler::CompileFieldStore(runtime::Symbol field, const ast::Statement& rv) {
+    CompileExpression(rv);
+    Emit(OpCode::StoreField, NameIndex(field));
+}
+
+void Compiler::CompileCall(runtime::Symbol method,
+                           const std::vector<std::unique_ptr<ast::Statement>>& args) {
+    for (const auto& arg : args) {
+        CompileExpression(*arg);
+    }
+    Emit(OpCode::CallMethod, NameIndex(method), static_cast<uint32_t>(args.size()));
+}
+
+void Compiler::CompileNewInstance(const runtime::Class& cls,
+                                  const std::vector<std::unique_ptr<ast::Statement>>& args) {
+    chunk_.classes.push_back(&cls);
+    Emit(OpCode::NewInstance, static_cast<uint32_t>(chunk_.classes.size() - 1));
+    // методы класса не меняются после его создания, поэтому наличие подходящего
+    // конструктора можно проверить во время компиляции
+    const runtime::Method* init = cls.GetMethod(INIT_METHOD);
+    if (init != nullptr && init->formal_params.size() == args.size()) {
+        for (const auto& arg : args) {
+            CompileExpression(*arg);
+        }
+        Emit(OpCode::Construct, static_cast<uint32_t>(args.size()));
+    }
+}
+
+void Compiler::CompileClassDefinition(const runtime::ObjectHolder& cls) {
+    const auto& class_ref = *cls.TryAs<runtime::Class>();
+    if (in_method_) {
+        // класс, объявленный внутри метода, становится его локальной переменной
+        EmitConstant(cls);
+        CompileStore(class_ref.GetName());
+        Emit(OpCode::Pop);
+        Emit(OpCode::None);
+    } else {
+        cls.ShareWithThreads();
+        chunk_.constants.push_back(cls);
+        Emit(OpCode::DefineClass, static_cast<uint32_t>(chunk_.constants.size() - 1),
+             NameIndex(class_ref.GetName()));
+    }
+
+    for (const auto& method : class_ref.GetOwnMethods()) {
+        const auto* body = dynamic_cast<const ast::Statement*>(method.body.get());
+        if (body == nullptr || program_.method_index_.count(method.body.get()) != 0) {
+            // тело, не являющееся узлом AST, будет выполнено интерпретатором дерева
+            continue;
+        }
+        auto& chunk = *program_.methods_.emplace_back(std::make_unique<Chunk>());
+        Compiler method_compiler(program_, chunk, method);
+        method_compiler.CompileExpression(*body);
+        method_compiler.Emit(OpCode::Return);
+        program_.method_index_[method.body.get()] = &chunk;
+    }
+}
+
+void Compiler::CompilePrint(const std::vector<std::unique_ptr<ast::Statement>>& args) {
+    bool first = true;
+    for (const auto& arg : args) {
+        if (!first) {
+            Emit(OpCode::PrintSpace);
+        }
+        CompileExpression(*arg);
+        Emit(OpCode::PrintItem);
+        first = false;
+    }
+    Emit(OpCode::PrintEnd);
+}
+
+void Compiler::CompileComparison(const Comparator& cmp) {
+    using ComparatorFn = bool (*)(const runtime::ObjectHolder&, const runtime::ObjectHolder&,
+                                  runtime::Context&);
+    static const std::pair<ComparatorFn, OpCode> known[] = {
+        {runtime::Equal, OpCode::Equal},
+        {runtime::NotEqual, OpCode::NotEqual},
+        {runtime::Less, OpCode::Less},
+        {runtime::Greater, OpCode::Greater},
+        {runtime::LessOrEqual, OpCode::LessOrEqual},
+        {runtime::GreaterOrEqual, OpCode::GreaterOrEqual},
+    };
+    if (const auto* fn = cmp.target<ComparatorFn>()) {
+        for (const auto& [known_fn, op] : known) {
+            if (*fn == known_fn) {
+                Emit(op);
+                return;
+            }
+        }
+    }
+    chunk_.comparators.push_back(cmp);
+    Emit(OpCode::Compare, static_cast<uint32_t>(chunk_.comparators.size() - 1));
+}
+
+void Compiler::CompileIfElse(const ast::Statement& condition, const ast::Statement& if_body,
+                             const ast::Statement* else_body) {
+    CompileExpression(condition);
+    auto else_jump = EmitJump(OpCode::JumpIfFalse);
+    CompileExpression(if_body);
+    auto end_jump = EmitJump(OpCode::Jump);
+    // значение ветки if остаётся на стеке только на пути через end_jump
+    AdjustStack(-1);
+    PatchJump(else_jump);
+    if (else_body != nullptr) {
+        CompileExpression(*else_body);
+    } else {
+        Emit(OpCode::None);
+    }
+    PatchJump(end_jump);
+}
+
+void Compiler::CompileOr(const ast::Statement& lhs, const ast::Statement& rhs) {
+    CompileExpression(lhs);
+    auto true_jump = EmitJump(OpCode::JumpIfTrue);
+    CompileExpression(rhs);
+    Emit(OpCode::ToBool);
+    auto end_jump = EmitJump(OpCode::Jump);
+    AdjustStack(-1);
+    PatchJump(true_jump);
+    Emit(OpCode::True);
+    PatchJump(end_jump);
+}
+
+void Compiler::CompileAnd(const ast::Statement& lhs, const ast::Statement& rhs) {
+    CompileExpression(lhs);
+    auto false_jump = EmitJump(OpCode::JumpIfFalse);
+    CompileExpression(rhs);
+    Emit(OpCode::ToBool);
+    auto end_jump = EmitJump(OpCode::Jump);
+    AdjustStack(-1);
+    PatchJump(false_jump);
+    Emit(OpCode::False);
+    PatchJump(end_jump);
+}
+
+uint32_t Compiler::NameIndex(runtime::Symbol name) {
+    auto [it, inserted] = names_.try_emplace(name, static_cast<uint32_t>(chunk_.names.size()));
+    if (inserted) {
+        chunk_.names.push_back(name);
+    }
+    return it->second;
+}
+
+uint32_t Compiler::LocalIndex(runtime::Symbol name) {
+    auto [it, inserted] = locals_.try_emplace(name, chunk_.locals_count);
+    if (inserted) {
+        ++chunk_.locals_count;
+    }
+    return it->second;
+}
+
+size_t Compiler::EmitJump(OpCode op) {
+    Emit(op);
+    return chunk_.code.size() - 1;
+}
+
+void Compiler::PatchJump(size_t at) {
+    jump_target_ = chunk_.code.size();
+    chunk_.code[at].a = static_cast<uint32_t>(jump_target_);
+}
+
+void Compiler::AdjustStack(int delta) {
+    stack_depth_ += delta;
+    chunk_.max_stack = std::max(chunk_.max_stack, static_cast<uint32_t>(stack_depth_));
+}
+
+Program Compile(const ast::Statement& program) {
+    return Compiler::Compile(program);
+}
+
+}  // namespace vm
+
+namespace ast {
+
+void VariableValue::Compile(vm::Compiler& compiler) const {
+    compiler.CompileVariable(var_name_, tail_);
+}
+
+void Assignment::Compile(vm::Compiler& compiler) const {
+    compiler.CompileExpression(*rv_);
+    compiler.CompileStore(var_);
+}
+
+void FieldAssignment::Compile(vm::Compiler& compiler) const {
+    compiler.CompileExpression(object_);
+    compiler.CompileFieldStore(field_name_, *rv_);
+}
+
+void None::Compile(vm::Compiler& compiler) const {
+    compiler.Emit(vm::OpCode::None);
+}
+
+void Print::Compile(vm::Compiler& compiler) const {
+    compiler.CompilePrint(args_);
+}
+
+void MethodCall::Compile(vm::Compiler& compiler) const {
+    compiler.CompileExpression(*object_);
+    compiler.CompileCall(method_, args_);
+}
+
+void NewInstance::Compile(vm::Compiler& compiler) const {
+    compiler.CompileNewInstance(*class_, args_);
+}
+
+void Stringify::Compile(vm::Compiler& compiler) const {
+    compiler.CompileExpression(*argument_);
+    compiler.Emit(vm::OpCode::Stringify);
+}
+
+#define BINARY_COMPILE(type)                          \
+    void type::Compile(vm::Compiler& compiler) const { \
+        compiler.CompileExpression(*lhs_);             \
+        compiler.CompileExpression(*rhs_);             \
+        compiler.Emit(vm::OpCode::type);               \
+    }
+
+BINARY_COMPILE(Add)
+BINARY_COMPILE(Sub)
+BINARY_COMPILE(Mult)
+BINARY_COMPILE(Div)
+
+#undef BINARY_COMPILE
+
+void Or::Compile(vm::Compiler& compiler) const {
+    compiler.CompileOr(*lhs_, *rhs_);
+}
+
+void And::Compile(vm::Compiler& compiler) const {
+    compiler.CompileAnd(*lhs_, *rhs_);
+}
+
+void Not::Compile(vm::Compiler& compiler) const {
+    compiler.CompileExpression(*argument_);
+    compiler.Emit(vm::OpCode::Not);
+}
+
+void Compound::Compile(vm::Compiler& compiler) const {
+    for (const auto& arg : args_) {
+        compiler.CompileStatement(*arg);
+    }
+    compiler.Emit(vm::OpCode::None);
+}
+
+void MethodBody::Compile(vm::Compiler& compiler) const {
+    compiler.CompileStatement(*body_);
+    compiler.Emit(vm::OpCode::None);
+}
+
+void Program::Compile(vm::Compiler& compiler) const {
+    root_->Compile(compiler);
+}
+
+void Return::Compile(vm::Compiler& compiler) const {
+    compiler.CompileExpression(*statement_);
+    compiler.Emit(vm::OpCode::Return);
+    // узел, как и любой другой, считается оставившим значение на стеке
+    compiler.Emit(vm::OpCode::None);
+}
+
+void ClassDefinition::Compile(vm::Compiler& compiler) const {
+    compiler.CompileClassDefinition(cls_);
+}
+
+void IfElse::Compile(vm::Compiler& compiler) const {
+    compiler.CompileIfElse(*condition_, *if_body_, else_body_.get());
+}
+
+void Comparison::Compile(vm::Compiler& compiler) const {
+    compiler.CompileExpression(*lhs_);
+    compiler.CompileExpression(*rhs_);
+    compiler.CompileComparison(cmp_);
+}
+
+}  // namespace ast
@@ -0,0 +1,158 @@
+#include "collector.h"
+
+#include "runtime.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+// Значение gc_refs_ экземпляра, достижимого из внешних ссылок
+constexpr int64_t REACHABLE = -1;
+
+// Вызывает action для экземпляра, которым владеет значение holder.
+// Невладеющие ссылки в полях указывают только на объекты вне кучи (например, константы
+// программы, которые могут быть уже уничтожены), так как SetField делает ссылки на объекты
+// в куче владеющими
+template <typename Action>
+void VisitInstance(const ObjectHolder& holder, Action&& action) {
+    if (holder.IsOwning()) {
+        if (auto* instance = holder.TryAs<ClassInstance>()) {
+            action(*instance);
+        }
+    }
+}
+}  // namespace
+
+CycleCollector::~CycleCollector() {
+    // экземпляры, пережившие поток, больше не обращаются к его сборщику
+    while (head_ != nullptr) {
+        Untrack(*head_);
+    }
+}
+
+CycleCollector& CycleCollector::ForCurrentThread() {
+    static thread_local CycleCollector collector;
+    return collector;
+}
+
+void CycleCollector::SetOptions(const CollectorOptions& options) {
+    options_ = options;
+    ScheduleNext();
+}
+
+CollectorStats CycleCollector::GetStats() const {
+    CollectorStats result = stats_;
+    result.tracked = tracked_count_;
+    return result;
+}
+
+void CycleCollector::Track(const ClassInstance& instance) {
+    instance.collector_ = this;
+    instance.gc_prev_ = nullptr;
+    instance.gc_next_ = head_;
+    if (head_ != nullptr) {
+        head_->gc_prev_ = &instance;
+    }
+    head_ = &instance;
+    ++tracked_count_;
+}
+
+void CycleCollector::Untrack(const ClassInstance& instance) {
+    if (instance.gc_prev_ != nullptr) {
+        instance.gc_prev_->gc_next_ = instance.gc_next_;
+    } else {
+        head_ = instance.gc_next_;
+    }
+    if (instance.gc_next_ != nullptr) {
+        instance.gc_next_->gc_prev_ = instance.gc_prev_;
+    }
+    instance.collector_ = nullptr;
+    instance.gc_prev_ = nullptr;
+    instance.gc_next_ = nullptr;
+    --tracked_count_;
+}
+
+void CycleCollector::ScheduleNext() {
+    size_t growth = tracked_count_ / 100 * options_.growth_percent;
+    next_collection_ = tracked_count_ + max(options_.threshold, growth);
+}
+
+size_t CycleCollector::Collect() {
+    if (collecting_) {
+        return 0;
+    }
+    collecting_ = true;
+    auto start = chrono::steady_clock::now();
+
+    auto for_each_field = [](const ClassInstance& instance, auto&& action) {
+        for (const auto& value : instance.values_) {
+            VisitInstance(value, action);
+        }
+        if (instance.dictionary_) {
+            for (const auto& [name, value] : *instance.dictionary_) {
+                VisitInstance(value, action);
+            }
+        }
+    };
+
+    // 1. ссылки, учтённые в счётчике экземпляра
+    for (auto* instance = head_; instance != nullptr; instance = instance->gc_next_) {
+        instance->gc_refs_ = static_cast<int64_t>(instance->refs_.load(memory_order_relaxed));
+    }
+    // 2. без ссылок из полей отслеживаемых экземпляров остаются только внешние ссылки
+    for (auto* instance = head_; instance != nullptr; instance = instance->gc_next_) {
+        for_each_field(*instance, [this](const ClassInstance& target) {
+            if (target.collector_ == this) {
+                --target.gc_refs_;
+            }
+        });
+    }
+    // 3. экземпляры с внешними ссылками и всё, что из них достижимо, живы
+    vector<const ClassInstance*> pending;
+    for (auto* instance = head_; instance != nullptr; instance = instance->gc_next_) {
+        if (instance->gc_refs_ > 0) {
+            instance->gc_refs_ = REACHABLE;
+            pending.push_back(instance);
+        }
+    }
+    while (!pending.empty()) {
+        const ClassInstance* instance = pending.back();
+        pending.pop_back();
+        for_each_field(*instance, [this, &pending](const ClassInstance& target) {
+            if (target.collector_ == this && target.gc_refs_ != REACHABLE) {
+                target.gc_refs_ = REACHABLE;
+                pending.push_back(&target);
+            }
+        });
+    }
+    // 4. остальные экземпляры удерживаются только друг другом. Пока их поля очищаются,
+    // garbage продлевает им жизнь, а затем их уничтожает счётчик ссылок
+    vector<ObjectHolder> garbage;
+    for (auto* instance = head_; instance != nullptr; instance = instance->gc_next_) {
+        if (instance->gc_refs_ != REACHABLE) {
+            garbage.push_back(ObjectHolder(const_cast<ClassInstance*>(instance)));
+        }
+    }
+    for (auto& holder : garbage) {
+        auto* instance = holder.TryAs<ClassInstance>();
+        instance->values_.clear();
+        instance->dictionary_.reset();
+    }
+    size_t collected = garbage.size();
+    garbage.clear();
+
+    auto pause = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start);
+    ++stats_.collections;
+    stats_.collected += collected;
+    stats_.total_pause += pause;
+    stats_.max_pause = max(stats_.max_pause, pause);
+    stats_.last_pause = pause;
+    ScheduleNext();
+    collecting_ = false;
+    return collected;
+}
+
+}  // namespace runtime
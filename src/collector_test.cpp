@@ -0,0 +1,183 @@
+#include "collector.h"
+
+#include "interpreter.h"
+
+#include <test_runner_p.h>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+const string_view NODE_CLASS = R"(
+class Node:
+  def __init__(name):
+    self.name = name
+    self.peer = None
+
+  def me():
+    return self
+)"sv;
+
+// Выполняет программу, объявляющую класс Node, и возвращает количество экземпляров,
+// которые остались отслеживаемыми после уничтожения её переменных
+size_t RunAndCountTracked(string_view source, mython::Engine engine) {
+    auto& collector = CycleCollector::ForCurrentThread();
+    collector.Collect();
+    size_t tracked_before = collector.GetStats().tracked;
+    auto program = mython::Compile(string(NODE_CLASS) + string(source), {engine});
+    DummyContext context;
+    {
+        Closure closure;
+        mython::Run(program, context, closure);
+    }
+    return collector.GetStats().tracked - tracked_before;
+}
+
+void TestCycleIsCollected() {
+    for (auto engine : {mython::Engine::Ast, mython::Engine::Vm}) {
+        auto& collector = CycleCollector::ForCurrentThread();
+        size_t leaked = RunAndCountTracked(R"(
+a = Node('a')
+b = Node('b')
+a.peer = b
+b.peer = a
+c = Node('c')
+c.peer = c
+d = Node('d')
+)"sv, engine);
+        // d уничтожен счётчиком ссылок, остальные удерживают друг друга
+        ASSERT_EQUAL(leaked, 3U);
+        auto collections = collector.GetStats().collections;
+        ASSERT_EQUAL(collector.Collect(), 3U);
+        ASSERT_EQUAL(collector.GetStats().collections, collections + 1);
+        ASSERT_EQUAL(collector.Collect(), 0U);
+    }
+}
+
+void TestReachableCycleSurvives() {
+    auto& collector = CycleCollector::ForCurrentThread();
+    collector.Collect();
+    auto program = mython::Compile(string(NODE_CLASS) + R"(
+a = Node('a')
+b = Node('b')
+a.peer = b
+b.peer = a
+)"s);
+    DummyContext context;
+    Closure closure;
+    mython::Run(program, context, closure);
+    ASSERT_EQUAL(collector.Collect(), 0U);
+
+    auto check = mython::Compile("print a.peer.name, a.peer.peer.name\n"sv);
+    mython::Run(check, context, closure);
+    ASSERT_EQUAL(context.output.str(), "b a\n"s);
+
+    closure.erase(Symbol("a"sv));
+    ASSERT_EQUAL(collector.Collect(), 0U);
+    closure.clear();
+    ASSERT_EQUAL(collector.Collect(), 2U);
+}
+
+void TestSelfReferenceIsOwning() {
+    // self внутри метода - невладеющая ссылка; сохранённая в поле или возвращённая
+    // из метода, она должна продлевать жизнь объекту
+    auto program = mython::Compile(string(NODE_CLASS) + R"(
+class Holder:
+  def keep(node):
+    node.peer = self
+    self.value = 'kept'
+
+n = Node('x')
+x = n.me()
+n = None
+h = Holder()
+h.keep(x)
+h = None
+print x.name, x.peer.value
+)"s);
+    DummyContext context;
+    Closure closure;
+    mython::Run(program, context, closure);
+    ASSERT_EQUAL(context.output.str(), "x kept\n"s);
+}
+
+void TestAutomaticCollection() {
+    for (auto engine : {mython::Engine::Ast, mython::Engine::Vm}) {
+        auto& collector = CycleCollector::ForCurrentThread();
+        auto options = collector.GetOptions();
+        collector.SetOptions({true, 100, 50});
+        auto collections = collector.GetStats().collections;
+        size_t leaked = RunAndCountTracked(R"(
+class Maker:
+  def pair(n):
+    a = Node(n)
+    b = Node(n)
+    a.peer = b
+    b.peer = a
+
+  def make(n):
+    if n > 0:
+      self.pair(n)
+      self.make(n - 1)
+
+m = Maker()
+m.make(2000)
+)"sv, engine);
+        auto stats = collector.GetStats();
+        collector.SetOptions(options);
+        // 4000 экземпляров из циклов не накапливаются: сборки запускались по ходу выполнения
+        ASSERT(leaked < 200U);
+        ASSERT(stats.collections >= collections + 10);
+        ASSERT(stats.max_pause <= stats.total_pause);
+        ASSERT(stats.last_pause <= stats.max_pause);
+        collector.Collect();
+    }
+}
+
+void TestDisabledCollector() {
+    auto& collector = CycleCollector::ForCurrentThread();
+    auto options = collector.GetOptions();
+    collector.SetOptions({false, 1, 0});
+    auto collections = collector.GetStats().collections;
+    size_t leaked = RunAndCountTracked(R"(
+a = Node('a')
+a.peer = a
+b = Node('b')
+b.peer = b
+)"sv, mython::Engine::Ast);
+    // RunAndCountTracked выполняет одну сборку явно
+    ASSERT_EQUAL(collector.GetStats().collections, collections + 1);
+    ASSERT_EQUAL(leaked, 2U);
+    collector.SetOptions(options);
+    ASSERT_EQUAL(collector.Collect(), 2U);
+}
+
+void TestSharedInstancesAreNotTracked() {
+    auto& collector = CycleCollector::ForCurrentThread();
+    collector.Collect();
+    Class cls{"Test"s, {}, nullptr};
+    auto tracked = collector.GetStats().tracked;
+    ObjectHolder instance = cls.CreateInstance();
+#ifdef MYTHON_ATOMIC_REFCOUNT
+    ASSERT_EQUAL(collector.GetStats().tracked, tracked);
+#else
+    ASSERT_EQUAL(collector.GetStats().tracked, tracked + 1);
+#endif
+    instance.ShareWithThreads();
+    ASSERT_EQUAL(collector.GetStats().tracked, tracked);
+}
+
+}  // namespace
+
+void RunCollectorTests(TestRunner& tr) {
+    RUN_TEST(tr, runtime::TestCycleIsCollected);
+    RUN_TEST(tr, runtime::TestReachableCycleSurvives);
+    RUN_TEST(tr, runtime::TestSelfReferenceIsOwning);
+    RUN_TEST(tr, runtime::TestAutomaticCollection);
+    RUN_TEST(tr, runtime::TestDisabledCollector);
+    RUN_TEST(tr, runtime::TestSharedInstancesAreNotTracked);
+}
+
+}  // namespace runtime
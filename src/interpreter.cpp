@@ -0,0 +1,54 @@
+#include "interpreter.h"
+
+#include "bytecode.h"
+#include "lexer.h"
+#include "parse.h"
+#include "program_cache.h"
+#include "statement.h"
+#include "vm.h"
+
+using namespace std;
+
+namespace mython {
+
+Program::Program(unique_ptr<ast::Statement> tree, const CompileOptions& options)
+    : engine_(options.engine), tree_(std::move(tree)) {
+    // в кэше хранится неоптимизированное дерево, поэтому уровень оптимизации можно менять
+    opt::Optimize(tree_, options.optimization);
+    if (engine_ == Engine::Vm) {
+        bytecode_ = make_unique<vm::Program>(vm::Compile(*tree_));
+    }
+}
+
+Program::Program(Program&&) noexcept = default;
+Program& Program::operator=(Program&&) noexcept = default;
+Program::~Program() = default;
+
+void Program::Run(runtime::Context& context, runtime::Closure& closure) const {
+    if (bytecode_) {
+        vm::Run(*bytecode_, closure, context);
+    } else {
+        // узлы дерева при выполнении изменяют только свои кэши обращений к полям и методам,
+        // которые рассчитаны на одновременное использование из нескольких потоков
+        tree_->Execute(closure, context);
+    }
+}
+
+Program Compile(string_view source, const CompileOptions& options) {
+    unique_ptr<ast::Statement> tree;
+    if (!options.cache_directory.empty()) {
+        tree = cache::ProgramCache(options.cache_directory).Load(source);
+    } else if (options.parse_threads != 1) {
+        tree = ParseProgramParallel(source, options.parse_threads);
+    } else {
+        parse::Lexer lexer(source);
+        tree = ParseProgram(lexer);
+    }
+    return Program(std::move(tree), options);
+}
+
+void Run(const Program& program, runtime::Context& context, runtime::Closure& closure) {
+    program.Run(context, closure);
+}
+
+}  // namespace mython
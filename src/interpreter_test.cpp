@@ -0,0 +1,155 @@
+#include "interpreter.h"
+
+#include "lexer.h"
+
+#include <test_runner_p.h>
+
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace mython {
+
+namespace {
+
+// Программа, которая создаёт много объектов разных классов, добавляет им поля
+// в разном порядке и вызывает методы через общие места вызова
+const string_view SHAPES = R"(
+class Shape:
+  def __init__(name):
+    self.name = name
+
+  def area():
+    return 0
+
+  def describe():
+    return self.name + ' ' + str(self.area())
+
+class Rect(Shape):
+  def __init__(w, h):
+    self.w = w
+    self.h = h
+    self.name = 'rect'
+
+  def area():
+    return self.w * self.h
+
+class Square(Rect):
+  def __init__(side):
+    self.name = 'square'
+    self.w = side
+    self.h = side
+
+class Counter:
+  def __init__():
+    self.total = 0
+
+  def add(shape):
+    self.total = self.total + shape.area()
+    return shape.describe()
+
+counter = Counter()
+r = Rect(2, 3)
+s = Square(4)
+p = Shape('point')
+print counter.add(r), counter.add(s), counter.add(p)
+print counter.add(Rect(1, 5)), counter.add(Square(3)), counter.add(Shape('dot'))
+print counter.total
+)"sv;
+
+const string SHAPES_OUTPUT = "rect 6 square 16 point 0\nrect 5 square 9 dot 0\n36\n"s;
+
+string RunOnce(const Program& program) {
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    Run(program, context, closure);
+    return context.output.str();
+}
+
+void TestCompileAndRun() {
+    for (auto engine : {Engine::Ast, Engine::Vm}) {
+        auto program = Compile(SHAPES, {engine});
+        ASSERT(program.GetEngine() == engine);
+        ASSERT_EQUAL(RunOnce(program), SHAPES_OUTPUT);
+        // программа не изменяется при выполнении и может выполняться повторно
+        ASSERT_EQUAL(RunOnce(program), SHAPES_OUTPUT);
+    }
+    auto unoptimized = Compile(SHAPES, {Engine::Ast, opt::Level::O0});
+    ASSERT_EQUAL(RunOnce(unoptimized), SHAPES_OUTPUT);
+}
+
+void TestSeparateClosures() {
+    auto program = Compile("x = x + 1\nprint x\n"sv);
+    runtime::DummyContext context;
+    runtime::Closure first{{runtime::Symbol("x"s), runtime::ObjectHolder::Own(runtime::Number(1))}};
+    runtime::Closure second{{runtime::Symbol("x"s), runtime::ObjectHolder::Own(runtime::Number(10))}};
+    program.Run(context, first);
+    program.Run(context, second);
+    program.Run(context, first);
+    ASSERT_EQUAL(context.output.str(), "2\n11\n3\n"s);
+}
+
+void TestErrors() {
+    ASSERT_THROWS((void)Compile("class:\n"sv), parse::LexerError);
+    auto program = Compile("print 1 / 0\n"sv);
+    // ошибка выполнения не портит программу
+    for (int i = 0; i < 2; ++i) {
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        ASSERT_THROWS(program.Run(context, closure), std::runtime_error);
+    }
+}
+
+void TestConcurrentRuns() {
+    constexpr int THREADS = 8;
+    constexpr int RUNS = 50;
+    for (auto engine : {Engine::Ast, Engine::Vm}) {
+        const auto program = Compile(SHAPES, {engine});
+        vector<string> outputs(THREADS);
+        vector<thread> threads;
+        for (int t = 0; t < THREADS; ++t) {
+            threads.emplace_back([&program, &output = outputs[t]] {
+                // каждый поток выполняет программу со своими контекстом и переменными
+                for (int run = 0; run < RUNS; ++run) {
+                    output += RunOnce(program);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        string expected;
+        for (int run = 0; run < RUNS; ++run) {
+            expected += SHAPES_OUTPUT;
+        }
+        for (const auto& output : outputs) {
+            ASSERT_EQUAL(output, expected);
+        }
+    }
+}
+
+void TestCachedCompile() {
+    auto dir = std::filesystem::temp_directory_path() / "mython_interpreter_test";
+    std::filesystem::remove_all(dir);
+    for (int i = 0; i < 2; ++i) {
+        // первый раз программа разбирается и сохраняется, второй - загружается из кэша
+        auto program = Compile(SHAPES, {Engine::Vm, opt::Level::O1, dir});
+        ASSERT_EQUAL(RunOnce(program), SHAPES_OUTPUT);
+    }
+    ASSERT(!std::filesystem::is_empty(dir));
+    std::filesystem::remove_all(dir);
+}
+
+}  // namespace
+
+void RunInterpreterTests(TestRunner& tr) {
+    RUN_TEST(tr, mython::TestCompileAndRun);
+    RUN_TEST(tr, mython::TestSeparateClosures);
+    RUN_TEST(tr, mython::TestErrors);
+    RUN_TEST(tr, mython::TestConcurrentRuns);
+    RUN_TEST(tr, mython::TestCachedCompile);
+}
+
+}  // namespace mython
@@ -2,14 +2,18 @@
 
 #include <algorithm>
 #include <charconv>
-#include <unordered_map>
+#include <fstream>
+#include <iterator>
 
-using namespace std::literals;
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MYTHON_HAS_MMAP 1
+#endif
 
-namespace util {
-    extern std::unordered_map<std::string, parse::Token> KeyWords;
-    extern std::unordered_map<std::string, parse::Token> DualSymbols;
-}
+using namespace std::literals;
 
 namespace parse {
 
@@ -80,7 +84,48 @@ std::ostream& operator<<(std::ostream& os, const Token& rhs) {
     return os << "Unknown token :("sv;
 }
 
-Lexer::Lexer(std::istream& input) : input_{input} {
+MappedSource::MappedSource(const std::filesystem::path& path) {
+#ifdef MYTHON_HAS_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Can't open file "s + path.string());
+    }
+    struct stat st {};
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            data_ = static_cast<const char*>(data);
+            size_ = st.st_size;
+        }
+    }
+    ::close(fd);
+    if (data_ != nullptr || st.st_size == 0) {
+        return;
+    }
+#endif
+    // отображение недоступно - считываем файл целиком
+    std::ifstream input(path, std::ios::binary);
+    if (!input.is_open()) {
+        throw std::runtime_error("Can't open file "s + path.string());
+    }
+    buffer_.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+}
+
+MappedSource::~MappedSource() {
+#ifdef MYTHON_HAS_MMAP
+    if (data_ != nullptr && data_ != buffer_.data()) {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+#endif
+}
+
+Lexer::Lexer(std::istream& input) : input_(&input), pos_(nullptr), end_(nullptr) {
+    ReadNextToken();
+}
+
+Lexer::Lexer(std::string_view source) : pos_(source.data()), end_(source.data() + source.size()) {
     ReadNextToken();
 }
 
@@ -94,11 +139,12 @@ Token Lexer::NextToken() {
 }
 
 void Lexer::ReadNextToken() {
-    char ch = input_.peek();
-    if (ch == std::ios::traits_type::eof()) { // дошли до конца файла
+    if (pos_ == end_ && !ReadInputLine(false)) { // дошли до конца файла
         ParseEOF();
+        return;
     }
-    else if (ch == '\n') { // дошли до конца строки
+    char ch = *pos_;
+    if (ch == '\n') { // дошли до конца строки
         ParseLineEnd();
     }
     else if (ch == '#') { // дошли до комментария
@@ -117,20 +163,42 @@ void Lexer::ReadNextToken() {
     }
 }
 
+bool Lexer::ReadInputLine(bool append) {
+    if (input_ == nullptr) {
+        return false;
+    }
+    size_t offset = pos_ - buffer_.data();
+    if (append) {
+        std::string line;
+        if (!std::getline(*input_, line)) {
+            return false;
+        }
+        buffer_ += line;
+    } else {
+        // буфер используется повторно: лексемы предыдущих строк больше не нужны
+        offset = 0;
+        unescaped_.clear();
+        if (!std::getline(*input_, buffer_)) {
+            pos_ = end_ = buffer_.data();
+            return false;
+        }
+    }
+    if (!input_->eof()) {
+        buffer_ += '\n';
+    }
+    pos_ = buffer_.data() + offset;
+    end_ = buffer_.data() + buffer_.size();
+    return true;
+}
+
 void Lexer::NextLine() {
-    util::ReadLine(input_);
+    util::ReadLine(pos_, end_);
     start_of_line_ = true;
     line_indent_ = 0;
 }
 
 void Lexer::ParseComment() {
-    char c;
-    while (input_.get(c)) {
-        if (c == '\n') {
-            input_.putback(c);
-            break;
-        }
-    }
+    pos_ = std::find(pos_, end_, '\n');
     ReadNextToken();
 }
 
@@ -159,7 +227,7 @@ void Lexer::ParseLineEnd() {
 }
 
 void Lexer::ParseSpaces() {
-    auto spaces_count = util::CountSpaces(input_);
+    auto spaces_count = util::CountSpaces(pos_, end_);
     if (start_of_line_) { // если это начало строки - записываем отступ
         line_indent_ = spaces_count / 2;
     }
@@ -177,37 +245,57 @@ void Lexer::ParseIndent() {
 }
 
 void Lexer::ParseToken() {
-    char ch = input_.peek();
+    char ch = *pos_;
     if (util::IsNum(ch)) {   // если следующий токен - число
-        current_token_ = token_type::Number{util::ReadNumber(input_)};
+        current_token_ = token_type::Number{util::ReadNumber(pos_, end_)};
     } else if (util::IsAlNumLL(ch)) {    // если следующий токен - имя
         ParseName();
     } else if (ch == '\"' || ch == '\'') { // если следующий токен строка
-        current_token_ = token_type::String{util::ReadString(input_)};
+        ParseString();
     } else { // во всех остальных случаях считаем что следующий токен - символ
         ParseChar();
     }
 }
 
 void Lexer::ParseName() {
-    auto name = util::ReadName(input_);
-    if (util::KeyWords.count(name) != 0) { // если это ключевое слово - присваиваем соответсвующий токен
-        current_token_ = util::KeyWords.at(name);
+    auto name = util::ReadName(pos_, end_);
+    if (auto keyword = util::FindKeyWord(name)) { // если это ключевое слово - присваиваем соответсвующий токен
+        current_token_ = *keyword;
     } else { // иначе считаем что это Id
-        current_token_ = token_type::Id{name};
+        current_token_ = token_type::Id{runtime::Symbol(name)};
+    }
+}
+
+void Lexer::ParseString() {
+    bool has_escapes = false;
+    auto raw = util::ReadString(pos_, end_, has_escapes);
+    // при чтении из потока строковая константа может продолжаться на следующих строках
+    while (!raw && ReadInputLine(true)) {
+        raw = util::ReadString(pos_, end_, has_escapes);
+    }
+    // если текст закончился раньше закрывающей кавычки, значит строка составлена некорректно
+    if (!raw) {
+        throw std::runtime_error("Failed to parse string : "s
+                                 + util::Unescape({pos_ + 1, static_cast<size_t>(end_ - pos_ - 1)}));
+    }
+    if (has_escapes) { // строку с экранированными символами приходится хранить отдельно
+        current_token_ = token_type::String{unescaped_.emplace_back(util::Unescape(*raw))};
+    } else {
+        current_token_ = token_type::String{*raw};
     }
 }
 
 void Lexer::ParseChar() {
-    std::string sym_pair;
-    sym_pair += input_.get();
-    sym_pair += input_.peek();
-    if (util::DualSymbols.count(sym_pair)) { // если пара символов подряд - это лексема, то присваиваем
-        current_token_ = util::DualSymbols.at(sym_pair);
-        input_.get();
-    } else { // иначе берём только один символ
-      current_token_ = token_type::Char{sym_pair[0]};
+    char first = *pos_++;
+    if (pos_ != end_) {
+        if (auto symbol = util::FindDualSymbol(first, *pos_)) { // если пара символов подряд - это лексема, то присваиваем
+            current_token_ = *symbol;
+            ++pos_;
+            return;
+        }
     }
+    // иначе берём только один символ
+    current_token_ = token_type::Char{first};
 }
 
 }  // namespace parse
@@ -230,87 +318,129 @@ bool IsAlNumLL(char ch) {
     return IsAlNum(ch) || ch == '_';
 }
 
-std::string ReadString(std::istream& input) {
-    std::string line;
-    // считываем поток посимвольно, до конца строки либо до неэкранированной закрывающей кавычки
-    char first = input.get(); // первая кавычка : ' или "
-    char c;
-    while (input.get(c)) {
-        if (c == '\\') {
-            char next;
-            input.get(next);
-            if (next == '\"') {
-                line += '\"';
-            } else if (next == '\'') {
-                line += '\'';
-            } else if (next == 'n') {
-                line += '\n';
-            } else if (next == 't') {
-                line += '\t';
-            }
-        } else {
-            if (c == first) {
+std::optional<parse::Token> FindKeyWord(std::string_view name) {
+    using namespace parse::token_type;
+    // ключевые слова однозначно различаются длиной и первым символом
+    switch (name.size()) {
+        case 2:
+            if (name == "if"sv) return If{};
+            if (name == "or"sv) return Or{};
+            break;
+        case 3:
+            if (name == "def"sv) return Def{};
+            if (name == "and"sv) return And{};
+            if (name == "not"sv) return Not{};
+            break;
+        case 4:
+            if (name == "else"sv) return Else{};
+            if (name == "None"sv) return None{};
+            if (name == "True"sv) return True{};
+            break;
+        case 5:
+            if (name == "class"sv) return Class{};
+            if (name == "print"sv) return Print{};
+            if (name == "False"sv) return False{};
+            break;
+        case 6:
+            if (name == "return"sv) return Return{};
+            break;
+    }
+    return std::nullopt;
+}
+
+std::optional<parse::Token> FindDualSymbol(char first, char second) {
+    using namespace parse::token_type;
+    if (second != '=') {
+        return std::nullopt;
+    }
+    switch (first) {
+        case '=': return Eq{};
+        case '!': return NotEq{};
+        case '>': return GreaterOrEq{};
+        case '<': return LessOrEq{};
+    }
+    return std::nullopt;
+}
+
+std::optional<std::string_view> ReadString(const char*& pos, const char* end, bool& has_escapes) {
+    // считываем текст до неэкранированной закрывающей кавычки
+    const char first = *pos; // первая кавычка : ' или "
+    const char* begin = pos + 1;
+    const char* it = begin;
+    has_escapes = false;
+    while (it != end && *it != first) {
+        if (*it == '\\') {
+            has_escapes = true;
+            if (++it == end) {
                 break;
             }
-            line += c;
         }
+        ++it;
     }
-    // если последний знак был не закрывающей кавчикой, значит строка составлена некорректно
-    if (c != first) {
-        throw std::runtime_error("Failed to parse string : "s + line);
+    if (it == end) {
+        return std::nullopt;
     }
-    return line;
+    pos = it + 1;
+    return std::string_view(begin, it - begin);
 }
 
-std::string ReadName(std::istream &input) {
+std::string Unescape(std::string_view raw) {
     std::string line;
-    char c;
-    while (input.get(c)) {
-        if (IsAlNumLL(c)) {
-            line += c;
-        } else {
-            input.putback(c);
+    line.reserve(raw.size());
+    for (size_t i = 0; i < raw.size(); ++i) {
+        if (raw[i] != '\\') {
+            line += raw[i];
+            continue;
+        }
+        if (++i == raw.size()) {
             break;
         }
+        char next = raw[i];
+        if (next == '\"') {
+            line += '\"';
+        } else if (next == '\'') {
+            line += '\'';
+        } else if (next == 'n') {
+            line += '\n';
+        } else if (next == 't') {
+            line += '\t';
+        }
     }
     return line;
 }
 
-size_t CountSpaces(std::istream &input) {
-    size_t result = 0;
-    char c;
-    while (input.get(c)) {
-        if (c == ' ') {
-            ++result;
-        } else {
-            input.putback(c);
-            break;
-        }
-    }
-    return result;
+std::string_view ReadName(const char*& pos, const char* end) {
+    const char* begin = pos;
+    pos = std::find_if_not(pos, end, IsAlNumLL);
+    return {begin, static_cast<size_t>(pos - begin)};
 }
 
-std::string ReadLine(std::istream &input) {
-    std::string s;
-    getline(input, s);
-    return s;
+size_t CountSpaces(const char*& pos, const char* end) {
+    const char* begin = pos;
+    pos = std::find_if(pos, end, [](char c) {
+        return c != ' ';
+    });
+    return pos - begin;
 }
 
-int ReadNumber(std::istream &input) {
-    std::string num;
-    char c;
-    while(input.get(c)) {
-        if (IsNum(c)) {
-            num += c;
-        } else {
-            input.putback(c);
-            break;
-        }
+std::string_view ReadLine(const char*& pos, const char* end) {
+    const char* begin = pos;
+    pos = std::find(pos, end, '\n');
+    std::string_view line(begin, pos - begin);
+    if (pos != end) {
+        ++pos;
     }
-    if (num.empty()) {
-        return 0;
+    return line;
+}
+
+int ReadNumber(const char*& pos, const char* end) {
+    const char* begin = pos;
+    pos = std::find_if_not(pos, end, IsNum);
+    int result = 0;
+    if (std::from_chars(begin, pos, result).ec == std::errc::result_out_of_range) {
+        throw parse::LexerError("Number is out of range : "s + std::string(begin, pos));
     }
-    return std::stoi(num);
+    return result;
 }
 
 } // namespace util
@@ -1,6 +1,8 @@
 #include "lexer.h"
 #include "test_runner_p.h"
 
+#include <filesystem>
+#include <fstream>
 #include <sstream>
 #include <string>
 
@@ -351,6 +353,82 @@ abc#
         ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
     }
 }
+
+void TestKeywordLookalikes() {
+    istringstream input("clas classes iff Print none retur returns el = ! < >"s);
+    Lexer lexer(input);
+
+    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id{"clas"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"classes"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"iff"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"Print"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"none"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"retur"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"returns"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"el"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'!'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'<'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'>'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+}
+
+void TestStringViewSource() {
+    const string source = R"(x = 'plain' + "esc\"aped"
+if x:
+  print x, 12345
+)"s;
+    const auto in_source = [&source](string_view value) {
+        return value.data() >= source.data() && value.data() + value.size() <= source.data() + source.size();
+    };
+
+    Lexer lexer(string_view{source});
+    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id{"x"s}));
+    // идентификаторы интернируются: одинаковые имена дают один и тот же символ
+    ASSERT_EQUAL(lexer.CurrentToken().As<token_type::Id>().value.Id(), runtime::Symbol("x"s).Id());
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"plain"s}));
+    ASSERT(in_source(lexer.CurrentToken().As<token_type::String>().value));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'+'}));
+    // строка с экранированными символами хранится в лексере
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"esc\"aped"s}));
+    ASSERT(!in_source(lexer.CurrentToken().As<token_type::String>().value));
+
+    // разбор потока и разбор буфера дают одинаковые лексемы
+    istringstream input(source);
+    Lexer stream_lexer(input);
+    Lexer view_lexer(string_view{source});
+    while (!view_lexer.CurrentToken().Is<token_type::Eof>()) {
+        ASSERT_EQUAL(stream_lexer.CurrentToken(), view_lexer.CurrentToken());
+        stream_lexer.NextToken();
+        view_lexer.NextToken();
+    }
+    ASSERT_EQUAL(stream_lexer.CurrentToken(), Token(token_type::Eof{}));
+
+    Lexer unterminated(string_view{"x = 'unterminated"});
+    ASSERT_EQUAL(unterminated.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_THROWS(unterminated.NextToken(), std::runtime_error);
+}
+
+void TestMappedSource() {
+    const auto path = std::filesystem::temp_directory_path() / "mython_lexer_test.my";
+    const string source = "print 'mapped'\n"s;
+    {
+        std::ofstream out(path, std::ios::binary);
+        out << source;
+    }
+    {
+        MappedSource mapped(path);
+        ASSERT_EQUAL(mapped.View(), source);
+        Lexer lexer(mapped.View());
+        ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Print{}));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"mapped"s}));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+    }
+    std::filesystem::remove(path);
+    ASSERT_THROWS(MappedSource{path}, std::runtime_error);
+}
 }  // namespace
 
 void RunOpenLexerTests(TestRunner& tr) {
@@ -367,6 +445,9 @@ void RunOpenLexerTests(TestRunner& tr) {
     RUN_TEST(tr, parse::TestMythonProgram);
     RUN_TEST(tr, parse::TestAlwaysEmitsNewlineAtTheEndOfNonemptyLine);
     RUN_TEST(tr, parse::TestCommentsAreIgnored);
+    RUN_TEST(tr, parse::TestKeywordLookalikes);
+    RUN_TEST(tr, parse::TestStringViewSource);
+    RUN_TEST(tr, parse::TestMappedSource);
 }
 
 }  // namespace parse
@@ -1,50 +1,386 @@
+#include "batch.h"
+#include "budget.h"
+#include "collector.h"
+#include "interpreter.h"
 #include "lexer.h"
+#include "optimizer.h"
 #include "parse.h"
+#include "profiler.h"
 #include "runtime.h"
 #include "statement.h"
+#include "stats.h"
 
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <optional>
 
 using namespace std;
 
 namespace {
 
-void RunMythonProgram(istream& input, ostream& output) {
-    parse::Lexer lexer(input);
+using mython::Engine;
+
+// Имя файла, означающее стандартный ввод или стандартный вывод
+const std::filesystem::path STANDARD_STREAM = "-";
+
+const string_view CACHE_OPTION = "--cache="sv;
+const string_view PROFILE_OPTION = "--profile="sv;
+const string_view BATCH_OPTION = "--batch="sv;
+const string_view JOBS_OPTION = "--jobs="sv;
+const string_view PARSE_JOBS_OPTION = "--parse-jobs="sv;
+const string_view MAX_STEPS_OPTION = "--max-steps="sv;
+const string_view MAX_DEPTH_OPTION = "--max-depth="sv;
+const string_view MAX_HEAP_OPTION = "--max-heap="sv;
+const string_view MAX_TIME_OPTION = "--max-time="sv;
+
+struct Options {
+    Engine engine = Engine::Ast;
+    // выполнять каждую инструкцию верхнего уровня сразу после её разбора
+    bool stream = false;
+    // момент, в который накопленный вывод программы передаётся в выходной поток
+    runtime::FlushPolicy flush = runtime::FlushPolicy::Threshold;
+    // каталог кэша разобранных программ; пустой путь - кэш не используется
+    std::filesystem::path cache_dir;
+    opt::Level optimization = opt::Level::O1;
+    // файл для стеков вызовов профилировщика; пустой путь - профилирование выключено
+    std::filesystem::path profile_path;
+    // вывести в поток ошибок статистику выполнения программы
+    bool stats = false;
+    // файл со списком заданий пакетного режима; пустой путь - выполняется одна программа
+    std::filesystem::path batch_path;
+    // количество потоков пакетного режима; 0 - по количеству ядер процессора
+    size_t jobs = 0;
+    // количество потоков разбора программы; 1 - последовательный разбор
+    size_t parse_jobs = 1;
+    // пределы выполнения каждой программы
+    runtime::ExecutionLimits limits;
+    std::filesystem::path in_path = STANDARD_STREAM;
+    std::filesystem::path out_path = STANDARD_STREAM;
+};
+
+// Разбирает количество потоков из параметра запуска
+optional<size_t> ParseCount(string_view digits) {
+    if (digits.empty() || digits.size() > 4
+        || digits.find_first_not_of("0123456789"sv) != string_view::npos) {
+        return nullopt;
+    }
+    return stoul(string(digits));
+}
+
+// Разбирает значение предела выполнения из параметра запуска
+optional<uint64_t> ParseLimit(string_view digits) {
+    if (digits.empty() || digits.size() > 18
+        || digits.find_first_not_of("0123456789"sv) != string_view::npos) {
+        return nullopt;
+    }
+    return stoull(string(digits));
+}
+
+optional<Options> ParseOptions(int argc, const char** argv) {
+    Options options;
+    vector<string_view> positional;
+    for (int i = 1; i < argc; ++i) {
+        string_view arg = argv[i];
+        if (arg == "--engine=ast"sv) {
+            options.engine = Engine::Ast;
+        } else if (arg == "--engine=vm"sv) {
+            options.engine = Engine::Vm;
+        } else if (arg == "--stats"sv) {
+            options.stats = true;
+        } else if (arg == "--stream"sv) {
+            options.stream = true;
+        } else if (arg == "-O0"sv) {
+            options.optimization = opt::Level::O0;
+        } else if (arg == "-O1"sv) {
+            options.optimization = opt::Level::O1;
+        } else if (arg == "--flush=exit"sv) {
+            options.flush = runtime::FlushPolicy::OnExit;
+        } else if (arg == "--flush=size"sv) {
+            options.flush = runtime::FlushPolicy::Threshold;
+        } else if (arg == "--flush=line"sv) {
+            options.flush = runtime::FlushPolicy::Line;
+        } else if (arg.substr(0, CACHE_OPTION.size()) == CACHE_OPTION
+                   && arg.size() > CACHE_OPTION.size()) {
+            options.cache_dir = arg.substr(CACHE_OPTION.size());
+        } else if (arg.substr(0, PROFILE_OPTION.size()) == PROFILE_OPTION
+                   && arg.size() > PROFILE_OPTION.size()) {
+            options.profile_path = arg.substr(PROFILE_OPTION.size());
+        } else if (arg.substr(0, BATCH_OPTION.size()) == BATCH_OPTION
+                   && arg.size() > BATCH_OPTION.size()) {
+            options.batch_path = arg.substr(BATCH_OPTION.size());
+        } else if (arg.substr(0, JOBS_OPTION.size()) == JOBS_OPTION) {
+            auto count = ParseCount(arg.substr(JOBS_OPTION.size()));
+            if (!count) {
+                return nullopt;
+            }
+            options.jobs = *count;
+        } else if (arg.substr(0, PARSE_JOBS_OPTION.size()) == PARSE_JOBS_OPTION) {
+            auto count = ParseCount(arg.substr(PARSE_JOBS_OPTION.size()));
+            if (!count) {
+                return nullopt;
+            }
+            options.parse_jobs = *count;
+        } else if (arg.substr(0, MAX_STEPS_OPTION.size()) == MAX_STEPS_OPTION) {
+            auto limit = ParseLimit(arg.substr(MAX_STEPS_OPTION.size()));
+            if (!limit) {
+                return nullopt;
+            }
+            options.limits.max_steps = *limit;
+        } else if (arg.substr(0, MAX_DEPTH_OPTION.size()) == MAX_DEPTH_OPTION) {
+            auto limit = ParseLimit(arg.substr(MAX_DEPTH_OPTION.size()));
+            if (!limit) {
+                return nullopt;
+            }
+            options.limits.max_depth = *limit;
+        } else if (arg.substr(0, MAX_HEAP_OPTION.size()) == MAX_HEAP_OPTION) {
+            auto limit = ParseLimit(arg.substr(MAX_HEAP_OPTION.size()));
+            if (!limit) {
+                return nullopt;
+            }
+            options.limits.max_heap_bytes = *limit;
+        } else if (arg.substr(0, MAX_TIME_OPTION.size()) == MAX_TIME_OPTION) {
+            auto limit = ParseLimit(arg.substr(MAX_TIME_OPTION.size()));
+            if (!limit) {
+                return nullopt;
+            }
+            options.limits.max_time = chrono::milliseconds(*limit);
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    // в пакетном режиме файлы берутся из списка заданий. Профилировщик не поддерживает
+    // одновременную работу нескольких потоков, поэтому в пакетном режиме недоступен
+    if (!options.batch_path.empty()) {
+        if (!positional.empty() || options.stream || !options.profile_path.empty()) {
+            return nullopt;
+        }
+        return options;
+    }
+    // в потоковом режиме файлы можно не указывать, тогда используются стандартные потоки.
+    // Потоковый режим работает только с интерпретатором дерева: байт-код методов класса
+    // пришлось бы хранить дольше, чем живёт объявившая класс инструкция, а кэш программ
+    // требует всего текста программы
+    if (options.stream ? ((positional.size() != 0 && positional.size() != 2)
+                          || options.engine != Engine::Ast || !options.cache_dir.empty())
+                       : positional.size() != 2) {
+        return nullopt;
+    }
+    if (!positional.empty()) {
+        options.in_path = positional[0];
+        options.out_path = positional[1];
+    }
+    return options;
+}
+
+/*
+ * Подключает к контексту профилировщик, если он запрошен параметрами запуска. При уничтожении
+ * записывает стеки вызовов в файл, а таблицу статистики методов - в поток ошибок, так что
+ * результаты сохраняются и при завершении программы с ошибкой
+ */
+class ProfileSession {
+public:
+    ProfileSession(runtime::Context& context, const Options& options)
+        : path_(options.profile_path) {
+        if (!path_.empty()) {
+            context.SetProfiler(&profiler_);
+        }
+    }
 
-    auto program = ParseProgram(lexer);
+    ProfileSession(const ProfileSession&) = delete;
+    ProfileSession& operator=(const ProfileSession&) = delete;
 
-    runtime::SimpleContext context{output};
+    ~ProfileSession() {
+        if (path_.empty()) {
+            return;
+        }
+        ofstream out(path_);
+        profiler_.WriteCollapsedStacks(out);
+        if (!out) {
+            cerr << "Can't write profile to "s << path_ << endl;
+        }
+        profiler_.WriteReport(cerr);
+    }
+
+private:
+    std::filesystem::path path_;
+    runtime::Profiler profiler_;
+};
+
+void PrintStats(const runtime::StatsSnapshot& stats) {
+    cerr << "statements: "sv << stats.statements << '\n'
+         << "method calls: "sv << stats.method_calls << '\n'
+         << "objects allocated: "sv << stats.objects_allocated << '\n'
+         << "live objects: "sv << stats.LiveObjects() << '\n'
+         << "closure lookups: "sv << stats.closure_lookups << '\n'
+         << "output bytes: "sv << stats.output_bytes << '\n';
+}
+
+// Подключает к контексту статистику выполнения, если она запрошена параметрами запуска,
+// и выводит её в поток ошибок при уничтожении
+class StatsSession {
+public:
+    StatsSession(runtime::Context& context, const Options& options)
+        : context_(context), enabled_(options.stats) {
+        if (enabled_) {
+            context_.SetStats(&stats_);
+        }
+    }
+
+    StatsSession(const StatsSession&) = delete;
+    StatsSession& operator=(const StatsSession&) = delete;
+
+    ~StatsSession() {
+        if (!enabled_) {
+            return;
+        }
+        context_.SetStats(nullptr);
+        PrintStats(stats_.Collect());
+        auto gc = runtime::CycleCollector::ForCurrentThread().GetStats();
+        cerr << "cycle collections: "sv << gc.collections << '\n'
+             << "collected instances: "sv << gc.collected << '\n'
+             << "collection pause max/total us: "sv << gc.max_pause.count() / 1000 << '/'
+             << gc.total_pause.count() / 1000 << endl;
+    }
+
+private:
+    runtime::Context& context_;
+    bool enabled_;
+    runtime::ExecutionStats stats_;
+};
+
+void RunMythonProgram(string_view source, ostream& output, const Options& options) {
+    auto program = mython::Compile(source, {options.engine, options.optimization,
+                                            options.cache_dir, options.parse_jobs});
+    runtime::Budget budget(options.limits);
+    runtime::SimpleContext context{output, options.flush};
+    if (!options.limits.IsUnlimited()) {
+        context.SetBudget(&budget);
+    }
+    ProfileSession profile(context, options);
+    // статистика отключается после уничтожения переменных программы
+    StatsSession stats(context, options);
     runtime::Closure closure;
-    program->Execute(closure, context);
+    mython::Run(program, context, closure);
+}
+
+// Разбирает и сразу выполняет инструкции верхнего уровня по одной, пока не закончится input.
+// Разобранная инструкция уничтожается после выполнения, поэтому расход памяти не растёт
+// с длиной программы
+void StreamMythonProgram(istream& input, ostream& output, const Options& options) {
+    parse::Lexer lexer(input);
+    StatementParser parser(lexer);
+
+    runtime::Budget budget(options.limits);
+    runtime::SimpleContext context{output, options.flush};
+    if (!options.limits.IsUnlimited()) {
+        context.SetBudget(&budget);
+    }
+    ProfileSession profile(context, options);
+    // статистика отключается после уничтожения переменных программы
+    StatsSession stats(context, options);
+    runtime::Closure closure;
+    while (auto statement = parser.ParseNext()) {
+        opt::Optimize(statement, options.optimization);
+        statement->Execute(closure, context);
+        // вывод инструкции должен появиться до того, как будет прочитана следующая,
+        // если только пользователь явно не отложил вывод до завершения программы
+        if (options.flush != runtime::FlushPolicy::OnExit) {
+            context.GetOutputStream().flush();
+        }
+    }
+}
+
+// Выполняет задания из списка options.batch_path и выводит в поток ошибок ошибки заданий
+// и пропускную способность. Возвращает код завершения: 1, если хотя бы одно задание не выполнено
+int RunMythonBatch(const Options& options) {
+    ifstream manifest(options.batch_path);
+    if (!manifest.is_open()) {
+        throw std::runtime_error("Can't open file "s + options.batch_path.string());
+    }
+    auto jobs = mython::ReadManifest(manifest, options.batch_path.parent_path());
+
+    runtime::ExecutionStats stats;
+    mython::BatchOptions batch_options;
+    batch_options.compile = {options.engine, options.optimization, options.cache_dir,
+                             options.parse_jobs};
+    batch_options.flush = options.flush;
+    batch_options.threads = options.jobs;
+    batch_options.limits = options.limits;
+    batch_options.stats = options.stats ? &stats : nullptr;
+    auto report = mython::RunBatch(jobs, batch_options);
+
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        if (!report.errors[i].empty()) {
+            cerr << jobs[i].input.string() << ": "sv << report.errors[i] << '\n';
+        }
+    }
+    cerr << "jobs: "sv << report.jobs << " (failed: "sv << report.failed << ")\n"sv
+         << "compiled programs: "sv << report.compiled << '\n'
+         << "threads: "sv << report.threads << " (stolen jobs: "sv << report.stolen << ")\n"sv
+         << "elapsed ms: "sv << report.elapsed.count() / 1000000 << '\n'
+         << "jobs per second: "sv << report.JobsPerSecond() << endl;
+    if (options.stats) {
+        PrintStats(stats.Collect());
+    }
+    return report.failed == 0 ? 0 : 1;
 }
 
 }
 
 int main(int argc, const char** argv) {
-    if (argc != 3) {
+    auto options = ParseOptions(argc, argv);
+    if (!options) {
             cerr << "Mython interpreter!"sv << endl;
             std::filesystem::path interpreter = argv[0];
-            cerr << "Usage: "sv << interpreter.filename() << " <in_file> <out_file>"sv << endl;
+            cerr << "Usage: "sv << interpreter.filename()
+                 << " [--engine=ast|vm] [-O0|-O1] [--flush=exit|size|line] [--cache=<dir>]"sv
+                 << " [--parse-jobs=N] [--profile=<file>] [--stats] [<limits>] <in_file> <out_file>"sv
+                 << endl;
+            cerr << "       "sv << interpreter.filename()
+                 << " --stream [-O0|-O1] [--flush=exit|size|line] [--profile=<file>]"sv
+                 << " [--stats] [<limits>] [<in_file> <out_file>]"sv << endl;
+            cerr << "       "sv << interpreter.filename()
+                 << " --batch=<manifest> [--jobs=N] [--engine=ast|vm] [-O0|-O1]"sv
+                 << " [--flush=exit|size|line] [--cache=<dir>] [--stats] [<limits>]"sv << endl;
+            cerr << "Limits: --max-steps=N --max-depth=N --max-heap=<bytes> --max-time=<ms>"sv
+                 << endl;
             return 1;
     }
 
-    std::filesystem::path in_path = argv[1];
-    std::filesystem::path out_path = argv[2];
-
-    ifstream ifile(in_path);
-    if (!ifile.is_open()) {
-        std::cerr << "Can't open file "s << in_path << endl;
+    if (!options->batch_path.empty()) {
+        try {
+            return RunMythonBatch(*options);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
     }
-    ofstream ofile(out_path);
-    if (!ofile.is_open()) {
-        std::cerr << "Can't open file "s << out_path << endl;
+
+    ofstream ofile;
+    if (options->out_path != STANDARD_STREAM) {
+        ofile.open(options->out_path);
+        if (!ofile.is_open()) {
+            std::cerr << "Can't open file "s << options->out_path << endl;
+        }
     }
+    ostream& output = options->out_path != STANDARD_STREAM ? ofile : cout;
 
     try {
-        RunMythonProgram(ifile, ofile);
+        if (options->stream) {
+            ifstream ifile;
+            if (options->in_path != STANDARD_STREAM) {
+                ifile.open(options->in_path);
+                if (!ifile.is_open()) {
+                    throw std::runtime_error("Can't open file "s + options->in_path.string());
+                }
+            }
+            StreamMythonProgram(options->in_path != STANDARD_STREAM ? ifile : cin, output,
+                                *options);
+        } else {
+            parse::MappedSource source(options->in_path);
+            RunMythonProgram(source.View(), output, *options);
+        }
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
         return 1;
@@ -0,0 +1,449 @@
+#include "bytecode.h"
+#include "lexer.h"
+#include "parse.h"
+#include "program_cache.h"
+#include "runtime.h"
+#include "statement.h"
+#include "vm.h"
+#include "bench_runner_p.h"
+
+#include <sstream>
+#include <string_view>
+
+using namespace std;
+
+namespace {
+
+// Разбирает и компилирует программу один раз, замеряется только её исполнение
+class PreparedProgram {
+public:
+    explicit PreparedProgram(const string& source)
+        : program_(Parse(source)), bytecode_(vm::Compile(*program_)) {
+    }
+
+    void Run() const {
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        program_->Execute(closure, context);
+    }
+
+    void RunVm() const {
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        vm::Run(bytecode_, closure, context);
+    }
+
+    // Выполняет программу с буферизованным выводом в строку
+    void RunBuffered(runtime::FlushPolicy policy) const {
+        ostringstream output;
+        runtime::SimpleContext context{output, policy};
+        runtime::Closure closure;
+        program_->Execute(closure, context);
+    }
+
+private:
+    static unique_ptr<ast::Statement> Parse(const string& source) {
+        istringstream input(source);
+        parse::Lexer lexer(input);
+        return ParseProgram(lexer);
+    }
+
+    unique_ptr<ast::Statement> program_;
+    vm::Program bytecode_;
+};
+
+// Глубокая рекурсия: каждый уровень завершается инструкцией return
+const PreparedProgram& DeepRecursion() {
+    static const PreparedProgram program(R"(
+class Sum:
+  def calc(n):
+    if n == 0:
+      return 0
+    return n + self.calc(n - 1)
+
+x = Sum()
+x.calc(2000)
+)");
+    return program;
+}
+
+// Двойная рекурсия с большим количеством коротких вызовов
+const PreparedProgram& Fibonacci() {
+    static const PreparedProgram program(R"(
+class Fib:
+  def calc(n):
+    if n < 2:
+      return n
+    return self.calc(n - 1) + self.calc(n - 2)
+
+x = Fib()
+x.calc(18)
+)");
+    return program;
+}
+
+// Пример НОД из README
+const PreparedProgram& Gcd() {
+    static const PreparedProgram program(R"(
+class GCD:
+  def calc(a, b):
+    if a < b:
+      return self.calc(b, a)
+    if b == 0:
+      return a
+    return self.calc(a - b, b)
+
+x = GCD()
+x.calc(510510, 18629977)
+)");
+    return program;
+}
+
+// Сравнение объектов пользовательского класса через __eq__ и __lt__
+const PreparedProgram& ObjectComparison() {
+    static const PreparedProgram program(R"(
+class Money:
+  def __init__(amount):
+    self.amount = amount
+
+  def __eq__(other):
+    return self.amount == other.amount
+
+  def __lt__(other):
+    return self.amount < other.amount
+
+class Counter:
+  def count(n, a, b):
+    if n == 0:
+      return 0
+    result = self.count(n - 1, a, b)
+    if a < b and not a == b and b >= a:
+      result = result + 1
+    return result
+
+x = Counter()
+x.count(1000, Money(1), Money(2))
+)");
+    return program;
+}
+
+// Вызовы методов, объявленных на разной глубине цепочки из 12 наследников, и метода,
+// переопределённого в самом нижнем классе
+string InheritanceSource() {
+    constexpr int depth = 12;
+    ostringstream out;
+    out << "class Level0:\n"
+        << "  def step():\n"
+        << "    return 1\n\n"
+        << "  def run(n):\n"
+        << "    if n == 0:\n"
+        << "      return 0\n"
+        << "    return self.step() + self.level0() + self.level" << depth / 2 << "()"
+        << " + self.level" << depth - 1 << "() + self.run(n - 1)\n\n"
+        << "  def level0():\n"
+        << "    return 0\n\n";
+    for (int i = 1; i < depth; ++i) {
+        out << "class Level" << i << "(Level" << i - 1 << "):\n"
+            << "  def level" << i << "():\n"
+            << "    return " << i << "\n\n";
+    }
+    out << "class Leaf(Level" << depth - 1 << "):\n"
+        << "  def step():\n"
+        << "    return 2\n\n"
+        << "x = Leaf()\n"
+        << "x.run(1000)\n";
+    return out.str();
+}
+
+const PreparedProgram& DeepInheritance() {
+    static const PreparedProgram program(InheritanceSource());
+    return program;
+}
+
+// Сборка строки из 1000 частей через метод __add__ пользовательского класса.
+// Класс не может создать свой экземпляр в собственном методе, поэтому __add__ дописывает
+// строку к self
+const PreparedProgram& StringConcat() {
+    static const PreparedProgram program(R"(
+class Text:
+  def __init__(s):
+    self.s = s
+
+  def __add__(other):
+    self.s = self.s + other.s
+    return self
+
+class Builder:
+  def build(n, acc, piece):
+    if n == 0:
+      return acc
+    return self.build(n - 1, acc + piece, piece)
+
+b = Builder()
+piece = Text('abc')
+r = b.build(1000, Text(''), piece)
+)");
+    return program;
+}
+
+// Создание большого количества небольших объектов: 2^20 экземпляров за одно выполнение
+const PreparedProgram& ObjectStorm() {
+    static const PreparedProgram program(R"(
+class Point:
+  def __init__(x, y):
+    self.x = x
+    self.y = y
+
+class Storm:
+  def make(n):
+    if n == 0:
+      p = Point(n, 1)
+      return p.y
+    return self.make(n - 1) + self.make(n - 1)
+
+x = Storm()
+x.make(20)
+)");
+    return program;
+}
+
+// Накладные расходы вызова метода с argc параметрами (включая счётчик n): 2^15 - 1 вызовов.
+// При argc > ArgumentBuffer::INLINE_CAPACITY аргументы не помещаются во встроенный буфер
+string CallsSource(int argc) {
+    string params = "n";
+    string args = "n - 1";
+    for (int i = 1; i < argc; ++i) {
+        params += ", a"s + to_string(i);
+        args += ", a"s + to_string(i);
+    }
+    string initial = "14";
+    for (int i = 1; i < argc; ++i) {
+        initial += ", "s + to_string(i);
+    }
+    return "class Calls:\n"s
+           + "  def f(" + params + "):\n"
+           + "    if n == 0:\n"
+           + "      return 1\n"
+           + "    return self.f(" + args + ") + self.f(" + args + ")\n\n"
+           + "x = Calls()\n"
+           + "x.f(" + initial + ")\n";
+}
+
+const PreparedProgram& Calls(int argc) {
+    static const PreparedProgram one(CallsSource(1));
+    static const PreparedProgram four(CallsSource(4));
+    static const PreparedProgram six(CallsSource(6));
+    return argc == 1 ? one : argc == 4 ? four : six;
+}
+
+// Вывод большого количества строк с числами
+const PreparedProgram& PrintLoop() {
+    static const PreparedProgram program(R"(
+class Printer:
+  def run(n):
+    if n == 0:
+      return 0
+    print n, n * 1000, 'item', None
+    return self.run(n - 1)
+
+x = Printer()
+x.run(2000)
+)");
+    return program;
+}
+
+// Сгенерированный скрипт из classes классов для замера скорости лексического анализа и разбора
+string GenerateScript(int classes) {
+    ostringstream out;
+    for (int i = 0; i < classes; ++i) {
+        out << "class Generated" << i << ":\n"
+            << "  def method(value, other):\n"
+            << "    # comment line " << i << "\n"
+            << "    if value >= " << i << " and other != None:\n"
+            << "      return 'text' + str(value * 12345)\n"
+            << "    return \"escaped\\ttext\"\n\n";
+    }
+    return out.str();
+}
+
+const string& GeneratedScript() {
+    static const string script = GenerateScript(2000);
+    return script;
+}
+
+// Сгенерированный скрипт размером около 4 МБ
+const string& LargeScript() {
+    static const string script = GenerateScript(25000);
+    return script;
+}
+
+template <typename Source>
+void LexAll(Source&& source) {
+    parse::Lexer lexer(source);
+    while (!lexer.CurrentToken().Is<parse::token_type::Eof>()) {
+        lexer.NextToken();
+    }
+}
+
+void BenchLexStream() {
+    istringstream input(GeneratedScript());
+    LexAll(input);
+}
+
+void BenchLexBuffer() {
+    LexAll(string_view{GeneratedScript()});
+}
+
+void BenchParse() {
+    parse::Lexer lexer(string_view{GeneratedScript()});
+    ParseProgram(lexer);
+}
+
+void BenchLexLarge() {
+    LexAll(string_view{LargeScript()});
+}
+
+void BenchParseLarge() {
+    parse::Lexer lexer(string_view{LargeScript()});
+    ParseProgram(lexer);
+}
+
+// Загрузка той же программы из записи кэша
+void BenchLoadCached() {
+    static const string entry = [] {
+        parse::Lexer lexer(string_view{GeneratedScript()});
+        return cache::Serialize(*ParseProgram(lexer), GeneratedScript());
+    }();
+    [[maybe_unused]] auto program = cache::Deserialize(entry, GeneratedScript());
+}
+
+void BenchDeepRecursion() {
+    DeepRecursion().Run();
+}
+
+void BenchDeepRecursionVm() {
+    DeepRecursion().RunVm();
+}
+
+void BenchFibonacci() {
+    Fibonacci().Run();
+}
+
+void BenchFibonacciVm() {
+    Fibonacci().RunVm();
+}
+
+void BenchGcd() {
+    Gcd().Run();
+}
+
+void BenchGcdVm() {
+    Gcd().RunVm();
+}
+
+void BenchObjectComparison() {
+    ObjectComparison().Run();
+}
+
+void BenchObjectComparisonVm() {
+    ObjectComparison().RunVm();
+}
+
+void BenchDeepInheritance() {
+    DeepInheritance().Run();
+}
+
+void BenchDeepInheritanceVm() {
+    DeepInheritance().RunVm();
+}
+
+void BenchStringConcat() {
+    StringConcat().Run();
+}
+
+void BenchStringConcatVm() {
+    StringConcat().RunVm();
+}
+
+void BenchObjectStorm() {
+    ObjectStorm().Run();
+}
+
+void BenchObjectStormVm() {
+    ObjectStorm().RunVm();
+}
+
+void BenchCall1() {
+    Calls(1).Run();
+}
+
+void BenchCall4() {
+    Calls(4).Run();
+}
+
+void BenchCall6() {
+    Calls(6).Run();
+}
+
+void BenchCall4Vm() {
+    Calls(4).RunVm();
+}
+
+void BenchPrintThreshold() {
+    PrintLoop().RunBuffered(runtime::FlushPolicy::Threshold);
+}
+
+void BenchPrintLine() {
+    PrintLoop().RunBuffered(runtime::FlushPolicy::Line);
+}
+
+const string_view JSON_OPTION = "--json="sv;
+const string_view FILTER_OPTION = "--filter="sv;
+
+}  // namespace
+
+// Запуск: MythonBench [--json=<файл результатов>] [--filter=<часть имени бенчмарка>]
+int main(int argc, const char** argv) {
+    string json_path;
+    string filter;
+    for (int i = 1; i < argc; ++i) {
+        string_view arg = argv[i];
+        if (arg.substr(0, JSON_OPTION.size()) == JSON_OPTION) {
+            json_path = arg.substr(JSON_OPTION.size());
+        } else if (arg.substr(0, FILTER_OPTION.size()) == FILTER_OPTION) {
+            filter = arg.substr(FILTER_OPTION.size());
+        } else {
+            cerr << "Usage: MythonBench [--json=<file>] [--filter=<name part>]"sv << endl;
+            return 1;
+        }
+    }
+
+    BenchRunner br(json_path, filter);
+    RUN_BENCH(br, BenchLexStream, 20);
+    RUN_BENCH(br, BenchLexBuffer, 20);
+    RUN_BENCH(br, BenchParse, 20);
+    RUN_BENCH(br, BenchLexLarge, 5);
+    RUN_BENCH(br, BenchParseLarge, 5);
+    RUN_BENCH(br, BenchLoadCached, 20);
+    RUN_BENCH(br, BenchDeepRecursion, 100);
+    RUN_BENCH(br, BenchDeepRecursionVm, 100);
+    RUN_BENCH(br, BenchFibonacci, 20);
+    RUN_BENCH(br, BenchFibonacciVm, 20);
+    RUN_BENCH(br, BenchGcd, 200);
+    RUN_BENCH(br, BenchGcdVm, 200);
+    RUN_BENCH(br, BenchObjectComparison, 100);
+    RUN_BENCH(br, BenchObjectComparisonVm, 100);
+    RUN_BENCH(br, BenchDeepInheritance, 100);
+    RUN_BENCH(br, BenchDeepInheritanceVm, 100);
+    RUN_BENCH(br, BenchStringConcat, 50);
+    RUN_BENCH(br, BenchStringConcatVm, 50);
+    RUN_BENCH(br, BenchObjectStorm, 3);
+    RUN_BENCH(br, BenchObjectStormVm, 3);
+    RUN_BENCH(br, BenchCall1, 50);
+    RUN_BENCH(br, BenchCall4, 50);
+    RUN_BENCH(br, BenchCall6, 50);
+    RUN_BENCH(br, BenchCall4Vm, 50);
+    RUN_BENCH(br, BenchPrintThreshold, 100);
+    RUN_BENCH(br, BenchPrintLine, 100);
+    return 0;
+}
@@ -0,0 +1,250 @@
+#include "optimizer.h"
+
+#include "statement.h"
+
+using namespace std;
+
+namespace opt {
+
+namespace {
+using ComparatorFn = bool (*)(const runtime::ObjectHolder&, const runtime::ObjectHolder&,
+                              runtime::Context&);
+
+// Стандартные сравнения: для констант они не вызывают методов пользовательских классов
+const ComparatorFn PURE_COMPARATORS[] = {
+    runtime::Equal,       runtime::NotEqual,    runtime::Less,
+    runtime::Greater,     runtime::LessOrEqual, runtime::GreaterOrEqual,
+};
+}  // namespace
+
+size_t Optimizer::Run(unique_ptr<ast::Statement>& program, Level level) {
+    if (level == Level::O0) {
+        return 0;
+    }
+    Optimizer optimizer;
+    optimizer.Optimize(program);
+    return optimizer.simplified_;
+}
+
+void Optimizer::Optimize(unique_ptr<ast::Statement>& node) {  // NOLINT
+    if (node) {
+        if (auto replacement = node->Optimize(*this)) {
+            node = std::move(replacement);
+        }
+    }
+}
+
+void Optimizer::Optimize(vector<unique_ptr<ast::Statement>>& nodes) {
+    for (auto& node : nodes) {
+        Optimize(node);
+    }
+}
+
+void Optimizer::OptimizeClass(runtime::Class& cls) {
+    for (auto& method : cls.GetOwnMethods()) {
+        if (auto* body = dynamic_cast<ast::Statement*>(method.body.get())) {
+            if (auto replacement = body->Optimize(*this)) {
+                method.body = std::move(replacement);
+            }
+        }
+    }
+}
+
+optional<runtime::ObjectHolder> Optimizer::ConstantValue(const ast::Statement& node) {
+    if (const auto* number = dynamic_cast<const ast::NumericConst*>(&node)) {
+        return runtime::ObjectHolder::Own(runtime::Number(number->GetValue()));
+    }
+    if (const auto* str = dynamic_cast<const ast::StringConst*>(&node)) {
+        return runtime::ObjectHolder::Own(runtime::String(str->GetValue()));
+    }
+    if (const auto* boolean = dynamic_cast<const ast::BoolConst*>(&node)) {
+        return runtime::ObjectHolder::Own(runtime::Bool(boolean->GetValue()));
+    }
+    if (dynamic_cast<const ast::None*>(&node) != nullptr) {
+        return runtime::ObjectHolder::None();
+    }
+    return nullopt;
+}
+
+bool Optimizer::IsPure(const Comparator& cmp) {
+    if (const auto* fn = cmp.target<ComparatorFn>()) {
+        for (auto pure : PURE_COMPARATORS) {
+            if (*fn == pure) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+unique_ptr<ast::Statement> Optimizer::Evaluate(ast::Statement& node) {
+    runtime::ObjectHolder value;
+    try {
+        value = node.Execute(closure_, context_);
+    } catch (const std::runtime_error&) {
+        // ошибка должна возникнуть при выполнении программы
+        return nullptr;
+    }
+    return Fold(value);
+}
+
+unique_ptr<ast::Statement> Optimizer::Fold(const runtime::ObjectHolder& value) {
+    unique_ptr<ast::Statement> result;
+    if (const auto* number = value.TryAs<runtime::Number>()) {
+        result = make_unique<ast::NumericConst>(*number);
+    } else if (const auto* str = value.TryAs<runtime::String>()) {
+        result = make_unique<ast::StringConst>(*str);
+    } else if (const auto* boolean = value.TryAs<runtime::Bool>()) {
+        result = make_unique<ast::BoolConst>(*boolean);
+    } else if (!value) {
+        result = make_unique<ast::None>();
+    } else {
+        return nullptr;
+    }
+    ++simplified_;
+    return result;
+}
+
+unique_ptr<ast::Statement> Optimizer::Prune(unique_ptr<ast::Statement> branch) {
+    ++simplified_;
+    if (!branch) {
+        return make_unique<ast::None>();
+    }
+    return branch;
+}
+
+size_t Optimize(unique_ptr<ast::Statement>& program, Level level) {
+    return Optimizer::Run(program, level);
+}
+
+}  // namespace opt
+
+namespace ast {
+
+using opt::Optimizer;
+
+unique_ptr<Statement> Statement::Optimize(Optimizer& /*optimizer*/) {
+    return nullptr;
+}
+
+unique_ptr<Statement> Assignment::Optimize(Optimizer& optimizer) {
+    optimizer.Optimize(rv_);
+    return nullptr;
+}
+
+unique_ptr<Statement> FieldAssignment::Optimize(Optimizer& optimizer) {
+    optimizer.Optimize(rv_);
+    return nullptr;
+}
+
+unique_ptr<Statement> Print::Optimize(Optimizer& optimizer) {
+    optimizer.Optimize(args_);
+    return nullptr;
+}
+
+unique_ptr<Statement> MethodCall::Optimize(Optimizer& optimizer) {
+    optimizer.Optimize(object_);
+    optimizer.Optimize(args_);
+    return nullptr;
+}
+
+unique_ptr<Statement> NewInstance::Optimize(Optimizer& optimizer) {
+    optimizer.Optimize(args_);
+    return nullptr;
+}
+
+unique_ptr<Statement> UnaryOperation::Optimize(Optimizer& optimizer) {
+    optimizer.Optimize(argument_);
+    if (Optimizer::IsConstant(*argument_)) {
+        return optimizer.Evaluate(*this);
+    }
+    return nullptr;
+}
+
+unique_ptr<Statement> BinaryOperation::Optimize(Optimizer& optimizer) {
+    optimizer.Optimize(lhs_);
+    optimizer.Optimize(rhs_);
+    if (Optimizer::IsConstant(*lhs_) && Optimizer::IsConstant(*rhs_)) {
+        return optimizer.Evaluate(*this);
+    }
+    return nullptr;
+}
+
+unique_ptr<Statement> Or::Optimize(Optimizer& optimizer) {
+    optimizer.Optimize(lhs_);
+    optimizer.Optimize(rhs_);
+    if (auto lhs = Optimizer::ConstantValue(*lhs_)) {
+        // rhs не вычисляется, если lhs истинно
+        if (runtime::IsTrue(*lhs)) {
+            return optimizer.Fold(runtime::MakeBool(true));
+        }
+        if (Optimizer::IsConstant(*rhs_)) {
+            return optimizer.Evaluate(*this);
+        }
+    }
+    return nullptr;
+}
+
+unique_ptr<Statement> And::Optimize(Optimizer& optimizer) {
+    optimizer.Optimize(lhs_);
+    optimizer.Optimize(rhs_);
+    if (auto lhs = Optimizer::ConstantValue(*lhs_)) {
+        // rhs не вычисляется, если lhs ложно
+        if (!runtime::IsTrue(*lhs)) {
+            return optimizer.Fold(runtime::MakeBool(false));
+        }
+        if (Optimizer::IsConstant(*rhs_)) {
+            return optimizer.Evaluate(*this);
+        }
+    }
+    return nullptr;
+}
+
+unique_ptr<Statement> Comparison::Optimize(Optimizer& optimizer) {
+    optimizer.Optimize(lhs_);
+    optimizer.Optimize(rhs_);
+    if (Optimizer::IsPure(cmp_) && Optimizer::IsConstant(*lhs_)
+        && Optimizer::IsConstant(*rhs_)) {
+        return optimizer.Evaluate(*this);
+    }
+    return nullptr;
+}
+
+unique_ptr<Statement> Compound::Optimize(Optimizer& optimizer) {
+    optimizer.Optimize(args_);
+    return nullptr;
+}
+
+unique_ptr<Statement> MethodBody::Optimize(Optimizer& optimizer) {
+    optimizer.Optimize(body_);
+    return nullptr;
+}
+
+unique_ptr<Statement> Return::Optimize(Optimizer& optimizer) {
+    optimizer.Optimize(statement_);
+    FindTailCall();
+    return nullptr;
+}
+
+unique_ptr<Statement> ClassDefinition::Optimize(Optimizer& optimizer) {
+    optimizer.OptimizeClass(*cls_.TryAs<runtime::Class>());
+    return nullptr;
+}
+
+unique_ptr<Statement> IfElse::Optimize(Optimizer& optimizer) {
+    optimizer.Optimize(condition_);
+    optimizer.Optimize(if_body_);
+    optimizer.Optimize(else_body_);
+    if (auto condition = Optimizer::ConstantValue(*condition_)) {
+        return optimizer.Prune(runtime::IsTrue(*condition) ? std::move(if_body_)
+                                                           : std::move(else_body_));
+    }
+    return nullptr;
+}
+
+unique_ptr<Statement> Program::Optimize(Optimizer& optimizer) {
+    optimizer.Optimize(root_);
+    return nullptr;
+}
+
+}  // namespace ast
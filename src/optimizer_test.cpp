@@ -0,0 +1,144 @@
+#include "optimizer.h"
+
+#include "lexer.h"
+#include "parse.h"
+#include "statement.h"
+#include "vm.h"
+
+#include <test_runner_p.h>
+
+using namespace std;
+
+namespace opt {
+
+namespace {
+
+unique_ptr<ast::Statement> Parse(string_view source) {
+    parse::Lexer lexer(source);
+    return ParseProgram(lexer);
+}
+
+string RunAst(ast::Statement& program) {
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    program.Execute(closure, context);
+    return context.output.str();
+}
+
+string RunVm(const ast::Statement& program) {
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    vm::Run(vm::Compile(program), closure, context);
+    return context.output.str();
+}
+
+// Проверяет, что оптимизация выполнила simplified упрощений и не изменила вывод программы
+void AssertOptimized(string_view source, size_t simplified, const string& expected) {
+    auto program = Parse(source);
+    ASSERT_EQUAL(Optimize(program, Level::O0), 0U);
+    ASSERT_EQUAL(RunAst(*program), expected);
+
+    ASSERT_EQUAL(Optimize(program, Level::O1), simplified);
+    ASSERT_EQUAL(RunAst(*program), expected);
+    ASSERT_EQUAL(RunVm(*program), expected);
+    // повторная оптимизация ничего не находит
+    ASSERT_EQUAL(Optimize(program), 0U);
+}
+
+void TestConstantFolding() {
+    AssertOptimized(R"(
+print 1 + 2 * 3, -5, 10 / 3 - 1
+print 'a' + 'b' + str(12 + 3) + str(None)
+print 1 < 2, 'b' >= 'a', None == None, not 1 == 1, True != False
+print (1 > 2 or 2 > 1) and not False
+)",
+                    // свёрнутые операции по строкам; унарный минус - это умножение на -1
+                    5 + 6 + 6 + 5,
+                    "7 -5 2\nab15None\nTrue True True False True\nTrue\n"s);
+}
+
+void TestPartialFolding() {
+    AssertOptimized(R"(
+x = 4
+print x + 2 * 3, 2 * 3 + x
+print True or x, False and x, False or x, True and x
+)",
+                    2 + 2, "10 10\nTrue False True True\n"s);
+}
+
+void TestDeadBranches() {
+    AssertOptimized(R"(
+class Checker:
+  def check(n):
+    if 2 > 1:
+      if n > 0:
+        return 'positive'
+    else:
+      return 'unreachable'
+    if 'debug' == 'release':
+      print 'debug'
+    return 'other'
+
+c = Checker()
+print c.check(1), c.check(0)
+if not True:
+  print 'never'
+else:
+  print 'always'
+)",
+                    // условие и удалённая ветка в каждом из трёх ветвлений
+                    6, "positive other\nalways\n"s);
+}
+
+void TestErrorsAreNotFolded() {
+    const string_view sources[] = {
+        "print 1 / 0\n"sv,
+        "print 1 / (2 - 2)\n"sv,
+        "print 1 + 'a'\n"sv,
+        "print 'a' * 2\n"sv,
+        "print 1 < 'a'\n"sv,
+        "x = 1\nif x:\n  print 1 / 0\n"sv,
+    };
+    for (auto source : sources) {
+        auto program = Parse(source);
+        // ветки ветвления и аргументы print сохраняются, чтобы ошибка возникла при выполнении
+        Optimize(program);
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        ASSERT_THROWS(program->Execute(closure, context), std::runtime_error);
+    }
+
+    auto program = Parse("print 1 / 0\n"sv);
+    Optimize(program);
+    try {
+        RunAst(*program);
+        ASSERT(false);
+    } catch (const std::runtime_error& e) {
+        ASSERT_EQUAL(string(e.what()), "Division by zero"s);
+    }
+}
+
+void TestCustomComparison() {
+    int calls = 0;
+    unique_ptr<ast::Statement> comparison = make_unique<ast::Comparison>(
+        [&calls](const runtime::ObjectHolder&, const runtime::ObjectHolder&, runtime::Context&) {
+            ++calls;
+            return true;
+        },
+        make_unique<ast::NumericConst>(1), make_unique<ast::NumericConst>(2));
+    // произвольная функция сравнения может иметь побочные эффекты и не вычисляется заранее
+    ASSERT_EQUAL(Optimize(comparison), 0U);
+    ASSERT_EQUAL(calls, 0);
+}
+
+}  // namespace
+
+void RunOptimizerTests(TestRunner& tr) {
+    RUN_TEST(tr, opt::TestConstantFolding);
+    RUN_TEST(tr, opt::TestPartialFolding);
+    RUN_TEST(tr, opt::TestDeadBranches);
+    RUN_TEST(tr, opt::TestErrorsAreNotFolded);
+    RUN_TEST(tr, opt::TestCustomComparison);
+}
+
+}  // namespace opt
@@ -0,0 +1,21 @@
+#include "optimizer.h"
+#include "test_runner_p.h"
+
+#include <iostream>
+
+using namespace std;
+
+namespace opt {
+void RunOptimizerTests(TestRunner& tr);
+}
+
+int main() {
+    try {
+        TestRunner tr;
+        opt::RunOptimizerTests(tr);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
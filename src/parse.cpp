@@ -2,12 +2,24 @@
 
 #include "lexer.h"
 #include "statement.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 
 using namespace std;
 
 namespace TokenType = parse::token_type;
 
 namespace {
+const runtime::Symbol SELF{"self"sv};
+const runtime::Symbol STR_FUNCTION{"str"sv};
+const runtime::Symbol MEMOIZE_DECORATOR{"memoize"sv};
+
 bool operator==(const parse::Token& token, char c) {
     const auto* p = token.TryAs<TokenType::Char>();
     return p != nullptr && p->value == c;
@@ -17,21 +29,86 @@ bool operator!=(const parse::Token& token, char c) {
     return !(token == c);
 }
 
+/*
+ * Ссылки на классы, найденные при разборе части программы. При параллельном разборе
+ * классы, объявленные в других частях, ещё не созданы, поэтому классы частей создаются,
+ * а обращения к ним разрешаются при последовательном связывании частей (см. Linker)
+ */
+struct ChunkLinks {
+    struct PendingClass {
+        runtime::Symbol name;
+        vector<runtime::Method> methods;
+        const runtime::Class* base = nullptr;
+        ast::ClassDefinition* node = nullptr;
+    };
+
+    enum class Kind {
+        Base,      // обращение к базовому классу класса cls
+        Declare,   // объявление класса cls
+        Instance,  // создание экземпляра класса name узлом instance
+    };
+
+    // Ссылки хранятся в том порядке, в котором последовательный разбор обращался бы
+    // к объявленным классам
+    struct Link {
+        Kind kind;
+        runtime::Symbol name;
+        PendingClass* cls = nullptr;
+        ast::NewInstance* instance = nullptr;
+    };
+
+    // имена всех классов, объявленных в программе; остальные вызовы без объекта
+    // не могут создавать экземпляры
+    const unordered_set<runtime::Symbol>* class_names = nullptr;
+    deque<PendingClass> classes;
+    vector<Link> links;
+};
+
 class Parser {
 public:
-    explicit Parser(parse::Lexer& lexer)
-        : lexer_(lexer) {
+    // Если links не равен nullptr, разбирается часть программы: классы не создаются,
+    // а ссылки на них сохраняются в links
+    explicit Parser(parse::Lexer& lexer, ChunkLinks* links = nullptr)
+        : lexer_(lexer), links_(links) {
     }
 
     // Program -> eps
     //          | Statement \n Program
     unique_ptr<ast::Statement> ParseProgram() {
-        auto result = make_unique<ast::Compound>();
+        auto result = MakeNode<ast::Compound>();
         while (!lexer_.CurrentToken().Is<TokenType::Eof>()) {
             result->AddStatement(ParseStatement());
         }
 
-        return result;
+        return make_unique<ast::Program>(arena_, std::move(result));
+    }
+
+    // Разбирает инструкции части программы до её конца и добавляет их в statements.
+    // Узлы размещаются в арене, которую возвращает GetArena
+    void ParseChunk(vector<unique_ptr<ast::Statement>>& statements) {
+        while (!lexer_.CurrentToken().Is<TokenType::Eof>()) {
+            statements.push_back(ParseStatement());
+        }
+    }
+
+    [[nodiscard]] ast::Arena& GetArena() const {
+        return *arena_;
+    }
+
+    // Разбирает очередную инструкцию верхнего уровня в собственной арене.
+    // Лексема, следующая за концом строки простой инструкции, запрашивается только при
+    // следующем вызове, чтобы не читать следующую строку до выполнения инструкции
+    unique_ptr<ast::Statement> ParseNextStatement() {
+        if (std::exchange(pending_newline_, false)) {
+            lexer_.NextToken();
+        }
+        if (lexer_.CurrentToken().Is<TokenType::Eof>()) {
+            return nullptr;
+        }
+        arena_ = make_shared<ast::Arena>();
+        auto statement = ParseStatementUntilNewline();
+        pending_newline_ = lexer_.CurrentToken().Is<TokenType::Newline>();
+        return make_unique<ast::Program>(arena_, std::move(statement));
     }
 
 private:
@@ -43,7 +120,7 @@ private:
 
         lexer_.NextToken();
 
-        auto result = make_unique<ast::Compound>();
+        auto result = MakeNode<ast::Compound>();
         while (!lexer_.CurrentToken().Is<TokenType::Dedent>()) {
             result->AddStatement(ParseStatement());  // NOLINT
         }
@@ -54,21 +131,48 @@ private:
         return result;
     }
 
-    // Methods -> [def id(Params) : Suite]*
+    // Decorator -> eps
+    //            | '@' memoize ['(' Number ')'] NEWLINE
+    // Число задаёт наибольшее количество запоминаемых результатов метода
+    void ParseDecorator(runtime::Method& method) {
+        if (lexer_.CurrentToken() != '@') {
+            return;
+        }
+        runtime::Symbol name = lexer_.ExpectNext<TokenType::Id>().value;
+        if (name != MEMOIZE_DECORATOR) {
+            throw ParseError("Unknown decorator "s + name.Name());
+        }
+        size_t capacity = runtime::MemoCache::DEFAULT_CAPACITY;
+        if (lexer_.NextToken() == '(') {
+            int value = lexer_.ExpectNext<TokenType::Number>().value;
+            if (value <= 0) {
+                throw ParseError("Memoize capacity must be positive"s);
+            }
+            capacity = static_cast<size_t>(value);
+            lexer_.ExpectNext<TokenType::Char>(')');
+            lexer_.NextToken();
+        }
+        lexer_.Expect<TokenType::Newline>();
+        lexer_.ExpectNext<TokenType::Def>();
+        method.memo = std::make_unique<runtime::MemoCache>(capacity);
+    }
+
+    // Methods -> [Decorator def id(Params) : Suite]*
     vector<runtime::Method> ParseMethods()  // NOLINT
     {
         vector<runtime::Method> result;
 
-        while (lexer_.CurrentToken().Is<TokenType::Def>()) {
+        while (lexer_.CurrentToken().Is<TokenType::Def>() || lexer_.CurrentToken() == '@') {
             runtime::Method m;
+            ParseDecorator(m);
 
             m.name = lexer_.ExpectNext<TokenType::Id>().value;
             lexer_.ExpectNext<TokenType::Char>('(');
 
             if (lexer_.NextToken().Is<TokenType::Id>()) {
-                m.formal_params.push_back(lexer_.Expect<TokenType::Id>().value);
+                m.formal_params.emplace_back(lexer_.Expect<TokenType::Id>().value);
                 while (lexer_.NextToken() == ',') {
-                    m.formal_params.push_back(lexer_.ExpectNext<TokenType::Id>().value);
+                    m.formal_params.emplace_back(lexer_.ExpectNext<TokenType::Id>().value);
                 }
             }
 
@@ -76,7 +180,21 @@ private:
             lexer_.ExpectNext<TokenType::Char>(':');
             lexer_.NextToken();
 
-            m.body = std::make_unique<ast::MethodBody>(ParseSuite());  // NOLINT
+            // self занимает нулевой слот кадра, следом идут параметры метода
+            MethodScope scope;
+            scope.Resolve(SELF);
+            for (const auto& param : m.formal_params) {
+                scope.Resolve(param);
+            }
+            MethodScope* enclosing = std::exchange(scope_, &scope);
+            try {
+                m.body = MakeNode<ast::MethodBody>(ParseSuite());  // NOLINT
+            } catch (...) {
+                scope_ = enclosing;
+                throw;
+            }
+            scope_ = enclosing;
+            m.locals_count = scope.Size();
 
             result.push_back(std::move(m));
         }
@@ -86,49 +204,70 @@ private:
     // ClassDefinition -> Id ['(' Id ')'] : new_line indent MethodList dedent
     unique_ptr<ast::Statement> ParseClassDefinition()  // NOLINT
     {
-        string class_name = lexer_.Expect<TokenType::Id>().value;
+        runtime::Symbol class_name = lexer_.Expect<TokenType::Id>().value;
 
         lexer_.NextToken();
 
+        ChunkLinks::PendingClass* pending = nullptr;
+        if (links_ != nullptr) {
+            pending = &links_->classes.emplace_back();
+            pending->name = class_name;
+        }
+
         const runtime::Class* base_class = nullptr;
         if (lexer_.CurrentToken() == '(') {
-            auto name = lexer_.ExpectNext<TokenType::Id>().value;
+            runtime::Symbol name = lexer_.ExpectNext<TokenType::Id>().value;
             lexer_.ExpectNext<TokenType::Char>(')');
             lexer_.NextToken();
 
-            auto it = declared_classes_.find(name);
-            if (it == declared_classes_.end()) {
-                throw ParseError("Base class "s + name + " not found for class "s + class_name);
+            if (pending != nullptr) {
+                links_->links.push_back({ChunkLinks::Kind::Base, name, pending});
+            } else if (auto it = declared_classes_.find(name); it == declared_classes_.end()) {
+                throw ParseError("Base class "s + name.Name() + " not found for class "s
+                                 + class_name.Name());
+            } else {
+                base_class = static_cast<const runtime::Class*>(it->second.Get());  // NOLINT
             }
-            base_class = static_cast<const runtime::Class*>(it->second.Get());  // NOLINT
         }
 
         lexer_.Expect<TokenType::Char>(':');
         lexer_.ExpectNext<TokenType::Newline>();
         lexer_.ExpectNext<TokenType::Indent>();
-        lexer_.ExpectNext<TokenType::Def>();
+        if (lexer_.NextToken() != '@') {
+            lexer_.Expect<TokenType::Def>();
+        }
         vector<runtime::Method> methods = ParseMethods();  // NOLINT
 
         lexer_.Expect<TokenType::Dedent>();
         lexer_.NextToken();
 
+        if (pending != nullptr) {
+            pending->methods = std::move(methods);
+            auto node = MakeNode<ast::ClassDefinition>(runtime::ObjectHolder::None(),
+                                                       ResolveSlot(class_name));
+            pending->node = node.get();
+            links_->links.push_back({ChunkLinks::Kind::Declare, class_name, pending});
+            return node;
+        }
+
         auto [it, inserted] = declared_classes_.insert({
             class_name,
-            runtime::ObjectHolder::Own(runtime::Class(class_name, std::move(methods), base_class)),
+            runtime::ObjectHolder::Own(
+                runtime::Class(class_name, std::move(methods), base_class, arena_)),
         });
 
         if (!inserted) {
-            throw ParseError("Class "s + class_name + " already exists"s);
+            throw ParseError("Class "s + class_name.Name() + " already exists"s);
         }
 
-        return make_unique<ast::ClassDefinition>(it->second);
+        return MakeNode<ast::ClassDefinition>(it->second, ResolveSlot(class_name));
     }
 
-    vector<string> ParseDottedIds() {
-        vector<string> result(1, lexer_.Expect<TokenType::Id>().value);
+    vector<runtime::Symbol> ParseDottedIds() {
+        vector<runtime::Symbol> result(1, lexer_.Expect<TokenType::Id>().value);
 
         while (lexer_.NextToken() == '.') {
-            result.push_back(lexer_.ExpectNext<TokenType::Id>().value);
+            result.emplace_back(lexer_.ExpectNext<TokenType::Id>().value);
         }
 
         return result;
@@ -139,24 +278,25 @@ private:
     unique_ptr<ast::Statement> ParseAssignmentOrCall() {
         lexer_.Expect<TokenType::Id>();
 
-        vector<string> id_list = ParseDottedIds();
-        string last_name = id_list.back();
+        vector<runtime::Symbol> id_list = ParseDottedIds();
+        runtime::Symbol last_name = id_list.back();
         id_list.pop_back();
 
         if (lexer_.CurrentToken() == '=') {
             lexer_.NextToken();
 
             if (id_list.empty()) {
-                return make_unique<ast::Assignment>(std::move(last_name), ParseTest());
+                auto slot = ResolveSlot(last_name);
+                return MakeNode<ast::Assignment>(last_name, ParseTest(), slot);
             }
-            return make_unique<ast::FieldAssignment>(ast::VariableValue{std::move(id_list)},
-                                                     std::move(last_name), ParseTest());
+            return MakeNode<ast::FieldAssignment>(MakeVariableValue(std::move(id_list)),
+                                                     last_name, ParseTest());
         }
         lexer_.Expect<TokenType::Char>('(');
         lexer_.NextToken();
 
         if (id_list.empty()) {
-            throw ParseError("Mython doesn't support functions, only methods: "s + last_name);
+            throw ParseError("Mython doesn't support functions, only methods: "s + last_name.Name());
         }
 
         vector<unique_ptr<ast::Statement>> args;
@@ -166,8 +306,9 @@ private:
         lexer_.Expect<TokenType::Char>(')');
         lexer_.NextToken();
 
-        return make_unique<ast::MethodCall>(make_unique<ast::VariableValue>(std::move(id_list)),
-                                            std::move(last_name), std::move(args));
+        return MakeNode<ast::MethodCall>(
+            MakeNode<ast::VariableValue>(MakeVariableValue(std::move(id_list))),
+            std::move(last_name), std::move(args));
     }
 
     // Expr -> Adder ['+'/'-' Adder]*
@@ -179,9 +320,9 @@ private:
             lexer_.NextToken();
 
             if (op == '+') {
-                result = make_unique<ast::Add>(std::move(result), ParseAdder());
+                result = MakeNode<ast::Add>(std::move(result), ParseAdder());
             } else {
-                result = make_unique<ast::Sub>(std::move(result), ParseAdder());
+                result = MakeNode<ast::Sub>(std::move(result), ParseAdder());
             }
         }
         return result;
@@ -196,9 +337,9 @@ private:
             lexer_.NextToken();
 
             if (op == '*') {
-                result = make_unique<ast::Mult>(std::move(result), ParseMult());
+                result = MakeNode<ast::Mult>(std::move(result), ParseMult());
             } else {
-                result = make_unique<ast::Div>(std::move(result), ParseMult());
+                result = MakeNode<ast::Div>(std::move(result), ParseMult());
             }
         }
         return result;
@@ -224,36 +365,36 @@ private:
         }
         if (lexer_.CurrentToken() == '-') {
             lexer_.NextToken();
-            return make_unique<ast::Mult>(ParseMult(), make_unique<ast::NumericConst>(-1));
+            return MakeNode<ast::Mult>(ParseMult(), MakeNode<ast::NumericConst>(-1));
         }
         if (const auto* num = lexer_.CurrentToken().TryAs<TokenType::Number>()) {
             int result = num->value;
             lexer_.NextToken();
-            return make_unique<ast::NumericConst>(result);
+            return MakeNode<ast::NumericConst>(result);
         }
         if (const auto* str = lexer_.CurrentToken().TryAs<TokenType::String>()) {
-            string result = str->value;
+            string result{str->value};
             lexer_.NextToken();
-            return make_unique<ast::StringConst>(std::move(result));
+            return MakeNode<ast::StringConst>(std::move(result));
         }
         if (lexer_.CurrentToken().Is<TokenType::True>()) {
             lexer_.NextToken();
-            return make_unique<ast::BoolConst>(runtime::Bool(true));
+            return MakeNode<ast::BoolConst>(runtime::Bool(true));
         }
         if (lexer_.CurrentToken().Is<TokenType::False>()) {
             lexer_.NextToken();
-            return make_unique<ast::BoolConst>(runtime::Bool(false));
+            return MakeNode<ast::BoolConst>(runtime::Bool(false));
         }
         if (lexer_.CurrentToken().Is<TokenType::None>()) {
             lexer_.NextToken();
-            return make_unique<ast::None>();
+            return MakeNode<ast::None>();
         }
 
         return ParseDottedIdsInMultExpr();
     }
 
     std::unique_ptr<ast::Statement> ParseDottedIdsInMultExpr() {
-        vector<string> names = ParseDottedIds();
+        vector<runtime::Symbol> names = ParseDottedIds();
 
         if (lexer_.CurrentToken() == '(') {
             // various calls
@@ -268,23 +409,29 @@ private:
             names.pop_back();
 
             if (!names.empty()) {
-                return make_unique<ast::MethodCall>(
-                    make_unique<ast::VariableValue>(std::move(names)), std::move(method_name),
-                    std::move(args));
+                return MakeNode<ast::MethodCall>(
+                    MakeNode<ast::VariableValue>(MakeVariableValue(std::move(names))),
+                    method_name, std::move(args));
+            }
+            if (links_ != nullptr && links_->class_names->count(method_name) > 0) {
+                auto node = MakeNode<ast::NewInstance>(std::move(args));
+                links_->links.push_back({ChunkLinks::Kind::Instance, method_name, nullptr,
+                                         node.get()});
+                return node;
             }
             if (auto it = declared_classes_.find(method_name); it != declared_classes_.end()) {
-                return make_unique<ast::NewInstance>(
+                return MakeNode<ast::NewInstance>(
                     static_cast<const runtime::Class&>(*it->second), std::move(args));  // NOLINT
             }
-            if (method_name == "str"sv) {
+            if (method_name == STR_FUNCTION) {
                 if (args.size() != 1) {
                     throw ParseError("Function str takes exactly one argument"s);
                 }
-                return make_unique<ast::Stringify>(std::move(args.front()));
+                return MakeNode<ast::Stringify>(std::move(args.front()));
             }
-            throw ParseError("Unknown call to "s + method_name + "()"s);
+            throw ParseError("Unknown call to "s + method_name.Name() + "()"s);
         }
-        return make_unique<ast::VariableValue>(std::move(names));
+        return MakeNode<ast::VariableValue>(MakeVariableValue(std::move(names)));
     }
 
     vector<unique_ptr<ast::Statement>> ParseTestList()  // NOLINT
@@ -319,7 +466,7 @@ private:
             else_body = ParseSuite();
         }
 
-        return make_unique<ast::IfElse>(std::move(condition), std::move(if_body),
+        return MakeNode<ast::IfElse>(std::move(condition), std::move(if_body),
                                         std::move(else_body));
     }
 
@@ -332,7 +479,7 @@ private:
         auto result = ParseAndTest();
         while (lexer_.CurrentToken().Is<TokenType::Or>()) {
             lexer_.NextToken();
-            result = make_unique<ast::Or>(std::move(result), ParseAndTest());
+            result = MakeNode<ast::Or>(std::move(result), ParseAndTest());
         }
         return result;
     }
@@ -342,7 +489,7 @@ private:
         auto result = ParseNotTest();
         while (lexer_.CurrentToken().Is<TokenType::And>()) {
             lexer_.NextToken();
-            result = make_unique<ast::And>(std::move(result), ParseNotTest());
+            result = MakeNode<ast::And>(std::move(result), ParseNotTest());
         }
         return result;
     }
@@ -351,7 +498,7 @@ private:
     {
         if (lexer_.CurrentToken().Is<TokenType::Not>()) {
             lexer_.NextToken();
-            return make_unique<ast::Not>(ParseNotTest());  // NOLINT
+            return MakeNode<ast::Not>(ParseNotTest());  // NOLINT
         }
         return ParseComparison();
     }
@@ -365,32 +512,32 @@ private:
 
         if (tok == '<') {
             lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::Less, std::move(result),
+            return MakeNode<ast::Comparison>(runtime::Less, std::move(result),
                                                 ParseExpression());
         }
         if (tok == '>') {
             lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::Greater, std::move(result),
+            return MakeNode<ast::Comparison>(runtime::Greater, std::move(result),
                                                 ParseExpression());
         }
         if (tok.Is<TokenType::Eq>()) {
             lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::Equal, std::move(result),
+            return MakeNode<ast::Comparison>(runtime::Equal, std::move(result),
                                                 ParseExpression());
         }
         if (tok.Is<TokenType::NotEq>()) {
             lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::NotEqual, std::move(result),
+            return MakeNode<ast::Comparison>(runtime::NotEqual, std::move(result),
                                                 ParseExpression());
         }
         if (tok.Is<TokenType::LessOrEq>()) {
             lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::LessOrEqual, std::move(result),
+            return MakeNode<ast::Comparison>(runtime::LessOrEqual, std::move(result),
                                                 ParseExpression());
         }
         if (tok.Is<TokenType::GreaterOrEq>()) {
             lexer_.NextToken();
-            return make_unique<ast::Comparison>(runtime::GreaterOrEqual, std::move(result),
+            return MakeNode<ast::Comparison>(runtime::GreaterOrEqual, std::move(result),
                                                 ParseExpression());
         }
         return result;
@@ -400,6 +547,17 @@ private:
     //           | class ClassDefinition
     //           | if Condition
     unique_ptr<ast::Statement> ParseStatement()  // NOLINT
+    {
+        auto result = ParseStatementUntilNewline();
+        // составная инструкция заканчивается лексемой Dedent, простая - концом строки
+        if (lexer_.CurrentToken().Is<TokenType::Newline>()) {
+            lexer_.NextToken();
+        }
+        return result;
+    }
+
+    // Разбирает инструкцию. Для простой инструкции текущей остаётся лексема конца строки
+    unique_ptr<ast::Statement> ParseStatementUntilNewline()  // NOLINT
     {
         const auto& tok = lexer_.CurrentToken();
 
@@ -412,7 +570,6 @@ private:
         }
         auto result = ParseSimpleStatement();
         lexer_.Expect<TokenType::Newline>();
-        lexer_.NextToken();
         return result;
     }
 
@@ -424,7 +581,7 @@ private:
 
         if (tok.Is<TokenType::Return>()) {
             lexer_.NextToken();
-            return make_unique<ast::Return>(ParseTest());
+            return MakeNode<ast::Return>(ParseTest());
         }
         if (tok.Is<TokenType::Print>()) {
             lexer_.NextToken();
@@ -432,17 +589,242 @@ private:
             if (!lexer_.CurrentToken().Is<TokenType::Newline>()) {
                 args = ParseTestList();
             }
-            return make_unique<ast::Print>(std::move(args));
+            return MakeNode<ast::Print>(std::move(args));
         }
         return ParseAssignmentOrCall();
     }
 
+    // Возвращает слот локальной переменной name текущего метода или NO_SLOT,
+    // если разбирается код верхнего уровня
+    runtime::Slot ResolveSlot(runtime::Symbol name) {
+        return scope_ != nullptr ? scope_->Resolve(name) : runtime::NO_SLOT;
+    }
+
+    ast::VariableValue MakeVariableValue(vector<runtime::Symbol> dotted_ids) {
+        auto slot = ResolveSlot(dotted_ids.front());
+        return ast::VariableValue{std::move(dotted_ids), slot};
+    }
+
+    // Локальные переменные разбираемого метода. Каждому имени, встреченному в теле метода,
+    // назначается слот в кадре вызова: переменные верхнего уровня из метода не видны,
+    // поэтому все такие имена являются локальными
+    class MethodScope {
+    public:
+        runtime::Slot Resolve(runtime::Symbol name) {
+            return slots_.emplace(name, static_cast<runtime::Slot>(slots_.size())).first->second;
+        }
+
+        runtime::Slot Size() const {
+            return static_cast<runtime::Slot>(slots_.size());
+        }
+
+    private:
+        unordered_map<runtime::Symbol, runtime::Slot> slots_;
+    };
+
+    // Создаёт узел дерева в арене программы
+    template <typename Node, typename... Args>
+    unique_ptr<Node> MakeNode(Args&&... args) {
+        return unique_ptr<Node>(new (*arena_) Node(std::forward<Args>(args)...));
+    }
+
     parse::Lexer& lexer_;
+    shared_ptr<ast::Arena> arena_ = make_shared<ast::Arena>();
     runtime::Closure declared_classes_;
+    ChunkLinks* links_ = nullptr;
+    MethodScope* scope_ = nullptr;
+    // конец строки последней разобранной инструкции ещё не пропущен
+    bool pending_newline_ = false;
+};
+
+// Последовательно связывает разобранные части программы: создаёт объявленные в них классы
+// и разрешает обращения к классам в порядке следования частей, проверяя то же, что
+// проверил бы последовательный разбор
+class Linker {
+public:
+    explicit Linker(shared_ptr<ast::Arena> arena)
+        : arena_(std::move(arena)) {
+    }
+
+    // Связывает часть программы. Если при разборе части возникла ошибка, узлы части
+    // уже уничтожены, поэтому ссылки только проверяются, чтобы ошибка связывания,
+    // предшествующая ошибке разбора, была сообщена первой
+    void Link(ChunkLinks& links, bool check_only) {
+        for (auto& link : links.links) {
+            switch (link.kind) {
+                case ChunkLinks::Kind::Base: {
+                    auto it = declared_classes_.find(link.name);
+                    if (it == declared_classes_.end()) {
+                        throw ParseError("Base class "s + link.name.Name()
+                                         + " not found for class "s + link.cls->name.Name());
+                    }
+                    link.cls->base = it->second;
+                    break;
+                }
+                case ChunkLinks::Kind::Declare: {
+                    const runtime::Class* cls = nullptr;
+                    runtime::ObjectHolder holder;
+                    if (!check_only) {
+                        holder = runtime::ObjectHolder::Own(runtime::Class(
+                            link.name, std::move(link.cls->methods), link.cls->base, arena_));
+                        cls = holder.TryAs<runtime::Class>();
+                    }
+                    if (!declared_classes_.emplace(link.name, cls).second) {
+                        throw ParseError("Class "s + link.name.Name() + " already exists"s);
+                    }
+                    if (!check_only) {
+                        link.cls->node->SetClass(std::move(holder));
+                    }
+                    break;
+                }
+                case ChunkLinks::Kind::Instance: {
+                    auto it = declared_classes_.find(link.name);
+                    if (it == declared_classes_.end()) {
+                        throw ParseError("Unknown call to "s + link.name.Name() + "()"s);
+                    }
+                    if (!check_only) {
+                        link.instance->SetClass(*it->second);
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+private:
+    shared_ptr<ast::Arena> arena_;
+    // классы, которыми владеют узлы ClassDefinition дерева
+    unordered_map<runtime::Symbol, const runtime::Class*> declared_classes_;
 };
 
+bool IsIdChar(char c) {
+    return isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+// Возвращает true, если со строки, начинающейся в позиции line, может начинаться
+// инструкция верхнего уровня: строка не имеет отступа и не продолжает инструкцию if
+bool IsTopLevelLine(string_view source, size_t line) {
+    char c = source[line];
+    if (!isalpha(static_cast<unsigned char>(c)) && c != '_') {
+        return false;
+    }
+    constexpr string_view ELSE = "else"sv;
+    bool is_else = source.compare(line, ELSE.size(), ELSE) == 0
+                   && (source.size() == line + ELSE.size() || !IsIdChar(source[line + ELSE.size()]));
+    return !is_else;
+}
+
+// Делит текст на части не короче chunk_size (кроме последней), начинающиеся со строк
+// без отступа, так что части состоят из целых инструкций верхнего уровня
+vector<string_view> SplitTopLevel(string_view source, size_t chunk_size) {
+    vector<string_view> result;
+    size_t begin = 0;
+    while (begin < source.size()) {
+        size_t end = begin + max<size_t>(chunk_size, 1);
+        // переходим к началу строки, на которой могла бы начаться инструкция верхнего уровня
+        while (end < source.size() && (source[end - 1] != '\n' || !IsTopLevelLine(source, end))) {
+            size_t newline = source.find('\n', end);
+            end = newline == string_view::npos ? source.size() : newline + 1;
+        }
+        end = min(end, source.size());
+        result.push_back(source.substr(begin, end - begin));
+        begin = end;
+    }
+    return result;
+}
+
+// Возвращает имена всех классов, объявленных в тексте, включая вложенные в другие инструкции
+unordered_set<runtime::Symbol> FindClassNames(string_view source) {
+    constexpr string_view CLASS = "class"sv;
+    unordered_set<runtime::Symbol> result;
+    for (size_t line = 0; line < source.size();) {
+        size_t pos = source.find_first_not_of(' ', line);
+        if (pos != string_view::npos && source.compare(pos, CLASS.size(), CLASS) == 0
+            && pos + CLASS.size() < source.size() && source[pos + CLASS.size()] == ' ') {
+            size_t name_begin = source.find_first_not_of(' ', pos + CLASS.size());
+            size_t name_end = name_begin;
+            while (name_end < source.size() && IsIdChar(source[name_end])) {
+                ++name_end;
+            }
+            if (name_end > name_begin) {
+                result.emplace(source.substr(name_begin, name_end - name_begin));
+            }
+        }
+        size_t newline = source.find('\n', line);
+        line = newline == string_view::npos ? source.size() : newline + 1;
+    }
+    return result;
+}
+
 }  // namespace
 
-unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer) {
+class StatementParser::Impl : public Parser {
+public:
+    using Parser::Parser;
+};
+
+StatementParser::StatementParser(parse::Lexer& lexer) : impl_(make_unique<Impl>(lexer)) {
+}
+
+StatementParser::~StatementParser() = default;
+
+unique_ptr<ast::Statement> StatementParser::ParseNext() {
+    return impl_->ParseNextStatement();
+}
+
+unique_ptr<ast::Statement> ParseProgram(parse::Lexer& lexer) {
     return Parser{lexer}.ParseProgram();
-}
\ No newline at end of file
+}
+
+unique_ptr<ast::Statement> ParseProgramParallel(string_view source, size_t thread_count,
+                                                size_t min_chunk_size) {
+    mython::WorkStealingPool pool(thread_count);
+    // частей в несколько раз больше, чем потоков, чтобы потоки, разобравшие короткие части,
+    // могли забрать работу у остальных
+    auto chunks = SplitTopLevel(source, max(min_chunk_size,
+                                            source.size() / (pool.GetThreadCount() * 4)));
+    auto class_names = FindClassNames(source);
+    // класс str подменяет встроенную функцию только после своего объявления, что нельзя
+    // определить, не разобрав предыдущие части
+    if (chunks.size() < 2 || pool.GetThreadCount() < 2 || class_names.count(STR_FUNCTION) > 0) {
+        parse::Lexer lexer(source);
+        return ParseProgram(lexer);
+    }
+
+    struct Chunk {
+        // разборщик владеет ареной части и должен разрушаться после её узлов
+        unique_ptr<Parser> parser;
+        vector<unique_ptr<ast::Statement>> statements;
+        ChunkLinks links;
+        exception_ptr error;
+    };
+    vector<Chunk> parsed(chunks.size());
+    pool.Run(chunks.size(), [&](size_t index) {
+        auto& chunk = parsed[index];
+        chunk.links.class_names = &class_names;
+        try {
+            parse::Lexer lexer(chunks[index]);
+            chunk.parser = make_unique<Parser>(lexer, &chunk.links);
+            chunk.parser->ParseChunk(chunk.statements);
+        } catch (...) {
+            chunk.error = current_exception();
+        }
+    });
+
+    auto arena = make_shared<ast::Arena>();
+    Linker linker(arena);
+    for (auto& chunk : parsed) {
+        linker.Link(chunk.links, chunk.error != nullptr);
+        if (chunk.error) {
+            rethrow_exception(chunk.error);
+        }
+    }
+    auto root = unique_ptr<ast::Compound>(new (*arena) ast::Compound());
+    for (auto& chunk : parsed) {
+        arena->Merge(chunk.parser->GetArena());
+        for (auto& statement : chunk.statements) {
+            root->AddStatement(std::move(statement));
+        }
+    }
+    return make_unique<ast::Program>(arena, std::move(root));
+}
@@ -243,6 +243,316 @@ print r, c, t1, t2
                  "Rect(10x20) Circle(52) Triangle(3, 4, 5) Wrong triangle\n"s);
 }
 
+void TestMethodLocals() {
+    const string program = R"(
+class Counter:
+  def __init__():
+    self.value = 0
+
+  def add(n):
+    x = n
+    if n > 10:
+      big = n
+      x = big + self.value
+    else:
+      x = x + self.value
+    self.value = x
+    return x
+
+  def broken(flag):
+    if flag:
+      y = 1
+    return y
+
+c = Counter()
+x = 100
+print c.add(5), c.add(20), x
+print c.broken(True)
+c.broken(False)
+)"s;
+
+    runtime::DummyContext context;
+
+    runtime::Closure closure;
+    auto tree = ParseProgramFromString(program);
+    try {
+        tree->Execute(closure, context);
+        ASSERT(false);
+    } catch (const std::runtime_error& e) {
+        ASSERT_EQUAL(e.what(), "Variable y not found"s);
+    }
+    ASSERT_EQUAL(context.output.str(), "5 25 100\n1\n"s);
+    ASSERT_EQUAL(closure.count("n"s), 0U);
+}
+
+void TestNewInstancePerEvaluation() {
+    const string program = R"(
+class Point:
+  def __init__(x):
+    self.x = x
+
+class Factory:
+  def make(x):
+    return Point(x)
+
+f = Factory()
+a = f.make(1)
+b = f.make(2)
+print a.x, b.x
+b.x = 3
+print a.x, b.x
+)"s;
+
+    runtime::DummyContext context;
+
+    runtime::Closure closure;
+    auto tree = ParseProgramFromString(program);
+    tree->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "1 2\n1 3\n"s);
+}
+
+void TestStatementParser() {
+    istringstream input(R"(x = 1
+print x
+class A:
+  def f():
+    return 2
+
+a = A()
+print a.f() + x
+)"s);
+    parse::Lexer lexer(input);
+    StatementParser parser(lexer);
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+
+    // после разбора простой инструкции следующая строка ещё не прочитана
+    auto statement = parser.ParseNext();
+    ASSERT(statement != nullptr);
+    ASSERT_EQUAL(static_cast<int>(input.tellg()), 6);
+    statement->Execute(closure, context);
+    ASSERT_EQUAL(closure.at("x"s).TryAs<runtime::Number>()->GetValue(), 1);
+
+    statement = parser.ParseNext();
+    ASSERT_EQUAL(static_cast<int>(input.tellg()), 14);
+    statement->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "1\n"s);
+
+    // объявление класса заканчивается, когда прочитана следующая инструкция
+    statement = parser.ParseNext();
+    statement->Execute(closure, context);
+    statement.reset();
+
+    while ((statement = parser.ParseNext())) {
+        statement->Execute(closure, context);
+    }
+    ASSERT_EQUAL(context.output.str(), "1\n3\n"s);
+    ASSERT(parser.ParseNext() == nullptr);
+}
+
+// Строковая константа, сохранённая в переменной, переживает выполненную инструкцию
+void TestStatementParserStrings() {
+    istringstream input(R"(x = "hello world string"
+print x
+s = "x"
+s = s + "y"
+print s
+)"s);
+    parse::Lexer lexer(input);
+    StatementParser parser(lexer);
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    while (auto statement = parser.ParseNext()) {
+        statement->Execute(closure, context);
+    }
+    ASSERT_EQUAL(context.output.str(), "hello world string\nxy\n"s);
+    ASSERT_EQUAL(closure.at("x"s).TryAs<runtime::String>()->GetValue(), "hello world string"s);
+}
+
+void TestProgramArena() {
+    const string program = R"(
+class Greeter:
+  def __init__(name):
+    self.name = name
+
+  def greet(greeting):
+    return greeting + ", " + self.name
+
+g = Greeter("world")
+print g.greet("Hello")
+)"s;
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    {
+        auto tree = ParseProgramFromString(program);
+        const auto* root = dynamic_cast<const ast::Program*>(tree.get());
+        ASSERT(root != nullptr);
+        ASSERT(root->GetArena().BytesUsed() > 0U);
+        tree->Execute(closure, context);
+    }
+    ASSERT_EQUAL(context.output.str(), "Hello, world\n"s);
+
+    // класс в closure удерживает арену, в которой размещены тела его методов
+    auto* greeter = closure.at("g"s).TryAs<runtime::ClassInstance>();
+    ASSERT(greeter != nullptr);
+    auto result = greeter->Call("greet"s, {runtime::ObjectHolder::Own(runtime::String("Bye"s))},
+                                context);
+    ASSERT_EQUAL(result.TryAs<runtime::String>()->GetValue(), "Bye, world"s);
+}
+
+void TestMemoizedMethod() {
+    const string program = R"(
+class Math:
+  @memoize
+  def fib(n):
+    if n < 2:
+      return n
+    return self.fib(n - 1) + self.fib(n - 2)
+
+  @memoize(2)
+  def name(x):
+    return 'v' + str(x)
+
+m = Math()
+print m.fib(40)
+print m.name(1), m.name(2), m.name(1), m.name(3), m.name(2)
+)"s;
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    auto tree = ParseProgramFromString(program);
+    tree->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "102334155\nv1 v2 v1 v3 v2\n"s);
+
+    const auto* cls = closure.at("Math"s).TryAs<runtime::Class>();
+    const auto* fib = cls->GetMethod("fib"s)->memo.get();
+    ASSERT(fib != nullptr);
+    // каждое значение n вычисляется один раз, а второй рекурсивный вызов берётся из кэша
+    ASSERT_EQUAL(fib->GetStats().misses, 41U);
+    ASSERT_EQUAL(fib->GetStats().hits, 38U);
+
+    const auto* name = cls->GetMethod("name"s)->memo.get();
+    ASSERT_EQUAL(name->GetCapacity(), 2U);
+    ASSERT_EQUAL(name->GetStats().hits, 1U);
+    ASSERT_EQUAL(name->GetStats().evictions, 2U);
+}
+
+void TestDecoratorErrors() {
+    for (const string& program : {"class A:\n  @cache\n  def f():\n    return 1\n"s,
+                                  "class A:\n  @memoize(0)\n  def f():\n    return 1\n"s,
+                                  "class A:\n  @memoize x\n  def f():\n    return 1\n"s}) {
+        try {
+            ParseProgramFromString(program);
+            ASSERT(false);
+        } catch (const ParseError&) {
+        } catch (const LexerError&) {
+        }
+    }
+}
+
+string ExecuteProgram(const ast::Statement& tree) {
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    const_cast<ast::Statement&>(tree).Execute(closure, context);
+    return context.output.str();
+}
+
+// Возвращает сообщение об ошибке разбора программы или пустую строку
+template <typename Parse>
+string ParseErrorMessage(Parse parse) {
+    try {
+        parse();
+    } catch (const std::exception& e) {
+        return e.what();
+    }
+    return {};
+}
+
+void TestParallelParse() {
+    // классы ссылаются на объявленные в предыдущих частях; комментарий без отступа
+    // внутри метода и else не начинают новую инструкцию верхнего уровня
+    string program = R"(
+class Base:
+  def __init__(value):
+    self.value = value
+
+  def get():
+    return self.value
+)"s;
+    for (int i = 1; i <= 50; ++i) {
+        string name = "C"s + to_string(i);
+        string base = i == 1 ? "Base"s : "C"s + to_string(i - 1);
+        program += "class "s + name + "("s + base + "):\n"s
+                   + "  def get():\n"s
+                   + "# слагаемое класса\n"s
+                   + "    return self.value + "s + to_string(i) + "\n\n"s
+                   + "  def make():\n"s
+                   + "    return "s + base + "(self.value)\n\n"s
+                   + "x = "s + name + "(1)\n"s
+                   + "if x.get() > 100:\n"s
+                   + "  print 'big', str(x.get())\n"s
+                   + "else:\n"s
+                   + "  print 'small', x.get()\n"s
+                   + "y = x.make()\n"s
+                   + "print y.get()\n"s;
+    }
+
+    auto serial = ParseProgramFromString(program);
+    const string expected = ExecuteProgram(*serial);
+    for (size_t chunk_size : {size_t{1}, size_t{200}, PARALLEL_PARSE_CHUNK_SIZE}) {
+        auto parallel = ParseProgramParallel(program, 4, chunk_size);
+        ASSERT_EQUAL(ExecuteProgram(*parallel), expected);
+    }
+}
+
+void TestParallelParseErrors() {
+    const string declarations = "class A:\n  def f():\n    return 1\n\n"s;
+    for (const string& program : {
+             // класс используется до объявления, в том числе в собственном методе
+             "x = A()\n"s + declarations,
+             "class A:\n  def f():\n    return A()\n"s,
+             // базовый класс объявлен позже
+             "class B(A):\n  def g():\n    return 2\n"s + declarations,
+             "class B(Missing):\n  def g():\n    return 2\n"s,
+             // повторное объявление в другой части
+             declarations + "print 1\n"s + declarations,
+             // синтаксическая ошибка после ошибки связывания и перед ней
+             "x = A()\n"s + declarations + "print +\n"s,
+             "print 1 +\n"s + "x = A()\n"s + declarations,
+             // вызов неизвестной функции
+             declarations + "x = f()\n"s,
+         }) {
+        string expected = ParseErrorMessage([&program] {
+            ParseProgramFromString(program);
+        });
+        ASSERT(!expected.empty());
+        string actual = ParseErrorMessage([&program] {
+            ParseProgramParallel(program, 3, 1);
+        });
+        ASSERT_EQUAL(actual, expected);
+    }
+}
+
+void TestParallelParseStrClass() {
+    // объявление класса str меняет смысл вызова str() только после объявления
+    const string program = R"(
+print str(1)
+class str:
+  def __init__(value):
+    self.value = value
+
+  def __str__():
+    return 'str class'
+
+print str(2)
+)"s;
+    auto parallel = ParseProgramParallel(program, 2, 1);
+    ASSERT_EQUAL(ExecuteProgram(*parallel), "1\nstr class\n"s);
+}
+
 }  // namespace parse
 
 void TestParseProgram(TestRunner& tr) {
@@ -254,4 +564,14 @@ void TestParseProgram(TestRunner& tr) {
     RUN_TEST(tr, parse::TestRecursion2);
     RUN_TEST(tr, parse::TestComplexLogicalExpression);
     RUN_TEST(tr, parse::TestClassicalPolymorphism);
+    RUN_TEST(tr, parse::TestMethodLocals);
+    RUN_TEST(tr, parse::TestNewInstancePerEvaluation);
+    RUN_TEST(tr, parse::TestProgramArena);
+    RUN_TEST(tr, parse::TestStatementParser);
+    RUN_TEST(tr, parse::TestStatementParserStrings);
+    RUN_TEST(tr, parse::TestMemoizedMethod);
+    RUN_TEST(tr, parse::TestDecoratorErrors);
+    RUN_TEST(tr, parse::TestParallelParse);
+    RUN_TEST(tr, parse::TestParallelParseErrors);
+    RUN_TEST(tr, parse::TestParallelParseStrClass);
 }
@@ -0,0 +1,124 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <iomanip>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+// Возвращает класс из цепочки наследования cls, в котором объявлен метод method
+const Class& DeclaringClass(const Class& cls, const Method& method) {
+    for (const Class* current = &cls; current != nullptr; current = current->GetParent()) {
+        const auto& own = current->GetOwnMethods();
+        if (!own.empty() && &method >= own.data() && &method < own.data() + own.size()) {
+            return *current;
+        }
+    }
+    return cls;
+}
+
+double ToMilliseconds(chrono::nanoseconds duration) {
+    return chrono::duration<double, milli>(duration).count();
+}
+}  // namespace
+
+void Profiler::Enter(const Class& cls, const Method& method) {
+    uint32_t index = MethodIndex(cls, method);
+    uint32_t parent = stack_.empty() ? ROOT : stack_.back().node;
+    ++methods_[index].stats.calls;
+    ++methods_[index].active;
+    stack_.push_back({index, ChildNode(parent, index), Clock::now(), created_objects});
+}
+
+void Profiler::Exit() {
+    ActiveCall call = stack_.back();
+    stack_.pop_back();
+    auto elapsed = chrono::duration_cast<chrono::nanoseconds>(Clock::now() - call.start);
+    uint64_t allocations = created_objects - call.start_allocations;
+
+    auto& entry = methods_[call.method];
+    auto exclusive = elapsed - call.children_time;
+    entry.stats.exclusive += exclusive;
+    entry.stats.allocations += allocations - call.children_allocations;
+    // время рекурсивных вызовов уже учтено во внешнем вызове того же метода
+    if (--entry.active == 0) {
+        entry.stats.inclusive += elapsed;
+    }
+    nodes_[call.node].exclusive += exclusive;
+
+    if (!stack_.empty()) {
+        stack_.back().children_time += elapsed;
+        stack_.back().children_allocations += allocations;
+    }
+}
+
+uint32_t Profiler::MethodIndex(const Class& cls, const Method& method) {
+    auto [it, inserted] = method_index_.emplace(&method, static_cast<uint32_t>(methods_.size()));
+    if (inserted) {
+        MethodEntry entry;
+        entry.stats.name = DeclaringClass(cls, method).GetName() + "."s + method.name.Name();
+        methods_.push_back(std::move(entry));
+    }
+    return it->second;
+}
+
+uint32_t Profiler::ChildNode(uint32_t parent, uint32_t method) {
+    uint64_t key = (static_cast<uint64_t>(parent) << 32) | method;
+    auto [it, inserted] = children_.emplace(key, static_cast<uint32_t>(nodes_.size()));
+    if (inserted) {
+        nodes_.push_back({method, parent});
+    }
+    return it->second;
+}
+
+vector<Profiler::MethodStats> Profiler::GetMethodStats() const {
+    vector<MethodStats> result;
+    result.reserve(methods_.size());
+    for (const auto& entry : methods_) {
+        result.push_back(entry.stats);
+    }
+    sort(result.begin(), result.end(), [](const MethodStats& lhs, const MethodStats& rhs) {
+        return lhs.exclusive > rhs.exclusive;
+    });
+    return result;
+}
+
+void Profiler::WriteCollapsedStacks(ostream& os) const {
+    vector<uint32_t> path;
+    // узлы создаются после своих родителей, поэтому путь к корню строится подъёмом по parent
+    for (uint32_t node = ROOT + 1; node < nodes_.size(); ++node) {
+        if (nodes_[node].exclusive.count() <= 0) {
+            continue;
+        }
+        path.clear();
+        for (uint32_t current = node; current != ROOT; current = nodes_[current].parent) {
+            path.push_back(nodes_[current].method);
+        }
+        for (auto it = path.rbegin(); it != path.rend(); ++it) {
+            if (it != path.rbegin()) {
+                os << ';';
+            }
+            os << methods_[*it].stats.name;
+        }
+        os << ' ' << nodes_[node].exclusive.count() << '\n';
+    }
+}
+
+void Profiler::WriteReport(ostream& os) const {
+    auto flags = os.flags();
+    auto precision = os.precision();
+    os << left << setw(40) << "method" << right << setw(12) << "calls" << setw(16)
+       << "inclusive ms" << setw(16) << "exclusive ms" << setw(12) << "allocs" << '\n';
+    os << fixed << setprecision(3);
+    for (const auto& stats : GetMethodStats()) {
+        os << left << setw(40) << stats.name << right << setw(12) << stats.calls << setw(16)
+           << ToMilliseconds(stats.inclusive) << setw(16) << ToMilliseconds(stats.exclusive)
+           << setw(12) << stats.allocations << '\n';
+    }
+    os.flags(flags);
+    os.precision(precision);
+}
+
+}  // namespace runtime
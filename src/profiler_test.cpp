@@ -0,0 +1,137 @@
+#include "profiler.h"
+
+#include "interpreter.h"
+
+#include <test_runner_p.h>
+
+#include <sstream>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+const string_view PROGRAM = R"(
+class Point:
+  def __init__(x):
+    self.x = x
+
+class Fib:
+  def calc(n):
+    if n < 2:
+      p = Point(n)
+      return p.x
+    return self.calc(n - 1) + self.calc(n - 2)
+
+class Child(Fib):
+  def run():
+    return self.calc(10)
+
+c = Child()
+print c.run()
+)"sv;
+
+Profiler::MethodStats FindStats(const Profiler& profiler, const string& name) {
+    for (const auto& stats : profiler.GetMethodStats()) {
+        if (stats.name == name) {
+            return stats;
+        }
+    }
+    throw runtime_error("No stats for "s + name);
+}
+
+void TestMethodStats() {
+    for (auto engine : {mython::Engine::Ast, mython::Engine::Vm}) {
+        auto program = mython::Compile(PROGRAM, {engine});
+        Profiler profiler;
+        DummyContext context;
+        context.SetProfiler(&profiler);
+        Closure closure;
+        mython::Run(program, context, closure);
+        ASSERT_EQUAL(context.output.str(), "55\n"s);
+
+        // унаследованный метод учитывается под именем класса, в котором он объявлен
+        auto calc = FindStats(profiler, "Fib.calc"s);
+        auto run = FindStats(profiler, "Child.run"s);
+        auto init = FindStats(profiler, "Point.__init__"s);
+        ASSERT_EQUAL(calc.calls, 177U);
+        ASSERT_EQUAL(run.calls, 1U);
+        ASSERT_EQUAL(init.calls, 89U);
+        // объект Point создаётся в calc, а не в __init__
+        ASSERT_EQUAL(calc.allocations, 89U);
+        ASSERT_EQUAL(init.allocations, 0U);
+        // время рекурсивных вызовов не учитывается повторно
+        ASSERT(calc.inclusive <= run.inclusive);
+        ASSERT(calc.exclusive <= calc.inclusive);
+        ASSERT(run.exclusive + calc.inclusive <= run.inclusive);
+    }
+}
+
+void TestCollapsedStacks() {
+    auto program = mython::Compile(PROGRAM);
+    Profiler profiler;
+    DummyContext context;
+    context.SetProfiler(&profiler);
+    Closure closure;
+    mython::Run(program, context, closure);
+
+    ostringstream out;
+    profiler.WriteCollapsedStacks(out);
+    istringstream lines(out.str());
+    string line;
+    size_t count = 0;
+    size_t max_depth = 0;
+    while (getline(lines, line)) {
+        ++count;
+        // каждая цепочка начинается с вызова верхнего уровня и заканчивается временем
+        ASSERT(line.substr(0, "Child.run"s.size()) == "Child.run"s);
+        auto space = line.rfind(' ');
+        ASSERT(space != string::npos);
+        ASSERT(stoll(line.substr(space + 1)) > 0);
+        max_depth = max<size_t>(max_depth, std::count(line.begin(), line.end(), ';') + 1);
+    }
+    ASSERT(count > 0);
+    // Child.run, затем до 10 уровней Fib.calc и Point.__init__
+    ASSERT(max_depth <= 12U);
+    ASSERT(max_depth >= 10U);
+}
+
+void TestExceptionUnwinding() {
+    auto program = mython::Compile(R"(
+class Failing:
+  def fail():
+    return 1 / 0
+
+  def ok():
+    return 1
+
+f = Failing()
+f.fail()
+)"sv);
+    Profiler profiler;
+    DummyContext context;
+    context.SetProfiler(&profiler);
+    Closure closure;
+    ASSERT_THROWS(mython::Run(program, context, closure), std::runtime_error);
+
+    // вызов, завершившийся исключением, закрыт, и следующий вызов считается вызовом
+    // верхнего уровня
+    auto next = mython::Compile("f.ok()\n"sv);
+    mython::Run(next, context, closure);
+    ostringstream out;
+    profiler.WriteCollapsedStacks(out);
+    ASSERT(out.str().find("Failing.fail;"s) == string::npos);
+    ASSERT_EQUAL(FindStats(profiler, "Failing.fail"s).calls, 1U);
+    ASSERT_EQUAL(FindStats(profiler, "Failing.ok"s).calls, 1U);
+}
+
+}  // namespace
+
+void RunProfilerTests(TestRunner& tr) {
+    RUN_TEST(tr, runtime::TestMethodStats);
+    RUN_TEST(tr, runtime::TestCollapsedStacks);
+    RUN_TEST(tr, runtime::TestExceptionUnwinding);
+}
+
+}  // namespace runtime
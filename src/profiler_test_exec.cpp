@@ -0,0 +1,21 @@
+#include "profiler.h"
+#include "test_runner_p.h"
+
+#include <iostream>
+
+using namespace std;
+
+namespace runtime {
+void RunProfilerTests(TestRunner& tr);
+}
+
+int main() {
+    try {
+        TestRunner tr;
+        runtime::RunProfilerTests(tr);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
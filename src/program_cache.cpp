@@ -0,0 +1,650 @@
+#include "program_cache.h"
+
+#include "lexer.h"
+#include "parse.h"
+#include "statement.h"
+
+#include <fstream>
+#include <limits>
+#include <random>
+#include <utility>
+
+using namespace std;
+
+namespace cache {
+
+namespace {
+// Начало каждой записи кэша. Версия формата меняется при любом изменении представления узлов
+constexpr string_view MAGIC = "MYTHONC\0"sv;
+constexpr uint32_t FORMAT_VERSION = 3;
+// Размер заголовка: MAGIC, версия, хеш и длина исходного текста, контрольная сумма данных
+constexpr size_t HEADER_SIZE = MAGIC.size() + 4 + 8 + 8 + 8;
+
+// Номер класса, означающий отсутствие базового класса, а при записи - класс,
+// который ещё не записан полностью
+constexpr uint32_t NO_CLASS = std::numeric_limits<uint32_t>::max();
+
+using ComparatorFn = bool (*)(const runtime::ObjectHolder&, const runtime::ObjectHolder&,
+                              runtime::Context&);
+
+const ComparatorFn COMPARATORS[] = {
+    runtime::Equal,       runtime::NotEqual,    runtime::Less,
+    runtime::Greater,     runtime::LessOrEqual, runtime::GreaterOrEqual,
+};
+
+void AppendUint64(string& out, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+void AppendUint(string& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+/*
+ * Восстанавливает синтаксическое дерево из записи кэша. Узлы размещаются в новой арене,
+ * которой владеет возвращаемый корень программы, как и при разборе исходного текста
+ */
+class Reader {
+public:
+    explicit Reader(string_view data)
+        : pos_(data.data()), end_(data.data() + data.size()) {
+    }
+
+    // Проверяет, что запись сделана текущей версией формата для текста source.
+    // Выбрасывает CacheError, если данные записи не совпадают с контрольной суммой
+    bool ReadHeader(string_view source) {
+        if (static_cast<size_t>(end_ - pos_) < HEADER_SIZE
+            || ReadBytes(MAGIC.size()) != MAGIC || ReadUint() != FORMAT_VERSION) {
+            return false;
+        }
+        if (ReadUint64() != SourceHash(source) || ReadUint64() != source.size()) {
+            return false;
+        }
+        uint64_t checksum = ReadUint64();
+        if (checksum != SourceHash(string_view(pos_, end_ - pos_))) {
+            throw CacheError("Checksum mismatch"s);
+        }
+        return true;
+    }
+
+    unique_ptr<ast::Statement> ReadProgram() {
+        for (uint32_t count = ReadCount(); count > 0; --count) {
+            uint32_t size = ReadUint();
+            symbols_.emplace_back(ReadBytes(size));
+        }
+        for (uint32_t count = ReadCount(); count > 0; --count) {
+            ReadClass();
+        }
+        auto root = ReadNode();
+        if (pos_ != end_) {
+            throw CacheError("Unexpected data after the end of program"s);
+        }
+        return make_unique<ast::Program>(arena_, std::move(root));
+    }
+
+private:
+    void ReadClass() {
+        runtime::Symbol name = ReadSymbol();
+        const runtime::Class* parent = nullptr;
+        if (uint32_t parent_index = ReadUint(); parent_index != NO_CLASS) {
+            parent = &GetClass(parent_index);
+        }
+        vector<runtime::Method> methods(ReadCount());
+        for (auto& method : methods) {
+            method.name = ReadSymbol();
+            method.formal_params = ReadSymbols();
+            method.locals_count = ReadLocalsCount(method.formal_params.size());
+            // ёмкость кэша результатов; 0 - метод не объявлен как @memoize
+            if (uint32_t capacity = ReadUint(); capacity > 0) {
+                method.memo = make_unique<runtime::MemoCache>(capacity);
+            }
+            frame_size_ = method.locals_count;
+            method.body = ReadNode();
+            frame_size_ = 0;
+        }
+        classes_.push_back(
+            runtime::ObjectHolder::Own(runtime::Class(name, std::move(methods), parent, arena_)));
+    }
+
+    unique_ptr<ast::Statement> ReadNode() {  // NOLINT
+        switch (static_cast<NodeTag>(ReadByte())) {
+            case NodeTag::NumericConst:
+                return MakeNode<ast::NumericConst>(static_cast<int>(ReadUint()));
+            case NodeTag::StringConst: {
+                uint32_t size = ReadUint();
+                return MakeNode<ast::StringConst>(string{ReadBytes(size)});
+            }
+            case NodeTag::BoolConst:
+                return MakeNode<ast::BoolConst>(runtime::Bool(ReadByte() != 0));
+            case NodeTag::VariableValue:
+                return MakeNode<ast::VariableValue>(ReadVariableValue());
+            case NodeTag::Assignment: {
+                runtime::Symbol var = ReadSymbol();
+                runtime::Slot slot = ReadSlot();
+                return MakeNode<ast::Assignment>(var, ReadNode(), slot);
+            }
+            case NodeTag::FieldAssignment: {
+                if (static_cast<NodeTag>(ReadByte()) != NodeTag::VariableValue) {
+                    throw CacheError("Field assignment to a non-variable object"s);
+                }
+                ast::VariableValue object = ReadVariableValue();
+                runtime::Symbol field = ReadSymbol();
+                return MakeNode<ast::FieldAssignment>(std::move(object), field, ReadNode());
+            }
+            case NodeTag::None:
+                return MakeNode<ast::None>();
+            case NodeTag::Print:
+                return MakeNode<ast::Print>(ReadNodes());
+            case NodeTag::MethodCall: {
+                auto object = ReadNode();
+                runtime::Symbol method = ReadSymbol();
+                return MakeNode<ast::MethodCall>(std::move(object), method, ReadNodes());
+            }
+            case NodeTag::NewInstance: {
+                const runtime::Class& cls = GetClass(ReadUint());
+                return MakeNode<ast::NewInstance>(cls, ReadNodes());
+            }
+            case NodeTag::Stringify:
+                return MakeNode<ast::Stringify>(ReadNode());
+            case NodeTag::Add:
+                return ReadBinary<ast::Add>();
+            case NodeTag::Sub:
+                return ReadBinary<ast::Sub>();
+            case NodeTag::Mult:
+                return ReadBinary<ast::Mult>();
+            case NodeTag::Div:
+                return ReadBinary<ast::Div>();
+            case NodeTag::Or:
+                return ReadBinary<ast::Or>();
+            case NodeTag::And:
+                return ReadBinary<ast::And>();
+            case NodeTag::Not:
+                return MakeNode<ast::Not>(ReadNode());
+            case NodeTag::Compound: {
+                auto result = MakeNode<ast::Compound>();
+                for (uint32_t count = ReadCount(); count > 0; --count) {
+                    result->AddStatement(ReadNode());
+                }
+                return result;
+            }
+            case NodeTag::MethodBody:
+                return MakeNode<ast::MethodBody>(ReadNode());
+            case NodeTag::Return:
+                return MakeNode<ast::Return>(ReadNode());
+            case NodeTag::ClassDefinition: {
+                const runtime::ObjectHolder& cls = GetClassHolder(ReadUint());
+                return MakeNode<ast::ClassDefinition>(cls, ReadSlot());
+            }
+            case NodeTag::IfElse: {
+                auto condition = ReadNode();
+                auto if_body = ReadNode();
+                return MakeNode<ast::IfElse>(std::move(condition), std::move(if_body),
+                                             ReadOptionalNode());
+            }
+            case NodeTag::Comparison: {
+                uint32_t cmp = ReadUint();
+                if (cmp >= std::size(COMPARATORS)) {
+                    throw CacheError("Unknown comparator "s + to_string(cmp));
+                }
+                auto lhs = ReadNode();
+                return MakeNode<ast::Comparison>(COMPARATORS[cmp], std::move(lhs), ReadNode());
+            }
+        }
+        throw CacheError("Unknown node tag"s);
+    }
+
+    vector<unique_ptr<ast::Statement>> ReadNodes() {
+        vector<unique_ptr<ast::Statement>> result;
+        for (uint32_t count = ReadCount(); count > 0; --count) {
+            result.push_back(ReadNode());
+        }
+        return result;
+    }
+
+    unique_ptr<ast::Statement> ReadOptionalNode() {
+        return ReadByte() != 0 ? ReadNode() : nullptr;
+    }
+
+    template <typename Node>
+    unique_ptr<ast::Statement> ReadBinary() {
+        auto lhs = ReadNode();
+        return MakeNode<Node>(std::move(lhs), ReadNode());
+    }
+
+    ast::VariableValue ReadVariableValue() {
+        vector<runtime::Symbol> dotted_ids = ReadSymbols();
+        if (dotted_ids.empty()) {
+            throw CacheError("Variable without name"s);
+        }
+        return ast::VariableValue{std::move(dotted_ids), ReadSlot()};
+    }
+
+    const runtime::ObjectHolder& GetClassHolder(uint32_t index) const {
+        if (index >= classes_.size()) {
+            throw CacheError("Unknown class "s + to_string(index));
+        }
+        return classes_[index];
+    }
+
+    const runtime::Class& GetClass(uint32_t index) const {
+        return static_cast<const runtime::Class&>(*GetClassHolder(index));  // NOLINT
+    }
+
+    runtime::Symbol ReadSymbol() {
+        uint32_t index = ReadUint();
+        if (index >= symbols_.size()) {
+            throw CacheError("Unknown symbol "s + to_string(index));
+        }
+        return symbols_[index];
+    }
+
+    vector<runtime::Symbol> ReadSymbols() {
+        vector<runtime::Symbol> result;
+        for (uint32_t count = ReadCount(); count > 0; --count) {
+            result.push_back(ReadSymbol());
+        }
+        return result;
+    }
+
+    // Читает номер слота переменной, который должен попадать в кадр читаемого метода
+    runtime::Slot ReadSlot() {
+        runtime::Slot slot = ReadUint();
+        if (slot != runtime::NO_SLOT && slot >= frame_size_) {
+            throw CacheError("Invalid variable slot "s + to_string(slot));
+        }
+        return slot;
+    }
+
+    // Читает размер кадра метода с params_count параметрами. Кадр содержит self и параметры,
+    // а каждая из остальных переменных упоминается в теле метода хотя бы одним узлом
+    runtime::Slot ReadLocalsCount(size_t params_count) {
+        runtime::Slot count = ReadUint();
+        if (count != 0
+            && (count <= params_count || count - params_count - 1 > Remaining())) {
+            throw CacheError("Invalid frame size "s + to_string(count));
+        }
+        return count;
+    }
+
+    // Читает количество элементов списка. Каждый элемент занимает хотя бы один байт
+    uint32_t ReadCount() {
+        uint32_t count = ReadUint();
+        if (count > Remaining()) {
+            throw CacheError("Invalid element count "s + to_string(count));
+        }
+        return count;
+    }
+
+    size_t Remaining() const {
+        return static_cast<size_t>(end_ - pos_);
+    }
+
+    string_view ReadBytes(size_t size) {
+        if (Remaining() < size) {
+            throw CacheError("Unexpected end of cached program"s);
+        }
+        string_view result{pos_, size};
+        pos_ += size;
+        return result;
+    }
+
+    uint8_t ReadByte() {
+        return static_cast<uint8_t>(ReadBytes(1).front());
+    }
+
+    uint32_t ReadUint() {
+        uint32_t result = 0;
+        string_view bytes = ReadBytes(4);
+        for (int i = 0; i < 4; ++i) {
+            result |= static_cast<uint32_t>(static_cast<uint8_t>(bytes[i])) << (8 * i);
+        }
+        return result;
+    }
+
+    uint64_t ReadUint64() {
+        uint64_t low = ReadUint();
+        return low | static_cast<uint64_t>(ReadUint()) << 32;
+    }
+
+    template <typename Node, typename... Args>
+    unique_ptr<Node> MakeNode(Args&&... args) {
+        return unique_ptr<Node>(new (*arena_) Node(std::forward<Args>(args)...));
+    }
+
+    const char* pos_;
+    const char* end_;
+    // количество слотов кадра метода, тело которого читается; 0 - переменным слоты не назначены
+    runtime::Slot frame_size_ = 0;
+    shared_ptr<ast::Arena> arena_ = make_shared<ast::Arena>();
+    vector<runtime::Symbol> symbols_;
+    vector<runtime::ObjectHolder> classes_;
+};
+}  // namespace
+
+void Writer::WriteNode(const ast::Statement& node) {
+    node.Serialize(*this);
+}
+
+void Writer::WriteNodes(const vector<unique_ptr<ast::Statement>>& nodes) {
+    WriteUint(static_cast<uint32_t>(nodes.size()));
+    for (const auto& node : nodes) {
+        WriteNode(*node);
+    }
+}
+
+void Writer::WriteOptionalNode(const ast::Statement* node) {
+    out_->push_back(node != nullptr ? 1 : 0);
+    if (node != nullptr) {
+        WriteNode(*node);
+    }
+}
+
+void Writer::WriteTag(NodeTag tag) {
+    out_->push_back(static_cast<char>(tag));
+}
+
+void Writer::WriteUint(uint32_t value) {
+    AppendUint(*out_, value);
+}
+
+void Writer::WriteSymbol(runtime::Symbol symbol) {
+    auto [it, inserted] = symbol_index_.emplace(symbol, static_cast<uint32_t>(symbols_.size()));
+    if (inserted) {
+        symbols_.push_back(symbol);
+    }
+    WriteUint(it->second);
+}
+
+void Writer::WriteSymbols(const vector<runtime::Symbol>& symbols) {
+    WriteUint(static_cast<uint32_t>(symbols.size()));
+    for (auto symbol : symbols) {
+        WriteSymbol(symbol);
+    }
+}
+
+void Writer::WriteConstant(const runtime::Number& value) {
+    WriteTag(NodeTag::NumericConst);
+    WriteUint(static_cast<uint32_t>(value.GetValue()));
+}
+
+void Writer::WriteConstant(const runtime::String& value) {
+    WriteTag(NodeTag::StringConst);
+    WriteUint(static_cast<uint32_t>(value.GetValue().size()));
+    WriteBytes(value.GetValue().data(), value.GetValue().size());
+}
+
+void Writer::WriteConstant(const runtime::Bool& value) {
+    WriteTag(NodeTag::BoolConst);
+    out_->push_back(value.GetValue() ? 1 : 0);
+}
+
+void Writer::WriteClass(const runtime::Class& cls) {
+    WriteUint(ClassIndex(cls));
+}
+
+void Writer::WriteComparator(const Comparator& cmp) {
+    if (const auto* fn = cmp.target<ComparatorFn>()) {
+        for (size_t i = 0; i < std::size(COMPARATORS); ++i) {
+            if (*fn == COMPARATORS[i]) {
+                WriteUint(static_cast<uint32_t>(i));
+                return;
+            }
+        }
+    }
+    throw CacheError("Only standard comparisons can be cached"s);
+}
+
+uint32_t Writer::ClassIndex(const runtime::Class& cls) {  // NOLINT
+    if (auto it = class_index_.find(&cls); it != class_index_.end()) {
+        if (it->second == NO_CLASS) {
+            throw CacheError("Class "s + cls.GetName() + " refers to itself"s);
+        }
+        return it->second;
+    }
+    class_index_.emplace(&cls, NO_CLASS);
+
+    // запись класса собирается отдельно: классы, упомянутые в ней, попадают в таблицу раньше
+    string record;
+    string* enclosing = std::exchange(out_, &record);
+    WriteSymbol(cls.GetName());
+    WriteUint(cls.GetParent() != nullptr ? ClassIndex(*cls.GetParent()) : NO_CLASS);
+    WriteUint(static_cast<uint32_t>(cls.GetOwnMethods().size()));
+    for (const auto& method : cls.GetOwnMethods()) {
+        const auto* body = dynamic_cast<const ast::Statement*>(method.body.get());
+        if (body == nullptr) {
+            throw CacheError("Method "s + method.name.Name() + " of class "s + cls.GetName()
+                             + " can't be cached"s);
+        }
+        WriteSymbol(method.name);
+        WriteSymbols(method.formal_params);
+        WriteSlot(method.locals_count);
+        WriteUint(method.memo ? static_cast<uint32_t>(method.memo->GetCapacity()) : 0);
+        WriteNode(*body);
+    }
+    out_ = enclosing;
+
+    classes_ += record;
+    return class_index_[&cls] = class_count_++;
+}
+
+void Writer::WriteBytes(const void* data, size_t size) {
+    out_->append(static_cast<const char*>(data), size);
+}
+
+uint64_t SourceHash(string_view source) {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    for (char c : source) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+string Serialize(const ast::Statement& program, string_view source) {
+    Writer writer;
+    writer.WriteNode(program);
+
+    string result{MAGIC};
+    AppendUint(result, FORMAT_VERSION);
+    AppendUint64(result, SourceHash(source));
+    AppendUint64(result, source.size());
+    // контрольная сумма дописывается, когда данные записи собраны
+    const size_t checksum_pos = result.size();
+    AppendUint64(result, 0);
+    AppendUint(result, static_cast<uint32_t>(writer.symbols_.size()));
+    for (auto symbol : writer.symbols_) {
+        AppendUint(result, static_cast<uint32_t>(symbol.Name().size()));
+        result += symbol.Name();
+    }
+    AppendUint(result, writer.class_count_);
+    result += writer.classes_;
+    result += writer.main_;
+    string checksum;
+    AppendUint64(checksum, SourceHash(string_view(result).substr(HEADER_SIZE)));
+    result.replace(checksum_pos, checksum.size(), checksum);
+    return result;
+}
+
+unique_ptr<ast::Statement> Deserialize(string_view data, string_view source) {
+    Reader reader(data);
+    if (!reader.ReadHeader(source)) {
+        return nullptr;
+    }
+    return reader.ReadProgram();
+}
+
+ProgramCache::ProgramCache(filesystem::path directory)
+    : directory_(std::move(directory)) {
+}
+
+unique_ptr<ast::Statement> ProgramCache::Load(string_view source) const {
+    auto path = EntryPath(source);
+    if (error_code ec; filesystem::exists(path, ec)) {
+        try {
+            parse::MappedSource entry(path);
+            if (auto program = Deserialize(entry.View(), source)) {
+                return program;
+            }
+        } catch (const std::exception&) {
+            // повреждённая запись будет перезаписана
+        }
+    }
+
+    parse::Lexer lexer(source);
+    auto program = ParseProgram(lexer);
+    Store(*program, source);
+    return program;
+}
+
+filesystem::path ProgramCache::EntryPath(string_view source) const {
+    static constexpr char digits[] = "0123456789abcdef";
+    string name(16, '0');
+    uint64_t hash = SourceHash(source);
+    for (auto it = name.rbegin(); it != name.rend(); ++it, hash >>= 4) {
+        *it = digits[hash & 0xF];
+    }
+    return directory_ / (name + ".myc"s);
+}
+
+void ProgramCache::Store(const ast::Statement& program, string_view source) const {
+    auto path = EntryPath(source);
+    // запись выполняется во временный файл и переименовывается, чтобы параллельно запущенные
+    // интерпретаторы не прочитали запись частично
+    auto temp = path;
+    temp += ".tmp"s + to_string(random_device{}());
+    error_code ec;
+    try {
+        string data = Serialize(program, source);
+        filesystem::create_directories(directory_, ec);
+        ofstream out(temp, ios::binary);
+        out.write(data.data(), static_cast<streamsize>(data.size()));
+        out.close();
+        if (out) {
+            filesystem::rename(temp, path, ec);
+        }
+    } catch (const std::exception&) {
+        // программа, которую нельзя сохранить, просто не попадает в кэш
+    }
+    filesystem::remove(temp, ec);
+}
+
+}  // namespace cache
+
+namespace ast {
+
+void VariableValue::Serialize(cache::Writer& writer) const {
+    writer.WriteTag(cache::NodeTag::VariableValue);
+    writer.WriteUint(static_cast<uint32_t>(tail_.size() + 1));
+    writer.WriteSymbol(var_name_);
+    for (auto name : tail_) {
+        writer.WriteSymbol(name);
+    }
+    writer.WriteSlot(slot_);
+}
+
+void Assignment::Serialize(cache::Writer& writer) const {
+    writer.WriteTag(cache::NodeTag::Assignment);
+    writer.WriteSymbol(var_);
+    writer.WriteSlot(slot_);
+    writer.WriteNode(*rv_);
+}
+
+void FieldAssignment::Serialize(cache::Writer& writer) const {
+    writer.WriteTag(cache::NodeTag::FieldAssignment);
+    writer.WriteNode(object_);
+    writer.WriteSymbol(field_name_);
+    writer.WriteNode(*rv_);
+}
+
+void None::Serialize(cache::Writer& writer) const {
+    writer.WriteTag(cache::NodeTag::None);
+}
+
+void Print::Serialize(cache::Writer& writer) const {
+    writer.WriteTag(cache::NodeTag::Print);
+    writer.WriteNodes(args_);
+}
+
+void MethodCall::Serialize(cache::Writer& writer) const {
+    writer.WriteTag(cache::NodeTag::MethodCall);
+    writer.WriteNode(*object_);
+    writer.WriteSymbol(method_);
+    writer.WriteNodes(args_);
+}
+
+void NewInstance::Serialize(cache::Writer& writer) const {
+    writer.WriteTag(cache::NodeTag::NewInstance);
+    writer.WriteClass(*class_);
+    writer.WriteNodes(args_);
+}
+
+void Stringify::Serialize(cache::Writer& writer) const {
+    writer.WriteTag(cache::NodeTag::Stringify);
+    writer.WriteNode(*argument_);
+}
+
+#define BINARY_SERIALIZE(type)                            \
+    void type::Serialize(cache::Writer& writer) const {   \
+        writer.WriteTag(cache::NodeTag::type);            \
+        writer.WriteNode(*lhs_);                          \
+        writer.WriteNode(*rhs_);                          \
+    }
+
+BINARY_SERIALIZE(Add)
+BINARY_SERIALIZE(Sub)
+BINARY_SERIALIZE(Mult)
+BINARY_SERIALIZE(Div)
+BINARY_SERIALIZE(Or)
+BINARY_SERIALIZE(And)
+
+#undef BINARY_SERIALIZE
+
+void Not::Serialize(cache::Writer& writer) const {
+    writer.WriteTag(cache::NodeTag::Not);
+    writer.WriteNode(*argument_);
+}
+
+void Compound::Serialize(cache::Writer& writer) const {
+    writer.WriteTag(cache::NodeTag::Compound);
+    writer.WriteNodes(args_);
+}
+
+void MethodBody::Serialize(cache::Writer& writer) const {
+    writer.WriteTag(cache::NodeTag::MethodBody);
+    writer.WriteNode(*body_);
+}
+
+void Program::Serialize(cache::Writer& writer) const {
+    writer.WriteNode(*root_);
+}
+
+void Return::Serialize(cache::Writer& writer) const {
+    writer.WriteTag(cache::NodeTag::Return);
+    writer.WriteNode(*statement_);
+}
+
+void ClassDefinition::Serialize(cache::Writer& writer) const {
+    writer.WriteTag(cache::NodeTag::ClassDefinition);
+    writer.WriteClass(*cls_.TryAs<runtime::Class>());
+    writer.WriteSlot(slot_);
+}
+
+void IfElse::Serialize(cache::Writer& writer) const {
+    writer.WriteTag(cache::NodeTag::IfElse);
+    writer.WriteNode(*condition_);
+    writer.WriteNode(*if_body_);
+    writer.WriteOptionalNode(else_body_.get());
+}
+
+void Comparison::Serialize(cache::Writer& writer) const {
+    writer.WriteTag(cache::NodeTag::Comparison);
+    writer.WriteComparator(cmp_);
+    writer.WriteNode(*lhs_);
+    writer.WriteNode(*rhs_);
+}
+
+}  // namespace ast
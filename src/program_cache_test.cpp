@@ -0,0 +1,236 @@
+#include "program_cache.h"
+
+#include "lexer.h"
+#include "parse.h"
+#include "statement.h"
+#include "vm.h"
+
+#include <test_runner_p.h>
+
+#include <filesystem>
+#include <fstream>
+
+using namespace std;
+
+namespace cache {
+
+namespace {
+
+const string PROGRAM = R"(
+class Shape:
+  def __init__(name):
+    self.name = name
+
+  def __str__():
+    return 'Shape ' + self.name
+
+  @memoize(8)
+  def area():
+    return None
+
+class Rect(Shape):
+  def __init__(w, h):
+    self.name = 'rect'
+    self.w = w
+    self.h = h
+
+  def area():
+    return self.w * self.h
+
+class Factory:
+  def make(n):
+    if n < 1 or not n != 1:
+      return Rect(n, 2)
+    else:
+      return Rect(n - 1, 10 / n)
+
+f = Factory()
+r = f.make(4)
+r.w = r.w + 1
+print r, r.area(), r.w >= 4, r.h <= 2, str(-3) + "x", True and False
+s = Shape('circle')
+print s.area(), Shape
+)";
+
+const string EXPECTED = "Shape rect 8 True True -3x False\nNone Class Shape\n"s;
+
+unique_ptr<ast::Statement> Parse(string_view source) {
+    parse::Lexer lexer(source);
+    return ParseProgram(lexer);
+}
+
+string RunAst(ast::Statement& program) {
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    program.Execute(closure, context);
+    return context.output.str();
+}
+
+// Смещение контрольной суммы данных и размер заголовка записи
+constexpr size_t CHECKSUM_POS = 28;
+constexpr size_t HEADER_SIZE = 36;
+
+// Пересчитывает контрольную сумму записи после изменения её данных
+void Reseal(string& data) {
+    uint64_t checksum = SourceHash(string_view(data).substr(HEADER_SIZE));
+    for (size_t i = 0; i < 8; ++i) {
+        data[CHECKSUM_POS + i] = static_cast<char>(checksum >> (8 * i));
+    }
+}
+
+// Возвращает true, если из данных data восстанавливается программа с текстом source
+bool Loads(string_view data, string_view source) {
+    try {
+        return Deserialize(data, source) != nullptr;
+    } catch (const CacheError&) {
+        return false;
+    }
+}
+
+// Возвращает запись программы из объявления класса A с методом f(a), кадр которого
+// состоит из locals_count слотов, а тело присваивает значение переменной со слотом slot
+string MethodEntry(runtime::Slot locals_count, runtime::Slot slot) {
+    vector<runtime::Method> methods(1);
+    methods[0].name = "f"sv;
+    methods[0].formal_params = {"a"sv};
+    methods[0].locals_count = locals_count;
+    methods[0].body = make_unique<ast::MethodBody>(
+        make_unique<ast::Assignment>("y"sv, make_unique<ast::NumericConst>(1), slot));
+    ast::ClassDefinition definition(
+        runtime::ObjectHolder::Own(runtime::Class("A"sv, std::move(methods), nullptr)));
+    return Serialize(definition, ""sv);
+}
+
+string RunVm(const ast::Statement& program) {
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    vm::Run(vm::Compile(program), closure, context);
+    return context.output.str();
+}
+
+void TestRoundTrip() {
+    auto program = Parse(PROGRAM);
+    string data = Serialize(*program, PROGRAM);
+    ASSERT_EQUAL(RunAst(*program), EXPECTED);
+
+    auto loaded = Deserialize(data, PROGRAM);
+    ASSERT(loaded != nullptr);
+    ASSERT_EQUAL(RunAst(*loaded), EXPECTED);
+    ASSERT_EQUAL(RunVm(*loaded), EXPECTED);
+    // повторная сериализация восстановленной программы даёт те же данные
+    ASSERT_EQUAL(Serialize(*loaded, PROGRAM), data);
+
+    // восстановленная программа не зависит от данных, из которых получена
+    data.assign(data.size(), '\0');
+    ASSERT_EQUAL(RunAst(*loaded), EXPECTED);
+}
+
+void TestEntryValidation() {
+    auto program = Parse(PROGRAM);
+    const string data = Serialize(*program, PROGRAM);
+
+    // запись для другого текста или неполный заголовок не считаются повреждением
+    ASSERT(Deserialize(data, PROGRAM + "\n"s) == nullptr);
+    ASSERT(Deserialize(data.substr(0, 10), PROGRAM) == nullptr);
+    ASSERT(Deserialize(""sv, PROGRAM) == nullptr);
+
+    ASSERT_THROWS((void)Deserialize(data.substr(0, data.size() - 1), PROGRAM), CacheError);
+    ASSERT_THROWS((void)Deserialize(data + "x"s, PROGRAM), CacheError);
+    // количество символов, следующее за заголовком, больше, чем есть в данных
+    string broken = data;
+    broken.replace(HEADER_SIZE, 4, 4, static_cast<char>(0xFF));
+    ASSERT_THROWS((void)Deserialize(broken, PROGRAM), CacheError);
+    Reseal(broken);
+    ASSERT_THROWS((void)Deserialize(broken, PROGRAM), CacheError);
+
+    // произвольную функцию сравнения сохранить нельзя
+    ast::Comparison custom(
+        [](const runtime::ObjectHolder&, const runtime::ObjectHolder&, runtime::Context&) {
+            return true;
+        },
+        make_unique<ast::None>(), make_unique<ast::None>());
+    ASSERT_THROWS((void)Serialize(custom, ""sv), CacheError);
+}
+
+void TestCorruptedEntries() {
+    auto program = Parse(PROGRAM);
+    const string data = Serialize(*program, PROGRAM);
+    ASSERT(Loads(data, PROGRAM));
+
+    for (size_t size = 0; size < data.size(); ++size) {
+        ASSERT(!Loads(data.substr(0, size), PROGRAM));
+    }
+    // изменение любого бита записи обнаруживается по заголовку или контрольной сумме
+    for (size_t pos = 0; pos < data.size(); ++pos) {
+        for (int bit = 0; bit < 8; ++bit) {
+            string broken = data;
+            broken[pos] = static_cast<char>(broken[pos] ^ (1 << bit));
+            ASSERT(!Loads(broken, PROGRAM));
+        }
+    }
+}
+
+void TestFrameValidation() {
+    // self, параметр a и переменная y
+    ASSERT(Loads(MethodEntry(3, 2), ""sv));
+    ASSERT(Loads(MethodEntry(0, runtime::NO_SLOT), ""sv));
+
+    // записи с верной контрольной суммой, кадр которых не вмещает переменные метода
+    ASSERT_THROWS((void)Deserialize(MethodEntry(3, 3), ""sv), CacheError);
+    ASSERT_THROWS((void)Deserialize(MethodEntry(3, 0x10000000), ""sv), CacheError);
+    ASSERT_THROWS((void)Deserialize(MethodEntry(0, 2), ""sv), CacheError);
+    ASSERT_THROWS((void)Deserialize(MethodEntry(1, runtime::NO_SLOT), ""sv), CacheError);
+    ASSERT_THROWS((void)Deserialize(MethodEntry(0x7fffffff, 2), ""sv), CacheError);
+
+    // слот переменной вне метода
+    ast::Assignment assignment("x"sv, make_unique<ast::NumericConst>(1), 0);
+    ASSERT_THROWS((void)Deserialize(Serialize(assignment, ""sv), ""sv), CacheError);
+}
+
+void TestProgramCache() {
+    const auto directory = filesystem::temp_directory_path() / "mython_program_cache_test";
+    filesystem::remove_all(directory);
+    ProgramCache cache(directory);
+
+    const string source = "print 'parsed'\n"s;
+    const auto path = cache.EntryPath(source);
+    ASSERT(path.parent_path() == directory);
+    ASSERT(path != cache.EntryPath("print 'other'\n"sv));
+
+    ASSERT_EQUAL(RunAst(*cache.Load(source)), "parsed\n"s);
+    ASSERT(filesystem::exists(path));
+    ASSERT_EQUAL(distance(filesystem::directory_iterator(directory),
+                          filesystem::directory_iterator()), 1);
+
+    // программа берётся из записи кэша, а не разбирается заново
+    {
+        ofstream out(path, ios::binary);
+        out << Serialize(*Parse("print 'cached'\n"sv), source);
+    }
+    ASSERT_EQUAL(RunAst(*cache.Load(source)), "cached\n"s);
+
+    // повреждённая запись заменяется результатом разбора
+    {
+        ofstream out(path, ios::binary);
+        out << "garbage"s;
+    }
+    ASSERT_EQUAL(RunAst(*cache.Load(source)), "parsed\n"s);
+    ASSERT_EQUAL(RunAst(*cache.Load(source)), "parsed\n"s);
+    ASSERT(Deserialize(parse::MappedSource(path).View(), source) != nullptr);
+
+    ASSERT_THROWS((void)cache.Load("x = \n"sv), parse::LexerError);
+
+    filesystem::remove_all(directory);
+}
+
+}  // namespace
+
+void RunProgramCacheTests(TestRunner& tr) {
+    RUN_TEST(tr, cache::TestRoundTrip);
+    RUN_TEST(tr, cache::TestEntryValidation);
+    RUN_TEST(tr, cache::TestCorruptedEntries);
+    RUN_TEST(tr, cache::TestFrameValidation);
+    RUN_TEST(tr, cache::TestProgramCache);
+}
+
+}  // namespace cache
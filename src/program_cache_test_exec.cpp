@@ -0,0 +1,21 @@
+#include "program_cache.h"
+#include "test_runner_p.h"
+
+#include <iostream>
+
+using namespace std;
+
+namespace cache {
+void RunProgramCacheTests(TestRunner& tr);
+}
+
+int main() {
+    try {
+        TestRunner tr;
+        cache::RunProgramCacheTests(tr);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,61 +1,75 @@
 #include "runtime.h"
 
+#include "budget.h"
+#include "collector.h"
+#include "profiler.h"
+
 #include <algorithm>
 #include <cassert>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <optional>
 
 using namespace std;
 
 namespace {
-const string STR_METHOD = "__str__"s;
-const string EQ_METHOD = "__eq__"s;
-const string LESS_METHOD = "__lt__"s;
+const runtime::Symbol STR_METHOD{"__str__"sv};
+const runtime::Symbol EQ_METHOD{"__eq__"sv};
+const runtime::Symbol LESS_METHOD{"__lt__"sv};
+const runtime::Symbol SELF{"self"sv};
+const string EMPTY_OBJECT = "None"s;
+
+// Результат метода может оказаться невладеющей ссылкой на self и пережить объект
+runtime::ObjectHolder OwningResult(runtime::ObjectHolder result) {
+    result.MakeOwning();
+    return result;
+}
 
+// Сравнивает значения lhs и rhs одного типа (числа, строки или логические значения)
+// с помощью pred. Для значений других типов возвращает nullopt
 template<class BinaryPredicate>
-bool Comp(const runtime::ObjectHolder &lhs, const runtime::ObjectHolder &rhs, BinaryPredicate pred) {
-    {
-        auto l = lhs.TryAs<runtime::Bool>();
-        auto r = rhs.TryAs<runtime::Bool>();
-        if (l && r) {
-            return pred(l->GetValue(), r->GetValue());
-        }
-    }
-
-    {
-        auto l = lhs.TryAs<runtime::Number>();
-        auto r = rhs.TryAs<runtime::Number>();
-        if (l && r) {
-            return pred(l->GetValue(), r->GetValue());
-        }
+std::optional<bool> Comp(const runtime::ObjectHolder &lhs, const runtime::ObjectHolder &rhs,
+                         BinaryPredicate pred) {
+    using runtime::ObjectKind;
+    ObjectKind kind = lhs.GetKind();
+    if (kind != rhs.GetKind()) {
+        return std::nullopt;
     }
-
-    {
-        auto l = lhs.TryAs<runtime::String>();
-        auto r = rhs.TryAs<runtime::String>();
-        if (l && r) {
-            return pred(l->GetValue(), r->GetValue());
+    switch (kind) {
+        case ObjectKind::Bool:
+            return pred(lhs.TryAs<runtime::Bool>()->GetValue(),
+                        rhs.TryAs<runtime::Bool>()->GetValue());
+        case ObjectKind::Number:
+            return pred(lhs.TryAs<runtime::Number>()->GetValue(),
+                        rhs.TryAs<runtime::Number>()->GetValue());
+        case ObjectKind::String: {
+            const auto* l = lhs.TryAs<runtime::String>();
+            const auto* r = rhs.TryAs<runtime::String>();
+            if constexpr (std::is_same_v<BinaryPredicate, std::equal_to<>>) {
+                return l->Equals(*r);
+            } else {
+                return pred(l->View(), r->View());
+            }
         }
+        default:
+            return std::nullopt;
     }
-    throw std::runtime_error("Cannot compare objects"s);
 }
 }  // namespace
 
 namespace runtime {
 
-ObjectHolder::ObjectHolder(std::shared_ptr<Object> data)
-    : data_(std::move(data)) {
-}
-
 void ObjectHolder::AssertIsValid() const {
-    assert(data_ != nullptr);
+    assert(storage_ != Storage::None);
 }
 
 ObjectHolder ObjectHolder::Share(Object& object) {
-    // Возвращаем невладеющий shared_ptr (его deleter ничего не делает)
-    return ObjectHolder(std::shared_ptr<Object>(&object, [](auto* /*p*/) { /* do nothing */ }));
-}
-
-ObjectHolder ObjectHolder::None() {
-    return ObjectHolder();
+    // невладеющая ссылка не изменяет счётчик ссылок объекта, поэтому копируется бесплатно
+    ObjectHolder result;
+    result.object_ = &object;
+    result.storage_ = Storage::Borrowed;
+    return result;
 }
 
 Object& ObjectHolder::operator*() const {
@@ -68,12 +82,174 @@ Object* ObjectHolder::operator->() const {
     return Get();
 }
 
-Object* ObjectHolder::Get() const {
-    return data_.get();
+namespace {
+// Объект, на который ссылается маркер Undefined
+class UndefinedValue : public Object {
+public:
+    void Print(std::ostream& /*os*/, Context& /*context*/) override {
+    }
+};
+
+UndefinedValue undefined_value;
+}  // namespace
+
+const ObjectHolder& Undefined() {
+    static const ObjectHolder undefined = ObjectHolder::Share(undefined_value);
+    return undefined;
+}
+
+bool IsUndefined(const ObjectHolder& value) {
+    return value.Get() == &undefined_value;
+}
+
+size_t Shape::FindField(Symbol name) const {
+    if (names_.size() > INDEXED_SIZE) {
+        auto it = index_.find(name);
+        return it != index_.end() ? it->second : NO_FIELD;
+    }
+    for (size_t i = 0; i < names_.size(); ++i) {
+        if (names_[i] == name) {
+            return i;
+        }
+    }
+    return NO_FIELD;
+}
+
+const Shape* Shape::AddField(Symbol name) const {
+    std::lock_guard lock(transitions_mutex_);
+    for (const auto& [field, shape] : transitions_) {
+        if (field == name) {
+            return shape.get();
+        }
+    }
+    auto shape = std::make_unique<Shape>();
+    shape->names_ = names_;
+    shape->names_.push_back(name);
+    if (shape->names_.size() > INDEXED_SIZE) {
+        for (size_t i = 0; i < shape->names_.size(); ++i) {
+            shape->index_.emplace(shape->names_[i], i);
+        }
+    }
+    return transitions_.emplace_back(name, std::move(shape)).second.get();
+}
+
+void Context::SetStats(ExecutionStats* stats) {
+    if (stats_ != nullptr) {
+        stats_->Detach(stat_counters_);
+        stat_counters_ = nullptr;
+    }
+    stats_ = stats;
+    if (stats_ != nullptr) {
+        stat_counters_ = stats_->Attach();
+        stat_counters_->output_mark_ = GetOutputPosition();
+    }
+}
+
+void Context::CountOutput() {
+    if (stat_counters_ != nullptr) {
+        stat_counters_->SyncOutput(GetOutputPosition());
+    }
 }
 
-ObjectHolder::operator bool() const {
-    return Get() != nullptr;
+uint64_t Context::GetOutputPosition() {
+    if (auto* buffer = GetOutputBuffer()) {
+        return buffer->GetWrittenSize();
+    }
+    auto position = GetOutputStream().tellp();
+    return position >= 0 ? static_cast<uint64_t>(position) : 0;
+}
+
+Frame::Frame(Context& context, Slot size)
+    : context_(context), prev_base_(context.frame_base_) {
+    size_t base = context.frame_top_;
+    context.frame_top_ += size;
+    if (context.locals_.size() < context.frame_top_) {
+        context.locals_.resize(std::max(context.frame_top_, context.locals_.size() * 2));
+    }
+    std::fill(context.locals_.begin() + base, context.locals_.begin() + context.frame_top_,
+              Undefined());
+    context.frame_base_ = base;
+}
+
+Frame::~Frame() {
+    size_t base = context_.frame_base_;
+    for (size_t i = base; i < context_.frame_top_; ++i) {
+        context_.locals_[i] = ObjectHolder::None();
+    }
+    context_.frame_top_ = base;
+    context_.frame_base_ = prev_base_;
+}
+
+ObjectHolder String::Concat(const String& lhs, const String& rhs) {
+    size_t size = lhs.GetSize() + rhs.GetSize();
+    if (size < MIN_BUFFER_SIZE) {
+        std::string value;
+        value.reserve(size);
+        value.append(lhs.View()).append(rhs.View());
+        return ObjectHolder::Own(String(std::move(value)));
+    }
+    String result(nullptr, size);
+    // при MYTHON_ATOMIC_REFCOUNT строки с самого создания доступны всем потокам
+    if (result.IsSharedWithThreads()) {
+        std::string value;
+        value.reserve(size);
+        value.append(lhs.View()).append(rhs.View());
+        return ObjectHolder::Own(String(std::move(value)));
+    }
+    if (lhs.buffer_ && lhs.buffer_->size() == lhs.size_) {
+        // левое слагаемое заканчивается в конце буфера: правое дописывается в буфер
+        result.buffer_ = lhs.buffer_;
+        if (rhs.buffer_ == lhs.buffer_) {
+            result.buffer_->append(*rhs.buffer_, 0, rhs.size_);
+        } else {
+            result.buffer_->append(rhs.View());
+        }
+    } else {
+        result.buffer_ = std::make_shared<std::string>();
+        // запас позволяет дописывать следующие слагаемые без перераспределения памяти
+        result.buffer_->reserve(size * 2);
+        result.buffer_->append(lhs.View()).append(rhs.View());
+    }
+    return ObjectHolder::Own(std::move(result));
+}
+
+void String::Print(std::ostream& os, [[maybe_unused]] Context& context) {
+    auto value = View();
+    os.write(value.data(), static_cast<std::streamsize>(value.size()));
+}
+
+void String::ShareWithThreads() const {
+    if (buffer_) {
+        Flatten();
+    }
+    Object::ShareWithThreads();
+}
+
+void String::Flatten() const {
+    value_.assign(buffer_->data(), size_);
+    buffer_.reset();
+}
+
+size_t String::GetHash() const {
+    size_t hash = hash_.load(std::memory_order_relaxed);
+    if (hash == 0) {
+        hash = std::max<size_t>(std::hash<std::string_view>{}(View()), 1);
+        // строку могут одновременно хешировать несколько потоков; все запишут одно значение
+        hash_.store(hash, std::memory_order_relaxed);
+    }
+    return hash;
+}
+
+bool String::Equals(const String& other) const {
+    if (GetSize() != other.GetSize()) {
+        return false;
+    }
+    size_t hash = hash_.load(std::memory_order_relaxed);
+    size_t other_hash = other.hash_.load(std::memory_order_relaxed);
+    if (hash != 0 && other_hash != 0 && hash != other_hash) {
+        return false;
+    }
+    return View() == other.View();
 }
 
 bool IsTrue(const ObjectHolder &object) {
@@ -84,20 +260,20 @@ bool IsTrue(const ObjectHolder &object) {
         return !(obj->GetValue() == 0);
     }
     if (auto obj = object.TryAs<String>()) {
-        return !(obj->GetValue().empty());
+        return obj->GetSize() != 0;
     }
     return false;
 }
 
 void ClassInstance::Print(std::ostream &os, Context &context) {
-    if (HasMethod(STR_METHOD, 0U)) {
-        Call(STR_METHOD, {}, context)->Print(os, context);
+    if (auto mtd = cls_.GetMethod(STR_METHOD); mtd && mtd->formal_params.empty()) {
+        Call(*mtd, {}, context)->Print(os, context);
     } else {
         os << this;
     }
 }
 
-bool ClassInstance::HasMethod(const std::string &method, size_t argument_count) const {
+bool ClassInstance::HasMethod(Symbol method, size_t argument_count) const {
     if (auto mtd = cls_.GetMethod(method)) {
         if (mtd->formal_params.size() == argument_count) {
             return true;
@@ -106,61 +282,606 @@ bool ClassInstance::HasMethod(const std::string &method, size_t argument_count)
     return false;
 }
 
+ObjectHolder* ClassInstance::FindField(Symbol name) {
+    if (shape_ == nullptr) {
+        auto it = dictionary_->find(name);
+        return it != dictionary_->end() ? &it->second : nullptr;
+    }
+    auto index = shape_->FindField(name);
+    return index != Shape::NO_FIELD ? &values_[index] : nullptr;
+}
+
+ObjectHolder* ClassInstance::FindField(Symbol name, FieldCache& cache) {
+    if (auto entry = cache.Load(); shape_ != nullptr && shape_ == entry.shape
+                                   && entry.transition == nullptr) {
+        return &values_[entry.index];
+    }
+    if (shape_ == nullptr) {
+        return FindField(name);
+    }
+    auto index = shape_->FindField(name);
+    if (index == Shape::NO_FIELD) {
+        return nullptr;
+    }
+    cache.Store({shape_, nullptr, index});
+    return &values_[index];
+}
+
+void ClassInstance::SetField(Symbol name, ObjectHolder value) {
+    // поле может пережить метод, в котором self хранится невладеющей ссылкой
+    value.MakeOwning();
+    if (shape_ == nullptr) {
+        (*dictionary_)[name] = std::move(value);
+    } else if (auto index = shape_->FindField(name); index != Shape::NO_FIELD) {
+        values_[index] = std::move(value);
+    } else {
+        AppendField(shape_->AddField(name), std::move(value));
+    }
+}
+
+void ClassInstance::SetField(Symbol name, ObjectHolder value, FieldCache& cache) {
+    value.MakeOwning();
+    if (auto entry = cache.Load(); shape_ != nullptr && shape_ == entry.shape) {
+        if (entry.transition == nullptr) {
+            values_[entry.index] = std::move(value);
+        } else {
+            AppendField(entry.transition, std::move(value));
+        }
+        return;
+    }
+    if (shape_ == nullptr) {
+        (*dictionary_)[name] = std::move(value);
+        return;
+    }
+    if (auto index = shape_->FindField(name); index != Shape::NO_FIELD) {
+        cache.Store({shape_, nullptr, index});
+        values_[index] = std::move(value);
+    } else {
+        const Shape* next = shape_->AddField(name);
+        cache.Store({shape_, next, values_.size()});
+        AppendField(next, std::move(value));
+    }
+}
+
+void ClassInstance::AppendField(const Shape* shape, ObjectHolder value) {
+    if (values_.empty()) {
+        // память сразу выделяется под столько полей, сколько обычно бывает у объектов класса
+        values_.reserve(cls_.field_count_hint_.load(std::memory_order_relaxed));
+    }
+    shape_ = shape;
+    values_.push_back(std::move(value));
+    // подсказка лишь влияет на резервирование памяти, поэтому гонка при её обновлении безвредна
+    if (cls_.field_count_hint_.load(std::memory_order_relaxed) < values_.size()) {
+        cls_.field_count_hint_.store(values_.size(), std::memory_order_relaxed);
+    }
+}
+
+void ClassInstance::MakeDictionary() const {
+    if (shape_ == nullptr) {
+        return;
+    }
+    dictionary_ = std::make_unique<Closure>();
+    for (size_t i = 0; i < values_.size(); ++i) {
+        dictionary_->emplace(shape_->FieldName(i), std::move(values_[i]));
+    }
+    values_.clear();
+    values_.shrink_to_fit();
+    shape_ = nullptr;
+}
+
 Closure& ClassInstance::Fields() {
-    return closure_;
+    MakeDictionary();
+    return *dictionary_;
 }
 
 const Closure& ClassInstance::Fields() const {
-    return closure_;
+    MakeDictionary();
+    return *dictionary_;
 }
 
-ClassInstance::ClassInstance(const Class &cls) : cls_(cls) {
+const Class& ClassInstance::GetClass() const {
+    return cls_;
 }
 
-ObjectHolder ClassInstance::Call(const std::string &method,
-                                 const std::vector<ObjectHolder> &actual_args,
-                                 Context& context) {
-    if (!HasMethod(method, actual_args.size())) {
-        throw std::runtime_error("No method "s + method +" in class "s + cls_.GetName()
-                                 + " with "s + std::to_string(actual_args.size()) + " arguments."s);
+ClassInstance::ClassInstance(const Class &cls)
+    : Object(ObjectKind::Instance), cls_(cls), shape_(cls.GetRootShape()) {
+}
+
+ClassInstance::ClassInstance(ClassInstance&& other) noexcept
+    : Object(other), cls_(other.cls_), shape_(other.shape_), values_(std::move(other.values_))
+    , dictionary_(std::move(other.dictionary_)) {
+}
+
+void ClassInstance::ShareWithThreads() const {
+    if (IsSharedWithThreads()) {
+        return;
+    }
+    Object::ShareWithThreads();
+    // сборщик потока не может определить, какие ссылки на объект есть у других потоков
+    if (collector_ != nullptr) {
+        collector_->Untrack(*this);
     }
+    // поля становятся доступны тем же потокам, что и объект
+    for (const auto& value : values_) {
+        value.ShareWithThreads();
+    }
+    if (dictionary_) {
+        for (const auto& [name, value] : *dictionary_) {
+            value.ShareWithThreads();
+        }
+    }
+}
 
+ObjectHolder ClassInstance::Call(Symbol method, Arguments actual_args, Context& context) {
     auto mtd = cls_.GetMethod(method);
+    if (mtd == nullptr || mtd->formal_params.size() != actual_args.size()) {
+        throw std::runtime_error("No method "s + method.Name() + " in class "s + cls_.GetName()
+                                 + " with "s + std::to_string(actual_args.size()) + " arguments."s);
+    }
+    return Call(*mtd, actual_args, context);
+}
+
+ObjectHolder ClassInstance::Call(const Method& method, Arguments actual_args,
+                                 Context& context) {
+    if (StatCounters* counters = context.GetStatCounters(); counters != nullptr) {
+        counters->CountMethodCall();
+    }
+    // вход в метод - точка проверки бюджета и переключения между программами
+    if (Budget* budget = context.GetBudget(); budget != nullptr) {
+        Budget::CallScope scope(*budget);
+        return Dispatch(method, actual_args, context);
+    }
+    return Dispatch(method, actual_args, context);
+}
+
+ObjectHolder ClassInstance::Dispatch(const Method& method, Arguments actual_args,
+                                     Context& context) {
+    if (method.memo != nullptr) {
+        return CallMemoized(method, actual_args, context);
+    }
+    return CallProfiled(method, actual_args, context);
+}
+
+ObjectHolder ClassInstance::CallMemoized(const Method& method, Arguments actual_args,
+                                         Context& context) {
+    std::string key;
+    if (!MemoCache::MakeKey(actual_args.data(), actual_args.size(), key)) {
+        return CallProfiled(method, actual_args, context);
+    }
+    if (auto cached = method.memo->Find(key)) {
+        return std::move(*cached);
+    }
+    ObjectHolder result = CallProfiled(method, actual_args, context);
+    method.memo->Insert(std::move(key), result);
+    return result;
+}
+
+ObjectHolder ClassInstance::CallProfiled(const Method& method, Arguments actual_args,
+                                         Context& context) {
+    // без профилировщика вызов обходится одной проверкой указателя
+    if (Profiler* profiler = context.GetProfiler(); profiler != nullptr) {
+        Profiler::Scope scope(*profiler, cls_, method);
+        return Invoke(method, actual_args, context);
+    }
+    return Invoke(method, actual_args, context);
+}
+
+ObjectHolder ClassInstance::Invoke(const Method& method, Arguments actual_args,
+                                   Context& context) {
+    return OwningResult(CompleteTailCalls(Enter(method, actual_args, context), context));
+}
+
+ExecResult ClassInstance::Enter(const Method& method, Arguments actual_args, Context& context) {
+    if (method.locals_count > 0) {
+        // переменные метода получили номера при разборе: self, затем параметры
+        Frame frame(context, method.locals_count);
+        frame[0] = ObjectHolder::Share(*this);
+        for (size_t index = 0; index < actual_args.size(); ++index) {
+            frame[static_cast<Slot>(index + 1)] = actual_args.Take(index);
+        }
+        Closure unused;
+        return method.body->Run(unused, context);
+    }
+
     Closure args;
-    args["self"s] = ObjectHolder::Share(*this);
+    args[SELF] = ObjectHolder::Share(*this);
 
+    if (actual_args.size() < method.formal_params.size()) {
+        throw std::out_of_range("Not enough arguments for method "s + method.name.Name());
+    }
     size_t index = 0;
-    for (auto &param : mtd->formal_params) {
-        args[param] = actual_args.at(index++);
+    for (auto &param : method.formal_params) {
+        args[param] = actual_args.Take(index++);
     }
 
-    return mtd->body->Execute(args, context);
+    return method.body->Run(args, context);
 }
 
-Class::Class(std::string name, std::vector<Method> methods, const Class* parent)
-    : name_{std::move(name)}, methods_{std::move(methods)}, parent_{parent} {
+ObjectHolder ClassInstance::CompleteTailCalls(ExecResult result, Context& context) {
+    while (result.status == ExecStatus::TailCall) {
+        // кадр метода, отложившего вызов, уже освобождён; объект и аргументы вызова
+        // удерживаются владеющими ссылками
+        ObjectHolder object = std::move(result.value);
+        auto& call = context.GetTailCall();
+        if (StatCounters* counters = context.GetStatCounters(); counters != nullptr) {
+            counters->CountMethodCall();
+        }
+        // хвостовой вызов не увеличивает глубину, но остаётся точкой проверки бюджета
+        if (Budget* budget = context.GetBudget(); budget != nullptr) {
+            budget->Step();
+        }
+        result = object.TryAs<ClassInstance>()->Enter(
+            *call.method, Arguments::Move(call.args.data(), call.args.size()), context);
+    }
+    return std::move(result.value);
 }
 
-const Method* Class::GetMethod(const std::string &name) const {
-    auto find_by_name = [&name](const Method &mtd){
-        return mtd.name == name;
+/*
+ * Пул памяти для экземпляров одного класса. Выделяет блоки одинакового размера из страниц,
+ * размер которых удваивается с ростом пула, и повторно использует освобождённые блоки
+ * в порядке LIFO, так что недавно освобождённая память снова оказывается в кэше.
+ * Запросы другого размера передаются глобальному operator new.
+ * Экземпляры класса могут создаваться одновременно в нескольких потоках, поэтому пул
+ * защищён мьютексом
+ */
+class InstancePool {
+public:
+    InstancePool() = default;
+    InstancePool(const InstancePool&) = delete;
+    InstancePool& operator=(const InstancePool&) = delete;
+
+    void* Allocate(size_t size) {
+        std::lock_guard lock(mutex_);
+        if (block_size_ == 0) {
+            block_size_ = RoundUp(std::max(size, sizeof(FreeBlock)));
+        }
+        if (size > block_size_) {
+            return ::operator new(size);
+        }
+        if (free_ == nullptr) {
+            AddSlab();
+        }
+        FreeBlock* block = free_;
+        free_ = block->next;
+        return block;
+    }
+
+    void Deallocate(void* p, size_t size) {
+        std::lock_guard lock(mutex_);
+        if (size > block_size_) {
+            ::operator delete(p);
+            return;
+        }
+        auto* block = static_cast<FreeBlock*>(p);
+        block->next = free_;
+        free_ = block;
+    }
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
     };
-    // сначала ищем в списке методов самого класса
-    if(auto res = std::find_if(methods_.begin(), methods_.end(), find_by_name);
-            res != methods_.end()) {
-        return &(*res);
-    } else {
-        // если нет, то ищем у родителя (если он есть)
-        if (parent_ != nullptr) {
-            return parent_->GetMethod(name);
-        } else {
-            return nullptr;
+
+    static constexpr size_t FIRST_SLAB_BLOCKS = 16;
+    static constexpr size_t MAX_SLAB_BLOCKS = 4096;
+
+    static size_t RoundUp(size_t size) {
+        constexpr size_t alignment = alignof(std::max_align_t);
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    void AddSlab() {
+        size_t blocks = slabs_.empty() ? FIRST_SLAB_BLOCKS
+                                       : std::min(slab_blocks_ * 2, MAX_SLAB_BLOCKS);
+        slab_blocks_ = blocks;
+        auto& slab = slabs_.emplace_back(new std::byte[blocks * block_size_]);
+        // блоки выкладываются в список так, чтобы выдаваться в порядке возрастания адресов
+        for (size_t i = blocks; i > 0; --i) {
+            auto* block = reinterpret_cast<FreeBlock*>(slab.get() + (i - 1) * block_size_);
+            block->next = free_;
+            free_ = block;
+        }
+    }
+
+    std::mutex mutex_;
+    size_t block_size_ = 0;
+    size_t slab_blocks_ = 0;
+    FreeBlock* free_ = nullptr;
+    std::vector<std::unique_ptr<std::byte[]>> slabs_;
+};
+
+Class::Class(Symbol name, std::vector<Method> methods, const Class* parent,
+             std::shared_ptr<const void> storage)
+    : Object(ObjectKind::Class), name_{name}, storage_{std::move(storage)}
+    , methods_{std::move(methods)}, parent_{parent}, pool_{std::make_shared<InstancePool>()} {
+    if (parent_ != nullptr) {
+        method_table_ = parent_->method_table_;
+    }
+    // собственные методы класса перекрывают унаследованные
+    for (const auto& method : methods_) {
+        method_table_[method.name] = &method;
+    }
+}
+
+Class::Class(Class&& other) noexcept
+    : Object(ObjectKind::Class), name_{other.name_}, storage_{std::move(other.storage_)}
+    , methods_{std::move(other.methods_)}, parent_{other.parent_}
+    , root_shape_{std::move(other.root_shape_)}, method_table_{std::move(other.method_table_)}
+    , pool_{std::move(other.pool_)}
+    , field_count_hint_{other.field_count_hint_.load(std::memory_order_relaxed)} {
+}
+
+const Shape* Class::GetRootShape() const {
+    return root_shape_.get();
+}
+
+ObjectHolder Class::CreateInstance() const {
+    auto& collector = CycleCollector::ForCurrentThread();
+    collector.BeforeAllocation();
+    ++created_objects;
+    heap_bytes += static_cast<int64_t>(sizeof(ClassInstance));
+    void* memory = pool_->Allocate(sizeof(ClassInstance));
+    auto* instance = new (memory) ClassInstance(*this);
+    // экземпляр продлевает жизнь пула, чтобы вернуть в него память
+    instance->pool_ = pool_;
+    if (!instance->IsSharedWithThreads()) {
+        collector.Track(*instance);
+    }
+    return ObjectHolder(instance);
+}
+
+void ClassInstance::Dispose() noexcept {
+    ++destroyed_objects;
+    heap_bytes -= static_cast<int64_t>(sizeof(ClassInstance));
+    if (collector_ != nullptr) {
+        collector_->Untrack(*this);
+    }
+    if (!pool_) {
+        delete this;
+        return;
+    }
+    auto pool = std::move(pool_);
+    this->~ClassInstance();
+    pool->Deallocate(this, sizeof(ClassInstance));
+}
+
+const Method* Class::GetMethod(Symbol name) const {
+    auto it = method_table_.find(name);
+    return it != method_table_.end() ? it->second : nullptr;
+}
+
+const Method* MethodCache::Lookup(const Class& cls, Symbol name, size_t argument_count) {
+    const Method* method = cls.GetMethod(name);
+    if (method != nullptr && method->formal_params.size() != argument_count) {
+        method = nullptr;
+    }
+    // если классов больше, чем помещается в кэш, метод каждый раз ищется по имени
+    if (size_.load(std::memory_order_relaxed) < CAPACITY
+        && !writing_.test_and_set(std::memory_order_acquire)) {
+        size_t size = size_.load(std::memory_order_relaxed);
+        if (size < CAPACITY) {
+            entries_[size] = {&cls, method};
+            size_.store(size + 1, std::memory_order_release);
+        }
+        writing_.clear(std::memory_order_release);
+    }
+    return method;
+}
+
+MemoCache::MemoCache(size_t capacity)
+    : capacity_(std::max<size_t>(capacity, 1)) {
+}
+
+bool MemoCache::MakeKey(const ObjectHolder* args, size_t count, std::string& key) {
+    key.clear();
+    for (size_t i = 0; i < count; ++i) {
+        const ObjectHolder& arg = args[i];
+        switch (arg.GetKind()) {
+            case ObjectKind::None:
+                key += 'z';
+                break;
+            case ObjectKind::Bool:
+                key += arg.TryAs<Bool>()->GetValue() ? 't' : 'f';
+                break;
+            case ObjectKind::Number: {
+                int value = arg.TryAs<Number>()->GetValue();
+                key += 'n';
+                key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+                break;
+            }
+            case ObjectKind::String: {
+                auto value = arg.TryAs<String>()->View();
+                auto size = static_cast<uint32_t>(value.size());
+                key += 's';
+                key.append(reinterpret_cast<const char*>(&size), sizeof(size));
+                key += value;
+                break;
+            }
+            default:
+                return false;
         }
     }
+    return true;
+}
+
+std::optional<ObjectHolder> MemoCache::Find(const std::string& key) {
+    std::lock_guard lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        ++stats_.misses;
+        return std::nullopt;
+    }
+    ++stats_.hits;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->value;
+}
+
+void MemoCache::Insert(std::string key, const ObjectHolder& value) {
+    switch (value.GetKind()) {
+        case ObjectKind::None:
+        case ObjectKind::Bool:
+        case ObjectKind::Number:
+            break;
+        case ObjectKind::String:
+            // результат из кэша получат и другие потоки, выполняющие программу
+            if (!value->IsSharedWithThreads()) {
+                value.ShareWithThreads();
+            }
+            break;
+        default:
+            return;
+    }
+    std::lock_guard lock(mutex_);
+    // пока метод вычислялся, тот же результат мог запомнить другой поток
+    if (index_.count(key) > 0) {
+        return;
+    }
+    entries_.push_front({std::move(key), value});
+    index_.emplace(entries_.front().key, entries_.begin());
+    if (entries_.size() > capacity_) {
+        index_.erase(entries_.back().key);
+        entries_.pop_back();
+        ++stats_.evictions;
+    }
+}
+
+MemoCache::Stats MemoCache::GetStats() const {
+    std::lock_guard lock(mutex_);
+    Stats result = stats_;
+    result.size = entries_.size();
+    return result;
 }
 
 [[nodiscard]] const std::string& Class::GetName() const {
-    return name_;
+    return name_.Name();
+}
+
+const std::vector<Method>& Class::GetOwnMethods() const {
+    return methods_;
+}
+
+std::vector<Method>& Class::GetOwnMethods() {
+    return methods_;
+}
+
+const Class* Class::GetParent() const {
+    return parent_;
+}
+
+void WriteNumber(std::ostream& os, int value) {
+    char digits[16];
+    auto result = std::to_chars(std::begin(digits), std::end(digits), value);
+    os.write(digits, result.ptr - digits);
+}
+
+void PrintValue(const ObjectHolder& value, std::ostream& os, Context& context) {
+    switch (value.GetKind()) {
+        case ObjectKind::None:
+            os.write(EMPTY_OBJECT.data(), static_cast<std::streamsize>(EMPTY_OBJECT.size()));
+            break;
+        case ObjectKind::Number:
+            WriteNumber(os, value.TryAs<Number>()->GetValue());
+            break;
+        default:
+            value->Print(os, context);
+    }
+}
+
+std::string ToString(const ObjectHolder& value, Context& context) {
+    switch (value.GetKind()) {
+        case ObjectKind::None:
+            return EMPTY_OBJECT;
+        case ObjectKind::Number: {
+            char digits[16];
+            auto result = std::to_chars(std::begin(digits), std::end(digits),
+                                        value.TryAs<Number>()->GetValue());
+            return {digits, result.ptr};
+        }
+        case ObjectKind::String:
+            return std::string(value.TryAs<String>()->View());
+        case ObjectKind::Bool:
+            return value.TryAs<Bool>()->GetValue() ? "True"s : "False"s;
+        case ObjectKind::Instance: {
+            auto* instance = value.TryAs<ClassInstance>();
+            const Method* method = instance->GetClass().GetMethod(STR_METHOD);
+            if (method != nullptr && method->formal_params.empty()) {
+                return ToString(instance->Call(*method, {}, context), context);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    std::ostringstream os;
+    value->Print(os, context);
+    return os.str();
+}
+
+OutputBuffer::OutputBuffer(std::ostream& output, FlushPolicy policy, size_t threshold)
+    : output_(output), policy_(policy), buffer_(std::max<size_t>(threshold, 1)) {
+    setp(buffer_.data(), buffer_.data() + buffer_.size());
+}
+
+OutputBuffer::~OutputBuffer() {
+    Flush();
+}
+
+void OutputBuffer::Flush() {
+    if (pptr() != pbase()) {
+        output_.write(pbase(), pptr() - pbase());
+        flushed_ += pptr() - pbase();
+        setp(buffer_.data(), buffer_.data() + buffer_.size());
+    }
+    output_.flush();
+}
+
+OutputBuffer::int_type OutputBuffer::overflow(int_type ch) {
+    if (traits_type::eq_int_type(ch, traits_type::eof())) {
+        return traits_type::not_eof(ch);
+    }
+    char c = traits_type::to_char_type(ch);
+    xsputn(&c, 1);
+    return ch;
+}
+
+std::streamsize OutputBuffer::xsputn(const char* s, std::streamsize count) {
+    auto size = static_cast<size_t>(count);
+    if (static_cast<size_t>(epptr() - pptr()) < size) {
+        if (policy_ == FlushPolicy::OnExit) {
+            // буфер увеличивается так, чтобы в нём поместились новые символы
+            size_t used = pptr() - pbase();
+            buffer_.resize(std::max(buffer_.size() * 2, used + size));
+            setp(buffer_.data(), buffer_.data() + buffer_.size());
+            Advance(used);
+        } else {
+            output_.write(pbase(), pptr() - pbase());
+            flushed_ += pptr() - pbase();
+            setp(buffer_.data(), buffer_.data() + buffer_.size());
+            if (size >= buffer_.size()) {
+                // большой блок передаётся в поток назначения, минуя буфер
+                output_.write(s, count);
+                flushed_ += size;
+                return count;
+            }
+        }
+    }
+    std::memcpy(pptr(), s, size);
+    Advance(size);
+    return count;
+}
+
+void OutputBuffer::Advance(size_t count) {
+    // pbump принимает int, поэтому большие смещения выполняются по частям
+    constexpr auto max_step = static_cast<size_t>(std::numeric_limits<int>::max());
+    for (; count > max_step; count -= max_step) {
+        pbump(static_cast<int>(max_step));
+    }
+    pbump(static_cast<int>(count));
+}
+
+int OutputBuffer::sync() {
+    Flush();
+    return output_ ? 0 : -1;
 }
 
 void Class::Print(ostream& os, [[maybe_unused]] Context& context) {
@@ -172,28 +893,26 @@ void Bool::Print(std::ostream& os, [[maybe_unused]] Context& context) {
 }
 
 bool Equal(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context) {
-    try {
-        return Comp(lhs, rhs, std::equal_to());
-    }  catch (std::runtime_error&) {
-        if (auto l = lhs.TryAs<ClassInstance>()) {
-            return IsTrue(l->Call(EQ_METHOD, {rhs}, context));
-        }
-        if (!lhs && !rhs) {
-            return true;
-        }
-        throw;
+    if (auto result = Comp(lhs, rhs, std::equal_to())) {
+        return *result;
+    }
+    if (auto l = lhs.TryAs<ClassInstance>()) {
+        return IsTrue(l->Call(EQ_METHOD, {rhs}, context));
     }
+    if (!lhs && !rhs) {
+        return true;
+    }
+    throw std::runtime_error("Cannot compare objects"s);
 }
 
 bool Less(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context) {
-    try {
-        return Comp(lhs, rhs, std::less());
-    }  catch (std::runtime_error&) {
-        if (auto l = lhs.TryAs<ClassInstance>()) {
-            return IsTrue(l->Call(LESS_METHOD, {rhs}, context));
-        }
-        throw;
+    if (auto result = Comp(lhs, rhs, std::less())) {
+        return *result;
+    }
+    if (auto l = lhs.TryAs<ClassInstance>()) {
+        return IsTrue(l->Call(LESS_METHOD, {rhs}, context));
     }
+    throw std::runtime_error("Cannot compare objects"s);
 }
 
 bool NotEqual(const ObjectHolder &lhs, const ObjectHolder &rhs, Context &context) {
@@ -1,7 +1,10 @@
+#include "alloc_counter_p.h"
 #include "runtime.h"
 #include "test_runner_p.h"
 
 #include <functional>
+#include <limits>
+#include <thread>
 
 using namespace std;
 
@@ -71,6 +74,74 @@ void TestString() {
     ASSERT_EQUAL(word.GetValue(), "hello!"s);
 }
 
+void TestStringConcat() {
+    auto concat = [](const ObjectHolder& lhs, string_view rhs) {
+        return String::Concat(*lhs.TryAs<String>(), String(string(rhs)));
+    };
+
+    auto short_result = concat(ObjectHolder::Own(String("ab"s)), "cd"sv);
+    ASSERT_EQUAL(short_result.TryAs<String>()->GetValue(), "abcd"s);
+
+    // цепочка сложений дописывает слагаемые в общий буфер, не меняя предыдущие значения
+    const string piece = "0123456789"s;
+    string expected;
+    ObjectHolder value = ObjectHolder::Own(String(""s));
+    vector<ObjectHolder> prefixes;
+    for (int i = 0; i < 1000; ++i) {
+        value = concat(value, piece);
+        expected += piece;
+        if (i % 100 == 0) {
+            prefixes.push_back(value);
+        }
+    }
+    const auto& str = *value.TryAs<String>();
+    ASSERT_EQUAL(str.GetSize(), expected.size());
+    ASSERT_EQUAL(str.View(), string_view(expected));
+    for (size_t i = 0; i < prefixes.size(); ++i) {
+        ASSERT_EQUAL(prefixes[i].TryAs<String>()->GetValue(), expected.substr(0, (i * 100 + 1) * 10));
+    }
+
+    // строка в середине буфера копируется при сложении, не затирая продолжение
+    auto branch = concat(prefixes[0], "!"sv);
+    ASSERT_EQUAL(branch.TryAs<String>()->GetValue(), piece + "!"s);
+    ASSERT_EQUAL(prefixes[1].TryAs<String>()->View().substr(0, 11), "01234567890"sv);
+
+    // сложение строки с собой, когда обе ссылаются на один буфер
+    auto twice = String::Concat(str, str);
+    ASSERT_EQUAL(twice.TryAs<String>()->GetValue(), expected + expected);
+
+    DummyContext context;
+    value->Print(context.output, context);
+    ASSERT_EQUAL(context.output.str(), expected);
+    ASSERT_EQUAL(str.GetValue(), expected);
+    ASSERT_EQUAL(String(str).GetValue(), expected);
+
+    // строка, доступная нескольким потокам, хранит собственное значение
+    auto shared = concat(value, "?"sv);
+    shared.ShareWithThreads();
+    ASSERT_EQUAL(shared.TryAs<String>()->View(), string_view(expected + "?"s));
+}
+
+void TestStringHash() {
+    String a("some text"s);
+    String b("some text"s);
+    String c("some texT"s);
+    ASSERT_EQUAL(a.GetHash(), b.GetHash());
+    ASSERT_EQUAL(a.GetHash(), std::max<size_t>(std::hash<string_view>{}("some text"sv), 1));
+    ASSERT(a.Equals(b));
+    ASSERT(!a.Equals(c));
+    // хеш вычислен только у одной из строк
+    ASSERT(!c.Equals(String("some tex"s)));
+    ASSERT(c.Equals(String("some texT"s)));
+    ASSERT(String(""s).GetHash() != 0);
+
+    DummyContext context;
+    auto long_value = String::Concat(String(string(40, 'x')), String(string(40, 'y')));
+    ASSERT(Equal(long_value, ObjectHolder::Own(String(string(40, 'x') + string(40, 'y'))), context));
+    ASSERT(Greater(long_value, ObjectHolder::Own(String(string(41, 'x'))), context));
+    ASSERT(IsTrue(long_value));
+}
+
 void TestBool() {
     Bool t(true);
     ASSERT_EQUAL(t.GetValue(), true);
@@ -242,6 +313,156 @@ void TestMove() {
     }
 }
 
+void TestSharedWithThreads() {
+    ASSERT_EQUAL(Logger::instance_count, 0);
+    {
+        auto oh = ObjectHolder::Own(Logger(7));
+#ifndef MYTHON_ATOMIC_REFCOUNT
+        ASSERT(!oh->IsSharedWithThreads());
+#endif
+        oh.ShareWithThreads();
+        ASSERT(oh->IsSharedWithThreads());
+        // потоки одновременно копируют и уничтожают ссылки на один объект
+        vector<thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&oh] {
+                vector<ObjectHolder> copies;
+                for (int i = 0; i < 10000; ++i) {
+                    copies.push_back(oh);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        ASSERT_EQUAL(Logger::instance_count, 1);
+    }
+    ASSERT_EQUAL(Logger::instance_count, 0);
+
+    // у экземпляра класса помечаются и значения полей
+    Class cls{"Point"s, {}, nullptr};
+    auto instance = cls.CreateInstance();
+    instance.TryAs<ClassInstance>()->SetField("name"s, ObjectHolder::Own(String("p"s)));
+    instance.ShareWithThreads();
+    ASSERT(instance->IsSharedWithThreads());
+    ASSERT(instance.TryAs<ClassInstance>()->FindField("name"s)->Get()->IsSharedWithThreads());
+}
+
+void TestArgumentBuffer() {
+    vector<ObjectHolder> values;
+    for (int i = 0; i < 6; ++i) {
+        values.push_back(ObjectHolder::Own(String(to_string(i))));
+    }
+    {
+        alloc_counter::AllocationScope allocations;
+        ArgumentBuffer buffer;
+        for (size_t i = 0; i < ArgumentBuffer::INLINE_CAPACITY; ++i) {
+            buffer.push_back(values[i]);
+        }
+        size_t count = allocations.Count();
+        // аргументы помещаются во встроенный буфер без выделения памяти
+        ASSERT_EQUAL(count, 0U);
+
+        Arguments args = buffer;
+        ASSERT_EQUAL(args.size(), ArgumentBuffer::INLINE_CAPACITY);
+        ObjectHolder taken = args.Take(1);
+        ASSERT(taken.Get() == values[1].Get());
+        // аргумент буфера перемещён, а не скопирован
+        ASSERT(!buffer.data()[1]);
+    }
+    {
+        ArgumentBuffer buffer;
+        for (const auto& value : values) {
+            buffer.push_back(value);
+        }
+        ASSERT_EQUAL(buffer.size(), values.size());
+        for (size_t i = 0; i < values.size(); ++i) {
+            ASSERT(buffer.data()[i].Get() == values[i].Get());
+        }
+    }
+    // аргументы из вектора копируются, и вектор не изменяется
+    Arguments args = values;
+    ObjectHolder copy = args.Take(0);
+    ASSERT(copy.Get() == values[0].Get());
+    ASSERT(values[0]);
+}
+
+void TestUnboxedValues() {
+    alloc_counter::AllocationScope allocations;
+    auto number = ObjectHolder::Own(Number{42});
+    auto flag = ObjectHolder::Own(Bool{true});
+    ObjectHolder number_copy = number;
+    ObjectHolder flag_moved = std::move(flag);
+    size_t count = allocations.Count();
+    ASSERT_EQUAL(count, 0U);
+
+    ASSERT(!flag);  // NOLINT
+    ASSERT(number_copy.TryAs<Number>() != nullptr);
+    ASSERT_EQUAL(number_copy.TryAs<Number>()->GetValue(), 42);
+    ASSERT_EQUAL(number.TryAs<ValueObject<int>>(), number.TryAs<Number>());
+    ASSERT(number.TryAs<Object>() == number.Get());
+    ASSERT(number.TryAs<Bool>() == nullptr);
+    ASSERT(number.TryAs<String>() == nullptr);
+    ASSERT(flag_moved.TryAs<Bool>() != nullptr && flag_moved.TryAs<Bool>()->GetValue());
+    ASSERT(flag_moved.TryAs<Number>() == nullptr);
+
+    DummyContext context;
+    flag_moved->Print(context.output, context);
+    number->Print(context.output, context);
+    ASSERT_EQUAL(context.output.str(), "True42"s);
+
+    // присваивание значения другого вида и самому себе
+    number_copy = ObjectHolder::Own(String{"str"s});
+    ASSERT(number_copy.TryAs<Number>() == nullptr);
+    ASSERT_EQUAL(number_copy.TryAs<String>()->GetValue(), "str"s);
+    number_copy = number_copy;
+    ASSERT_EQUAL(number_copy.TryAs<String>()->GetValue(), "str"s);
+    number_copy = number;
+    ASSERT_EQUAL(number_copy.TryAs<Number>()->GetValue(), 42);
+    number_copy = ObjectHolder::None();
+    ASSERT(!number_copy);
+
+    // число, сохранённое по ссылке, распознаётся так же, как хранящееся внутри
+    Number shared{17};
+    auto shared_holder = ObjectHolder::Share(shared);
+    ASSERT(shared_holder.TryAs<Number>() == &shared);
+}
+
+void TestObjectKinds() {
+    Class cls{"Test"s, {}, nullptr};
+    ClassInstance instance{cls};
+    String str{"text"s};
+    Logger logger;
+
+    ASSERT(ObjectHolder::None().GetKind() == ObjectKind::None);
+    ASSERT(ObjectHolder::Own(Number{1}).GetKind() == ObjectKind::Number);
+    ASSERT(ObjectHolder::Own(Bool{false}).GetKind() == ObjectKind::Bool);
+    ASSERT(ObjectHolder::Share(str).GetKind() == ObjectKind::String);
+    ASSERT(ObjectHolder::Share(cls).GetKind() == ObjectKind::Class);
+    ASSERT(ObjectHolder::Share(instance).GetKind() == ObjectKind::Instance);
+    ASSERT(ObjectHolder::Share(logger).GetKind() == ObjectKind::Other);
+
+    auto holder = ObjectHolder::Share(instance);
+    ASSERT(holder.TryAs<ClassInstance>() == &instance);
+    ASSERT(holder.TryAs<const ClassInstance>() == &instance);
+    ASSERT(holder.TryAs<Class>() == nullptr);
+    ASSERT(holder.TryAs<String>() == nullptr);
+    ASSERT(holder.TryAs<Object>() == &instance);
+    ASSERT(ObjectHolder::Share(cls).TryAs<Class>() == &cls);
+    ASSERT(ObjectHolder::Share(str).TryAs<const String>() == &str);
+    ASSERT(ObjectHolder::Share(logger).TryAs<Logger>() == &logger);
+    ASSERT(ObjectHolder::Share(logger).TryAs<ClassInstance>() == nullptr);
+
+    // значения разных видов не сравниваются
+    DummyContext context;
+    ASSERT_THROWS(Equal(ObjectHolder::Own(Number{1}), ObjectHolder::Own(Bool{true}), context),
+                  runtime_error);
+    ASSERT_THROWS(Less(ObjectHolder::None(), ObjectHolder::None(), context), runtime_error);
+    ASSERT_THROWS(Equal(ObjectHolder::Share(cls), ObjectHolder::Share(cls), context),
+                  runtime_error);
+    ASSERT(Equal(ObjectHolder::None(), ObjectHolder::None(), context));
+}
+
 void TestNullptr() {
     ObjectHolder oh;
     ASSERT(!oh);
@@ -529,24 +750,275 @@ void TestClassInstance() {
     ASSERT_THROWS(instance.Call("missing_method"s, {}, ctx), runtime_error);
 }
 
+void TestCreateInstance() {
+    Class cls{"Point"s, {}, nullptr};
+    Object* first = nullptr;
+    {
+        ObjectHolder a = cls.CreateInstance();
+        ObjectHolder b = cls.CreateInstance();
+        ASSERT(a.Get() != b.Get());
+        ASSERT(&a.TryAs<ClassInstance>()->GetClass() == &cls);
+        first = a.Get();
+    }
+    // освобождённая память экземпляров используется повторно
+    ObjectHolder c = cls.CreateInstance();
+    ObjectHolder d = cls.CreateInstance();
+    ASSERT(c.Get() == first || d.Get() == first);
+
+    vector<ObjectHolder> many;
+    for (int i = 0; i < 10000; ++i) {
+        many.push_back(cls.CreateInstance());
+        many.back().TryAs<ClassInstance>()->SetField("i"s, ObjectHolder::Own(Number{i}));
+    }
+    for (int i = 0; i < 10000; ++i) {
+        ASSERT_EQUAL(many[i].TryAs<ClassInstance>()->FindField("i"s)->TryAs<Number>()->GetValue(),
+                     i);
+    }
+}
+
+void TestMemoCache() {
+    auto key_of = [](initializer_list<ObjectHolder> args) {
+        string key;
+        ASSERT(MemoCache::MakeKey(args.begin(), args.size(), key));
+        return key;
+    };
+    // ключ различает типы и границы строк
+    ASSERT(key_of({MakeNumber(1)}) != key_of({MakeBool(true)}));
+    ASSERT(key_of({ObjectHolder::Own(String("ab"s)), ObjectHolder::Own(String("c"s))})
+           != key_of({ObjectHolder::Own(String("a"s)), ObjectHolder::Own(String("bc"s))}));
+    ASSERT_EQUAL(key_of({ObjectHolder::None(), MakeNumber(7)}),
+                 key_of({ObjectHolder::None(), MakeNumber(7)}));
+
+    Class cls{"Test"s, {}, nullptr};
+    ObjectHolder instance = cls.CreateInstance();
+    string key;
+    ASSERT(!MemoCache::MakeKey(&instance, 1, key));
+
+    MemoCache cache(2);
+    ASSERT(!cache.Find(key_of({MakeNumber(1)})));
+    cache.Insert(key_of({MakeNumber(1)}), MakeNumber(10));
+    cache.Insert(key_of({MakeNumber(2)}), ObjectHolder::Own(String("twenty"s)));
+    // экземпляры классов не запоминаются
+    cache.Insert(key_of({MakeNumber(3)}), instance);
+    ASSERT_EQUAL(cache.Find(key_of({MakeNumber(1)}))->TryAs<Number>()->GetValue(), 10);
+    // вытесняется запись, к которой дольше всего не обращались
+    cache.Insert(key_of({MakeNumber(4)}), MakeNumber(40));
+    ASSERT(!cache.Find(key_of({MakeNumber(2)})));
+    ASSERT(cache.Find(key_of({MakeNumber(1)})));
+    ASSERT(cache.Find(key_of({MakeNumber(4)})));
+
+    auto stats = cache.GetStats();
+    ASSERT_EQUAL(stats.hits, 3U);
+    ASSERT_EQUAL(stats.misses, 2U);
+    ASSERT_EQUAL(stats.evictions, 1U);
+    ASSERT_EQUAL(stats.size, 2U);
+}
+
+void TestMethodCache() {
+    auto make_method = [](string name, vector<Symbol> params) {
+        return Method{move(name), move(params), nullptr};
+    };
+    vector<Method> base_methods;
+    base_methods.push_back(make_method("f"s, {}));
+    base_methods.push_back(make_method("g"s, {"x"s}));
+    Class base{"Base"s, move(base_methods), nullptr};
+
+    vector<Method> middle_methods;
+    middle_methods.push_back(make_method("g"s, {"x"s}));
+    Class middle{"Middle"s, move(middle_methods), &base};
+
+    vector<Method> derived_methods;
+    derived_methods.push_back(make_method("h"s, {}));
+    Class derived{"Derived"s, move(derived_methods), &middle};
+
+    // таблица методов включает унаследованные и учитывает переопределение
+    ASSERT_EQUAL(derived.GetMethod("f"s), base.GetMethod("f"s));
+    ASSERT_EQUAL(derived.GetMethod("g"s), middle.GetMethod("g"s));
+    ASSERT(middle.GetMethod("g"s) != base.GetMethod("g"s));
+    ASSERT_EQUAL(base.GetMethod("h"s), nullptr);
+
+    vector<unique_ptr<Class>> others;
+    for (int i = 0; i < 2 * static_cast<int>(MethodCache::CAPACITY); ++i) {
+        others.push_back(make_unique<Class>("Other"s + to_string(i), vector<Method>{}, &middle));
+    }
+
+    MethodCache cache;
+    for (int round = 0; round < 2; ++round) {
+        ASSERT_EQUAL(cache.Find(base, "g"s, 1), base.GetMethod("g"s));
+        ASSERT_EQUAL(cache.Find(derived, "g"s, 1), middle.GetMethod("g"s));
+        for (const auto& other : others) {
+            ASSERT_EQUAL(cache.Find(*other, "g"s, 1), middle.GetMethod("g"s));
+        }
+        ASSERT_EQUAL(cache.Find(middle, "g"s, 1), middle.GetMethod("g"s));
+    }
+
+    MethodCache wrong_arity;
+    ASSERT_EQUAL(wrong_arity.Find(base, "g"s, 2), nullptr);
+    ASSERT_EQUAL(wrong_arity.Find(base, "g"s, 2), nullptr);
+}
+
+void TestShapes() {
+    Class cls{"Point"s, {}, nullptr};
+    ClassInstance a{cls};
+    ClassInstance b{cls};
+    ClassInstance c{cls};
+    ASSERT_EQUAL(a.GetShape(), cls.GetRootShape());
+
+    a.SetField("x"s, ObjectHolder::Own(Number{1}));
+    a.SetField("y"s, ObjectHolder::Own(Number{2}));
+    FieldCache store_cache;
+    b.SetField("x"s, ObjectHolder::Own(Number{3}), store_cache);
+    b.SetField("y"s, ObjectHolder::Own(Number{4}));
+    c.SetField("y"s, ObjectHolder::Own(Number{5}));
+    c.SetField("x"s, ObjectHolder::Own(Number{6}), store_cache);
+
+    // одинаковый порядок добавления полей - общая форма
+    ASSERT_EQUAL(a.GetShape(), b.GetShape());
+    ASSERT(a.GetShape() != c.GetShape());
+    ASSERT_EQUAL(a.GetShape()->FieldCount(), 2U);
+    ASSERT_EQUAL(a.GetShape()->FindField("y"s), 1U);
+    ASSERT_EQUAL(c.GetShape()->FindField("y"s), 0U);
+    ASSERT_EQUAL(a.GetShape()->FindField("z"s), Shape::NO_FIELD);
+
+    FieldCache load_cache;
+    for (auto* instance : {&a, &b, &c, &a}) {
+        ASSERT(instance->FindField("y"s, load_cache) == instance->FindField("y"s));
+    }
+    FieldCache x_cache;
+    ASSERT_EQUAL(b.FindField("x"s, x_cache)->TryAs<Number>()->GetValue(), 3);
+    ASSERT_EQUAL(c.FindField("x"s, x_cache)->TryAs<Number>()->GetValue(), 6);
+    FieldCache z_cache;
+    ASSERT(a.FindField("z"s, z_cache) == nullptr);
+
+    // словарь полей содержит те же значения и продолжает использоваться после перехода
+    Closure& fields = a.Fields();
+    ASSERT(a.GetShape() == nullptr);
+    ASSERT_EQUAL(fields.size(), 2U);
+    ASSERT_EQUAL(fields.at("y"s).TryAs<Number>()->GetValue(), 2);
+    a.SetField("z"s, ObjectHolder::Own(Number{7}), z_cache);
+    ASSERT_EQUAL(fields.at("z"s).TryAs<Number>()->GetValue(), 7);
+    fields["x"s] = ObjectHolder::Own(Number{8});
+    ASSERT_EQUAL(a.FindField("x"s, x_cache)->TryAs<Number>()->GetValue(), 8);
+    ASSERT_EQUAL(b.FindField("x"s, x_cache)->TryAs<Number>()->GetValue(), 3);
+}
+
+void TestSymbols() {
+    const Symbol x{"x"sv};
+    ASSERT_EQUAL(x, Symbol("x"s));
+    ASSERT_EQUAL(x.Id(), Symbol("x").Id());
+    ASSERT(x != Symbol("y"s));
+    ASSERT_EQUAL(x.Name(), "x"s);
+    ASSERT_EQUAL(Symbol().Name(), ""s);
+    ASSERT_EQUAL(Symbol(), Symbol(""s));
+    ASSERT(Symbol("abc"s) < Symbol("abd"s) && !(Symbol("abd"s) < Symbol("abc"s)));
+    ASSERT(!(x < x));
+
+    // символ создаётся из имени неявно, поэтому Closure доступен по строковым ключам
+    Closure closure;
+    closure["x"s] = ObjectHolder::Own(Number{1});
+    ASSERT_EQUAL(closure.count(x), 1U);
+    ASSERT_EQUAL(closure.at("x"s).Get(), closure.at(x).Get());
+
+    std::ostringstream out;
+    out << x;
+    ASSERT_EQUAL(out.str(), "x"s);
+}
+
+void TestOutputBuffer() {
+    {
+        std::ostringstream out;
+        {
+            OutputBuffer buffer(out, FlushPolicy::Threshold, 8U);
+            std::ostream os(&buffer);
+            os << "abc"sv;
+            ASSERT(out.str().empty());
+            os << "defgh"sv;
+            ASSERT(out.str().empty());
+            // символ, не поместившийся в буфер, вытесняет накопленное содержимое
+            os.put('i');
+            ASSERT_EQUAL(out.str(), "abcdefgh"s);
+            // блок не меньше буфера передаётся напрямую
+            os << "0123456789"sv;
+            ASSERT_EQUAL(out.str(), "abcdefghi0123456789"s);
+            os << 'x';
+        }
+        ASSERT_EQUAL(out.str(), "abcdefghi0123456789x"s);
+    }
+    {
+        std::ostringstream out;
+        OutputBuffer buffer(out, FlushPolicy::Line);
+        std::ostream os(&buffer);
+        os << "line\n"sv;
+        ASSERT(out.str().empty());
+        buffer.EndLine();
+        ASSERT_EQUAL(out.str(), "line\n"s);
+        os << "tail"sv;
+        os.flush();
+        ASSERT_EQUAL(out.str(), "line\ntail"s);
+    }
+    {
+        std::ostringstream out;
+        {
+            OutputBuffer buffer(out, FlushPolicy::OnExit, 4U);
+            std::ostream os(&buffer);
+            os << "0123456789"sv;
+            buffer.EndLine();
+            os << 'a';
+            ASSERT(out.str().empty());
+        }
+        ASSERT_EQUAL(out.str(), "0123456789a"s);
+    }
+}
+
+void TestToString() {
+    DummyContext context;
+    ASSERT_EQUAL(ToString(ObjectHolder::None(), context), "None"s);
+    ASSERT_EQUAL(ToString(ObjectHolder::Own(Number{-1234567}), context), "-1234567"s);
+    ASSERT_EQUAL(ToString(ObjectHolder::Own(Number{0}), context), "0"s);
+    ASSERT_EQUAL(ToString(ObjectHolder::Own(String{"text"s}), context), "text"s);
+    ASSERT_EQUAL(ToString(ObjectHolder::Own(Bool{true}), context), "True"s);
+
+    PrintValue(ObjectHolder::Own(Number{42}), context.output, context);
+    context.output.put(' ');
+    PrintValue(ObjectHolder::None(), context.output, context);
+    ASSERT_EQUAL(context.output.str(), "42 None"s);
+
+    std::ostringstream out;
+    WriteNumber(out, std::numeric_limits<int>::min());
+    ASSERT_EQUAL(out.str(), std::to_string(std::numeric_limits<int>::min()));
+}
+
 }  // namespace
 
 void RunObjectsTests(TestRunner& tr) {
     RUN_TEST(tr, runtime::TestNumber);
     RUN_TEST(tr, runtime::TestString);
+    RUN_TEST(tr, runtime::TestStringConcat);
+    RUN_TEST(tr, runtime::TestStringHash);
     RUN_TEST(tr, runtime::TestBool);
     RUN_TEST(tr, runtime::TestMethodInvocation);
     RUN_TEST(tr, runtime::TestIsTrue);
     RUN_TEST(tr, runtime::TestComparison);
     RUN_TEST(tr, runtime::TestClass);
     RUN_TEST(tr, runtime::TestClassInstance);
+    RUN_TEST(tr, runtime::TestCreateInstance);
+    RUN_TEST(tr, runtime::TestMethodCache);
+    RUN_TEST(tr, runtime::TestMemoCache);
+    RUN_TEST(tr, runtime::TestShapes);
+    RUN_TEST(tr, runtime::TestSymbols);
+    RUN_TEST(tr, runtime::TestOutputBuffer);
+    RUN_TEST(tr, runtime::TestToString);
 }
 
 void RunObjectHolderTests(TestRunner& tr) {
     RUN_TEST(tr, runtime::TestNonowning);
     RUN_TEST(tr, runtime::TestOwning);
     RUN_TEST(tr, runtime::TestMove);
+    RUN_TEST(tr, runtime::TestSharedWithThreads);
+    RUN_TEST(tr, runtime::TestArgumentBuffer);
     RUN_TEST(tr, runtime::TestNullptr);
+    RUN_TEST(tr, runtime::TestUnboxedValues);
+    RUN_TEST(tr, runtime::TestObjectKinds);
 }
 
 }  // namespace runtime
\ No newline at end of file
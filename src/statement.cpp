@@ -1,5 +1,7 @@
 #include "statement.h"
 
+#include "budget.h"
+
 #include <algorithm>
 #include <iostream>
 #include <iterator>
@@ -14,49 +16,160 @@ using runtime::Context;
 using runtime::ObjectHolder;
 
 namespace {
-const string ADD_METHOD = "__add__"s;
-const string INIT_METHOD = "__init__"s;
-const string EMPTY_OBJECT = "None"s;
+const runtime::Symbol ADD_METHOD{"__add__"sv};
+const runtime::Symbol INIT_METHOD{"__init__"sv};
+
+ObjectHolder MakeValue(int value) {
+    return runtime::MakeNumber(value);
+}
+
+void CountClosureLookup(Context& context) {
+    if (auto* counters = context.GetStatCounters()) {
+        counters->Add(runtime::StatCounters::CLOSURE_LOOKUPS);
+    }
+}
 }  // namespace
 
+void* Arena::Allocate(size_t size) {
+    constexpr size_t alignment = alignof(std::max_align_t);
+    size = (size + alignment - 1) / alignment * alignment;
+    if (size > left_) {
+        size_t block_size = std::max(size, BLOCK_SIZE);
+        current_ = blocks_.emplace_back(new std::byte[block_size]).get();
+        left_ = block_size;
+    }
+    void* result = current_;
+    current_ += size;
+    left_ -= size;
+    bytes_used_ += size;
+    return result;
+}
+
+void Arena::Merge(Arena& other) {
+    blocks_.insert(blocks_.end(), std::make_move_iterator(other.blocks_.begin()),
+                   std::make_move_iterator(other.blocks_.end()));
+    bytes_used_ += other.bytes_used_;
+    other.blocks_.clear();
+    other.current_ = nullptr;
+    other.left_ = 0;
+    other.bytes_used_ = 0;
+}
+
+namespace {
+// Заголовок, предшествующий памяти каждого узла. Для узлов в куче arena равен nullptr
+struct alignas(std::max_align_t) NodeHeader {
+    Arena* arena;
+};
+
+void* PlaceNode(void* memory, Arena* arena) {
+    auto* header = new (memory) NodeHeader{arena};
+    return header + 1;
+}
+}  // namespace
+
+void* Statement::operator new(size_t size) {
+    return PlaceNode(::operator new(sizeof(NodeHeader) + size), nullptr);
+}
+
+void* Statement::operator new(size_t size, Arena& arena) {
+    return PlaceNode(arena.Allocate(sizeof(NodeHeader) + size), &arena);
+}
+
+void Statement::operator delete(void* p) noexcept {
+    if (p == nullptr) {
+        return;
+    }
+    auto* header = static_cast<NodeHeader*>(p) - 1;
+    if (header->arena == nullptr) {
+        ::operator delete(header);
+    }
+}
+
+void Statement::operator delete(void* /*p*/, Arena& /*arena*/) noexcept {
+}
+
+Program::Program(std::shared_ptr<Arena> arena, std::unique_ptr<Statement> root)
+    : arena_{std::move(arena)}, root_{std::move(root)} {
+}
+
+ObjectHolder Program::Execute(Closure &closure, Context &context) {
+    return root_->Execute(closure, context);
+}
+
+runtime::ExecResult Program::Run(Closure &closure, Context &context) {
+    return root_->Run(closure, context);
+}
+
 ObjectHolder Assignment::Execute(Closure &closure, Context &context) {
-    closure[var_] = rv_->Execute(closure, context);
-    return closure.at(var_);
+    ObjectHolder value = rv_->Execute(closure, context);
+    if (slot_ != runtime::NO_SLOT) {
+        context.Local(slot_) = value;
+    } else {
+        CountClosureLookup(context);
+        // переменная Closure может пережить инструкцию, которой принадлежит константа,
+        // например в потоковом режиме, где инструкция уничтожается сразу после выполнения
+        value.MakeOwning();
+        closure[var_] = value;
+    }
+    return value;
 }
 
-Assignment::Assignment(std::string var, std::unique_ptr<Statement> rv)
-    : var_{std::move(var)}, rv_{std::move(rv)} {
+Assignment::Assignment(runtime::Symbol var, std::unique_ptr<Statement> rv, runtime::Slot slot)
+    : var_{var}, rv_{std::move(rv)}, slot_{slot} {
 }
 
-VariableValue::VariableValue(const std::string& var_name)
-    : var_name_{var_name} {
+VariableValue::VariableValue(runtime::Symbol var_name, runtime::Slot slot)
+    : var_name_{var_name}, slot_{slot} {
 }
 
-VariableValue::VariableValue(std::vector<std::string> dotted_ids) {
+VariableValue::VariableValue(std::vector<runtime::Symbol> dotted_ids, runtime::Slot slot)
+    : slot_{slot} {
     if (auto size = dotted_ids.size(); size > 0) {
-        var_name_ = std::move(dotted_ids.at(0));
-        tail_.resize(size - 1);
-        std::move(std::next(dotted_ids.begin()), dotted_ids.end(), tail_.begin());
+        var_name_ = dotted_ids.at(0);
+        tail_.assign(std::next(dotted_ids.begin()), dotted_ids.end());
+        field_caches_.resize(size - 1);
     }
 }
 
+VariableValue::VariableValue(const std::vector<std::string>& dotted_ids, runtime::Slot slot)
+    : VariableValue(std::vector<runtime::Symbol>(dotted_ids.begin(), dotted_ids.end()), slot) {
+}
+
 ObjectHolder VariableValue::Execute(Closure &closure, Context &context) {
-    if (closure.count(var_name_)) {
-        auto result = closure.at(var_name_);
-        if (tail_.size() > 0) {
-            if (auto obj = result.TryAs<runtime::ClassInstance>()) {
-                return VariableValue(tail_).Execute(obj->Fields(), context);
-            } else {
-                throw std::runtime_error("Variable " + var_name_+ " is not class"s);
-            }
+    ObjectHolder result;
+    if (slot_ != runtime::NO_SLOT) {
+        result = context.Local(slot_);
+        if (runtime::IsUndefined(result)) {
+            throw std::runtime_error("Variable "s + var_name_.Name() + " not found"s);
         }
-        return result;
     } else {
-        throw std::runtime_error("Variable "s + var_name_ + " not found"s);
+        CountClosureLookup(context);
+        auto it = closure.find(var_name_);
+        if (it == closure.end()) {
+            throw std::runtime_error("Variable "s + var_name_.Name() + " not found"s);
+        }
+        result = it->second;
+    }
+
+    runtime::Symbol owner = var_name_;
+    for (size_t i = 0; i < tail_.size(); ++i) {
+        auto obj = result.TryAs<runtime::ClassInstance>();
+        if (!obj) {
+            throw std::runtime_error("Variable " + owner.Name() + " is not class"s);
+        }
+        auto* field = obj->FindField(tail_[i], field_caches_[i]);
+        if (field == nullptr) {
+            throw std::runtime_error("Variable "s + tail_[i].Name() + " not found"s);
+        }
+        // значение копируется до того, как result перестанет владеть объектом
+        ObjectHolder value = *field;
+        result = std::move(value);
+        owner = tail_[i];
     }
+    return result;
 }
 
-unique_ptr<Print> Print::Variable(const std::string &name) {
+unique_ptr<Print> Print::Variable(runtime::Symbol name) {
     return std::make_unique<Print>(std::make_unique<VariableValue>(name));
 }
 
@@ -73,55 +186,89 @@ ObjectHolder Print::Execute(Closure &closure, Context &context) {
     auto &os = context.GetOutputStream();
     for (auto &arg : args_) {
         if (!first) {
-            os << " "s;
-        }
-        auto obj = arg->Execute(closure, context);
-        if (obj) {
-            obj->Print(os, context);
-        } else {
-            os << EMPTY_OBJECT;
+            os.put(' ');
         }
+        runtime::PrintValue(arg->Execute(closure, context), os, context);
         first = false;
     }
-    os << "\n"s;
+    os.put('\n');
+    context.CountOutput();
+    if (auto* buffer = context.GetOutputBuffer()) {
+        buffer->EndLine();
+    }
     return {};
 }
 
-MethodCall::MethodCall(std::unique_ptr<Statement> object, std::string method,
+MethodCall::MethodCall(std::unique_ptr<Statement> object, runtime::Symbol method,
                        std::vector<std::unique_ptr<Statement>> args)
-    : object_{std::move(object)}, method_{std::move(method)}, args_{std::move(args)} {
+    : object_{std::move(object)}, method_{method}, args_{std::move(args)} {
 }
 
 ObjectHolder MethodCall::Execute(Closure &closure, Context &context) {
-
-    if (auto class_instance =
-        object_->Execute(closure, context).TryAs<runtime::ClassInstance>()) {
-        std::vector<runtime::ObjectHolder> actual_args;
+    ObjectHolder object = object_->Execute(closure, context);
+    if (auto class_instance = object.TryAs<runtime::ClassInstance>()) {
+        runtime::ArgumentBuffer actual_args;
         for (auto &arg : args_) {
             actual_args.push_back(arg->Execute(closure, context));
         }
+        if (auto mtd = cache_.Find(class_instance->GetClass(), method_, actual_args.size())) {
+            return class_instance->Call(*mtd, actual_args, context);
+        }
+        // метода нет - сообщение об ошибке формирует ClassInstance::Call
         return class_instance->Call(method_, actual_args, context);
     } else {
         throw std::runtime_error("Object is not class instance"s);
     }
 }
 
+runtime::ExecResult MethodCall::RunTailCall(Closure &closure, Context &context) {
+    ObjectHolder object = object_->Execute(closure, context);
+    auto class_instance = object.TryAs<runtime::ClassInstance>();
+    if (class_instance == nullptr) {
+        throw std::runtime_error("Object is not class instance"s);
+    }
+    // аргументы могут вызывать методы, которые сами откладывают вызовы, поэтому
+    // в отложенный вызов они переносятся только после вычисления
+    runtime::ArgumentBuffer actual_args;
+    for (auto &arg : args_) {
+        actual_args.push_back(arg->Execute(closure, context));
+    }
+    const runtime::Method* mtd = cache_.Find(class_instance->GetClass(), method_,
+                                             actual_args.size());
+    if (mtd == nullptr || mtd->memo != nullptr) {
+        // результат метода с @memoize запоминается при возврате из вызова
+        ObjectHolder result = mtd != nullptr ? class_instance->Call(*mtd, actual_args, context)
+                                             : class_instance->Call(method_, actual_args, context);
+        return {std::move(result), runtime::ExecStatus::Return};
+    }
+    // кадр текущего метода будет освобождён до вызова
+    object.MakeOwning();
+    auto &call = context.GetTailCall();
+    call.method = mtd;
+    call.args.clear();
+    for (size_t index = 0; index < actual_args.size(); ++index) {
+        ObjectHolder &arg = actual_args.data()[index];
+        arg.MakeOwning();
+        call.args.push_back(std::move(arg));
+    }
+    return {std::move(object), runtime::ExecStatus::TailCall};
+}
+
 ObjectHolder Stringify::Execute(Closure &closure, Context &context) {
-    auto obj = argument_->Execute(closure, context);
-    if (obj) {
-        std::ostringstream os;
-        obj->Print(os, context);
-        return ObjectHolder::Own(runtime::String(os.str()));
-    } else {
-        return ObjectHolder::Own(runtime::String(EMPTY_OBJECT));
+    ObjectHolder value = argument_->Execute(closure, context);
+    // строки неизменяемы, поэтому str от строки возвращает её саму
+    if (value.TryAs<runtime::String>() != nullptr) {
+        value.MakeOwning();
+        return value;
     }
+    return ObjectHolder::Own(runtime::String(runtime::ToString(value, context)));
 }
 
 #define BINARY_OPERATION(type, operation) {                                        \
     auto l = left_holder.TryAs<type>();                                            \
     auto r = right_holder.TryAs<type>();                                           \
     if (l && r) {                                                                  \
-        return ObjectHolder::Own(type(l->GetValue() operation r->GetValue()));     \
+        return MakeValue(l->GetValue() operation r->GetValue());                   \
     }                                                                              \
 }
 
@@ -130,11 +277,20 @@ ObjectHolder Add::Execute(Closure &closure, Context &context)
     ObjectHolder left_holder = lhs_->Execute(closure, context);
     ObjectHolder right_holder = rhs_->Execute(closure, context);
     BINARY_OPERATION(runtime::Number, +);
-    BINARY_OPERATION(runtime::String, +);
+    auto ls = left_holder.TryAs<runtime::String>();
+    auto rs = right_holder.TryAs<runtime::String>();
+    if (ls && rs) {
+        ObjectHolder result = runtime::String::Concat(*ls, *rs);
+        // сложения могут удваивать длину строки, поэтому память проверяется сразу
+        if (auto* budget = context.GetBudget(); budget != nullptr) {
+            budget->CheckHeap();
+        }
+        return result;
+    }
     if (auto left_class = left_holder.TryAs<runtime::ClassInstance>()) {
-        return left_class->Call(ADD_METHOD, {right_holder}, context);
+        return left_class->Call(ADD_METHOD, runtime::Arguments::Move(&right_holder, 1), context);
     }
-    throw std::runtime_error("Can add only numbers, strings and class instances with "s + ADD_METHOD);
+    throw std::runtime_error("Can add only numbers, strings and class instances with "s + ADD_METHOD.Name());
 }
 
 ObjectHolder Sub::Execute(Closure &closure, Context &context)
@@ -168,34 +324,71 @@ ObjectHolder Div::Execute(Closure &closure, Context &context)
 #undef BINARY_OPERATION
 
 ObjectHolder Compound::Execute(Closure &closure, Context &context) {
+    runtime::ClassInstance::CompleteTailCalls(Run(closure, context), context);
+    return ObjectHolder::None();
+}
+
+runtime::ExecResult Compound::Run(Closure &closure, Context &context) {
+    auto* counters = context.GetStatCounters();
+    auto* budget = context.GetBudget();
     for (auto &arg : args_) {
-        arg->Execute(closure, context);
+        if (counters != nullptr) {
+            counters->CountStatement();
+        }
+        if (budget != nullptr) {
+            budget->Step();
+        }
+        if (auto result = arg->Run(closure, context);
+                result.status != runtime::ExecStatus::Normal) {
+            return result;
+        }
     }
-    return ObjectHolder::None();
+    return {};
 }
 
 ObjectHolder Return::Execute(Closure &closure, Context &context) {
-    throw statement_->Execute(closure, context);
+    return statement_->Execute(closure, context);
+}
+
+runtime::ExecResult Return::Run(Closure &closure, Context &context) {
+    if (tail_call_ != nullptr && context.GetProfiler() == nullptr) {
+        return tail_call_->RunTailCall(closure, context);
+    }
+    return {statement_->Execute(closure, context), runtime::ExecStatus::Return};
 }
 
-ClassDefinition::ClassDefinition(ObjectHolder cls)
-    : cls_{std::move(cls)} {
+ClassDefinition::ClassDefinition(ObjectHolder cls, runtime::Slot slot)
+    : cls_{std::move(cls)}, slot_{slot} {
+    // ссылки на класс копируются в переменные всех потоков, выполняющих программу
+    cls_.ShareWithThreads();
 }
 
-ObjectHolder ClassDefinition::Execute(Closure &closure, [[maybe_unused]] Context &context) {
-    closure[cls_.TryAs<runtime::Class>()->GetName()] = cls_;
+void ClassDefinition::SetClass(ObjectHolder cls) {
+    cls_ = std::move(cls);
+    cls_.ShareWithThreads();
+}
+
+ObjectHolder ClassDefinition::Execute(Closure &closure, Context &context) {
+    if (slot_ != runtime::NO_SLOT) {
+        context.Local(slot_) = cls_;
+    } else {
+        CountClosureLookup(context);
+        closure[cls_.TryAs<runtime::Class>()->GetName()] = cls_;
+    }
     return ObjectHolder::None();
 }
 
-FieldAssignment::FieldAssignment(VariableValue object, std::string field_name,
+FieldAssignment::FieldAssignment(VariableValue object, runtime::Symbol field_name,
                                  std::unique_ptr<Statement> rv)
-    : object_{std::move(object)}, field_name_{std::move(field_name)}, rv_{std::move(rv)} {
+    : object_{std::move(object)}, field_name_{field_name}, rv_{std::move(rv)} {
 }
 
 ObjectHolder FieldAssignment::Execute(Closure &closure, Context &context) {
-    auto obj = object_.Execute(closure, context).TryAs<runtime::ClassInstance>();
-    if (obj) {
-        return obj->Fields()[field_name_] = rv_->Execute(closure, context);
+    ObjectHolder object = object_.Execute(closure, context);
+    if (auto obj = object.TryAs<runtime::ClassInstance>()) {
+        ObjectHolder value = rv_->Execute(closure, context);
+        obj->SetField(field_name_, value, cache_);
+        return value;
     } else {
         throw runtime_error("Object is not class!"s);
     }
@@ -209,35 +402,37 @@ IfElse::IfElse(std::unique_ptr<Statement> condition, std::unique_ptr<Statement>
 }
 
 ObjectHolder IfElse::Execute(Closure &closure, Context &context) {
+    return runtime::ClassInstance::CompleteTailCalls(Run(closure, context), context);
+}
+
+runtime::ExecResult IfElse::Run(Closure &closure, Context &context) {
     if (runtime::IsTrue(condition_->Execute(closure, context))) {
-        return if_body_->Execute(closure, context);
+        return if_body_->Run(closure, context);
     } else if (else_body_) {
-        return else_body_->Execute(closure, context);
+        return else_body_->Run(closure, context);
     }
-     return runtime::ObjectHolder::None();
+    return {};
 }
 
 ObjectHolder Or::Execute(Closure &closure, Context &context) {
     if (runtime::IsTrue(lhs_->Execute(closure, context)))
         {
-            return ObjectHolder::Own(runtime::Bool(true));
+            return runtime::MakeBool(true);
         }
-        return ObjectHolder::Own(runtime::Bool(runtime::IsTrue
-                                               (rhs_->Execute(closure, context))));
+        return runtime::MakeBool(runtime::IsTrue(rhs_->Execute(closure, context)));
 }
 
 ObjectHolder And::Execute(Closure &closure, Context &context) {
     if (runtime::IsTrue(lhs_->Execute(closure, context)))
         {
-        return ObjectHolder::Own(runtime::Bool(runtime::IsTrue
-                                               (rhs_->Execute(closure, context))));
+        return runtime::MakeBool(runtime::IsTrue(rhs_->Execute(closure, context)));
         }
-        return ObjectHolder::Own(runtime::Bool(false));
+        return runtime::MakeBool(false);
 }
 
 ObjectHolder Not::Execute(Closure &closure, Context &context) {
     bool result = !runtime::IsTrue(argument_->Execute(closure, context));
-    return ObjectHolder::Own(runtime::Bool(result));
+    return runtime::MakeBool(result);
 }
 
 Comparison::Comparison(Comparator cmp, unique_ptr<Statement> lhs, unique_ptr<Statement> rhs)
@@ -247,12 +442,25 @@ Comparison::Comparison(Comparator cmp, unique_ptr<Statement> lhs, unique_ptr<Sta
 
 ObjectHolder Comparison::Execute(Closure &closure, Context &context) {
     auto result = cmp_(lhs_->Execute(closure, context), rhs_->Execute(closure, context), context);
-    return runtime::ObjectHolder::Own(runtime::Bool(result));
+    return runtime::MakeBool(result);
 }
 
 NewInstance::NewInstance(const runtime::Class& class_,
                          std::vector<std::unique_ptr<Statement>> args)
-    : class_instance_{class_}, args_{std::move(args)} {
+    : args_{std::move(args)} {
+    SetClass(class_);
+}
+
+NewInstance::NewInstance(std::vector<std::unique_ptr<Statement>> args)
+    : args_{std::move(args)} {
+}
+
+void NewInstance::SetClass(const runtime::Class& class_) {
+    this->class_ = &class_;
+    init_ = class_.GetMethod(INIT_METHOD);
+    if (init_ != nullptr && init_->formal_params.size() != args_.size()) {
+        init_ = nullptr;
+    }
 }
 
 NewInstance::NewInstance(const runtime::Class &class_)
@@ -260,14 +468,15 @@ NewInstance::NewInstance(const runtime::Class &class_)
 }
 
 ObjectHolder NewInstance::Execute(Closure &closure, Context &context) {
-    if (class_instance_.HasMethod(INIT_METHOD, args_.size())) {
-        std::vector<runtime::ObjectHolder> actual_args;
+    ObjectHolder instance = class_->CreateInstance();
+    if (init_ != nullptr) {
+        runtime::ArgumentBuffer actual_args;
         for (auto &arg : args_) {
             actual_args.push_back(arg->Execute(closure, context));
         }
-        class_instance_.Call(INIT_METHOD, actual_args, context);
+        instance.TryAs<runtime::ClassInstance>()->Call(*init_, actual_args, context);
     }
-    return runtime::ObjectHolder::Share(class_instance_);
+    return instance;
 }
 
 MethodBody::MethodBody(std::unique_ptr<Statement> &&body)
@@ -275,14 +484,21 @@ MethodBody::MethodBody(std::unique_ptr<Statement> &&body)
 }
 
 ObjectHolder MethodBody::Execute(Closure &closure, Context &context) {
-    try {
-        body_->Execute(closure, context);
-        return runtime::ObjectHolder::None();
-    }  catch (runtime::ObjectHolder &result) {
-        return result;
-    }  catch (...) {
-        throw;
+    return runtime::ClassInstance::CompleteTailCalls(Run(closure, context), context);
+}
+
+runtime::ExecResult MethodBody::Run(Closure &closure, Context &context) {
+    auto result = body_->Run(closure, context);
+    switch (result.status) {
+        case runtime::ExecStatus::Normal:
+            return {};
+        case runtime::ExecStatus::Return:
+            result.status = runtime::ExecStatus::Normal;
+            break;
+        case runtime::ExecStatus::TailCall:
+            break;
     }
+    return result;
 }
 
 }  // namespace ast
@@ -1,5 +1,6 @@
 #include "statement.h"
 
+#include <alloc_counter_p.h>
 #include <test_runner_p.h>
 
 using namespace std;
@@ -309,6 +310,31 @@ void TestCompound() {
     ASSERT(context.output.str().empty());
 }
 
+void TestReturnFromNestedCompound() {
+    runtime::DummyContext context;
+
+    auto if_body = make_unique<Compound>(
+        make_unique<Assignment>("x"s, make_unique<NumericConst>(1)),
+        make_unique<Return>(make_unique<VariableValue>("x"s)),
+        make_unique<Assignment>("x"s, make_unique<NumericConst>(2)));
+    MethodBody body{make_unique<Compound>(
+        make_unique<IfElse>(make_unique<BoolConst>(runtime::Bool(true)), std::move(if_body),
+                            nullptr),
+        make_unique<Assignment>("y"s, make_unique<NumericConst>(3)))};
+
+    Closure closure;
+    auto result = body.Execute(closure, context);
+    ASSERT_OBJECT_VALUE_EQUAL(result, 1);
+    ASSERT_OBJECT_VALUE_EQUAL(closure.at("x"s), 1);
+    ASSERT(closure.find("y"s) == closure.end());
+
+    MethodBody no_return{make_unique<Assignment>("z"s, make_unique<NumericConst>(4))};
+    ASSERT(!no_return.Execute(closure, context));
+    ASSERT_OBJECT_VALUE_EQUAL(closure.at("z"s), 4);
+
+    ASSERT(context.output.str().empty());
+}
+
 void TestFields() {
     runtime::DummyContext context;
 
@@ -454,6 +480,69 @@ void TestNot() {
     test_not(false);
 }
 
+void TestArena() {
+    Arena arena;
+    ASSERT_EQUAL(arena.BytesUsed(), 0U);
+
+    // узлы в арене и в куче уничтожаются одинаково
+    unique_ptr<Statement> in_arena(new (arena) Add(make_unique<NumericConst>(2),
+                                                   unique_ptr<Statement>(new (arena) NumericConst(3))));
+    unique_ptr<Statement> on_heap = make_unique<StringConst>("heap"s);
+    const size_t used = arena.BytesUsed();
+    ASSERT(used >= sizeof(Add) + sizeof(NumericConst));
+
+    vector<unique_ptr<Statement>> many;
+    for (int i = 0; i < 10000; ++i) {
+        many.emplace_back(new (arena) NumericConst(i));
+    }
+    ASSERT(arena.BytesUsed() >= used + 10000 * sizeof(NumericConst));
+
+    Closure closure;
+    runtime::DummyContext context;
+    ASSERT_OBJECT_VALUE_EQUAL(in_arena->Execute(closure, context), 5);
+    ASSERT_OBJECT_VALUE_EQUAL(on_heap->Execute(closure, context), "heap"s);
+    ASSERT_OBJECT_VALUE_EQUAL(many.back()->Execute(closure, context), 9999);
+    in_arena.reset();
+    on_heap.reset();
+}
+
+void TestSmallValuesDoNotAllocate() {
+    Closure closure;
+    runtime::DummyContext context;
+
+    Add small_sum{make_unique<NumericConst>(400), make_unique<NumericConst>(623)};
+    Mult big_product{make_unique<NumericConst>(1000), make_unique<NumericConst>(1000)};
+    Comparison less{runtime::Less, make_unique<NumericConst>(1), make_unique<NumericConst>(2)};
+    Not not_statement{make_unique<BoolConst>(false)};
+    Or or_statement{make_unique<BoolConst>(false), make_unique<NumericConst>(1)};
+
+    ASSERT_OBJECT_VALUE_EQUAL(small_sum.Execute(closure, context), 1023);
+    ASSERT_OBJECT_VALUE_EQUAL(less.Execute(closure, context), "True"s);
+
+    {
+        bool all_true = true;
+        alloc_counter::AllocationScope allocations;
+        for (int i = 0; i < 100; ++i) {
+            ObjectHolder sum = small_sum.Execute(closure, context);
+            all_true = all_true && runtime::IsTrue(less.Execute(closure, context))
+                       && runtime::IsTrue(not_statement.Execute(closure, context))
+                       && runtime::IsTrue(or_statement.Execute(closure, context));
+        }
+        size_t count = allocations.Count();
+        ASSERT(all_true);
+        ASSERT_EQUAL(count, 0U);
+    }
+
+    // числа хранятся внутри ObjectHolder независимо от величины
+    alloc_counter::AllocationScope allocations;
+    ObjectHolder product = big_product.Execute(closure, context);
+    ObjectHolder copy = product;
+    size_t count = allocations.Count();
+    ASSERT_OBJECT_VALUE_EQUAL(copy, 1000000);
+    ASSERT(copy.TryAs<runtime::Number>() != product.TryAs<runtime::Number>());
+    ASSERT_EQUAL(count, 0U);
+}
+
 }  // namespace
 
 void RunUnitTests(TestRunner& tr) {
@@ -471,12 +560,15 @@ void RunUnitTests(TestRunner& tr) {
     RUN_TEST(tr, ast::TestSuccessfulClassInstanceAdd);
     RUN_TEST(tr, ast::TestClassInstanceAddWithoutMethod);
     RUN_TEST(tr, ast::TestCompound);
+    RUN_TEST(tr, ast::TestReturnFromNestedCompound);
     RUN_TEST(tr, ast::TestFields);
     RUN_TEST(tr, ast::TestBaseClass);
     RUN_TEST(tr, ast::TestInheritance);
     RUN_TEST(tr, ast::TestOr);
     RUN_TEST(tr, ast::TestAnd);
     RUN_TEST(tr, ast::TestNot);
+    RUN_TEST(tr, ast::TestSmallValuesDoNotAllocate);
+    RUN_TEST(tr, ast::TestArena);
 }
 
 }  // namespace ast
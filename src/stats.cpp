@@ -0,0 +1,63 @@
+#include "stats.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace runtime {
+
+StatsSnapshot& StatsSnapshot::operator+=(const StatsSnapshot& other) {
+    statements += other.statements;
+    method_calls += other.method_calls;
+    objects_allocated += other.objects_allocated;
+    objects_destroyed += other.objects_destroyed;
+    closure_lookups += other.closure_lookups;
+    output_bytes += other.output_bytes;
+    return *this;
+}
+
+StatsSnapshot StatCounters::Load() const {
+    auto get = [this](Counter counter) {
+        return values_[counter].load(memory_order_relaxed);
+    };
+    StatsSnapshot result;
+    result.statements = get(STATEMENTS);
+    result.method_calls = get(METHOD_CALLS);
+    result.objects_allocated = get(OBJECTS_ALLOCATED);
+    result.objects_destroyed = get(OBJECTS_DESTROYED);
+    result.closure_lookups = get(CLOSURE_LOOKUPS);
+    result.output_bytes = get(OUTPUT_BYTES);
+    return result;
+}
+
+StatsSnapshot ExecutionStats::Collect() const {
+    lock_guard lock(mutex_);
+    StatsSnapshot result = detached_;
+    for (const auto& counters : active_) {
+        result += counters->Load();
+    }
+    return result;
+}
+
+StatCounters* ExecutionStats::Attach() {
+    // счётчики создаются потоком, который будет выполнять контекст,
+    // и запоминают его количество объектов как начальное
+    auto counters = make_unique<StatCounters>();
+    lock_guard lock(mutex_);
+    active_.push_back(std::move(counters));
+    return active_.back().get();
+}
+
+void ExecutionStats::Detach(StatCounters* counters) {
+    counters->SyncObjects();
+    lock_guard lock(mutex_);
+    auto it = find_if(active_.begin(), active_.end(), [counters](const auto& item) {
+        return item.get() == counters;
+    });
+    if (it != active_.end()) {
+        detached_ += (*it)->Load();
+        active_.erase(it);
+    }
+}
+
+}  // namespace runtime
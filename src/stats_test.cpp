@@ -0,0 +1,133 @@
+#include "stats.h"
+
+#include "interpreter.h"
+
+#include <test_runner_p.h>
+
+#include <thread>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+const string_view PROGRAM = R"(
+class Point:
+  def __init__(x):
+    self.x = x
+
+class Fib:
+  def calc(n):
+    if n < 2:
+      p = Point(n)
+      return p.x
+    return self.calc(n - 1) + self.calc(n - 2)
+
+c = Fib()
+print c.calc(10)
+)"sv;
+
+StatsSnapshot RunWithStats(const mython::Program& program) {
+    ExecutionStats stats;
+    DummyContext context;
+    context.SetStats(&stats);
+    {
+        Closure closure;
+        mython::Run(program, context, closure);
+        ASSERT_EQUAL(context.output.str(), "55\n"s);
+    }
+    // уничтожение объектов из closure учитывается при отключении статистики
+    context.SetStats(nullptr);
+    return stats.Collect();
+}
+
+void TestCounters() {
+    for (auto engine : {mython::Engine::Ast, mython::Engine::Vm}) {
+        auto stats = RunWithStats(mython::Compile(PROGRAM, {engine}));
+        ASSERT_EQUAL(stats.method_calls, 177U + 89U);
+        ASSERT_EQUAL(stats.objects_allocated, 89U + 1U);
+        ASSERT_EQUAL(stats.LiveObjects(), 0);
+        // объявления двух классов, присваивание и чтение переменной c
+        ASSERT_EQUAL(stats.closure_lookups, 4U);
+        ASSERT_EQUAL(stats.output_bytes, 3U);
+        if (engine == mython::Engine::Ast) {
+            ASSERT(stats.statements > stats.method_calls);
+        } else {
+            ASSERT_EQUAL(stats.statements, 0U);
+        }
+    }
+}
+
+void TestDisabled() {
+    auto program = mython::Compile(PROGRAM);
+    ExecutionStats stats;
+    DummyContext context;
+    Closure closure;
+    mython::Run(program, context, closure);
+    ASSERT(context.GetStatCounters() == nullptr);
+    auto result = stats.Collect();
+    ASSERT_EQUAL(result.statements, 0U);
+    ASSERT_EQUAL(result.method_calls, 0U);
+}
+
+void TestLiveObjects() {
+    auto program = mython::Compile(PROGRAM);
+    ExecutionStats stats;
+    DummyContext context;
+    context.SetStats(&stats);
+    Closure closure;
+    mython::Run(program, context, closure);
+    // объект c ещё хранится в closure
+    context.CountOutput();
+    context.GetStatCounters()->SyncObjects();
+    ASSERT_EQUAL(stats.Collect().LiveObjects(), 1);
+    closure.clear();
+    context.SetStats(nullptr);
+    ASSERT_EQUAL(stats.Collect().LiveObjects(), 0);
+}
+
+void TestThreads() {
+    constexpr size_t thread_count = 4;
+    auto program = mython::Compile(PROGRAM, {mython::Engine::Vm});
+    auto single = RunWithStats(program);
+
+    ExecutionStats stats;
+    vector<thread> threads;
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads.emplace_back([&program, &stats] {
+            DummyContext context;
+            context.SetStats(&stats);
+            Closure closure;
+            mython::Run(program, context, closure);
+        });
+    }
+    // статистику можно собирать, пока программы выполняются
+    [[maybe_unused]] auto running = stats.Collect();
+    for (auto& t : threads) {
+        t.join();
+    }
+    auto total = stats.Collect();
+    ASSERT_EQUAL(total.method_calls, single.method_calls * thread_count);
+    ASSERT_EQUAL(total.objects_allocated, single.objects_allocated * thread_count);
+    ASSERT_EQUAL(total.closure_lookups, single.closure_lookups * thread_count);
+    ASSERT_EQUAL(total.output_bytes, single.output_bytes * thread_count);
+    ASSERT_EQUAL(total.LiveObjects(), 0);
+}
+
+void TestCountersArePadded() {
+    static_assert(alignof(StatCounters) == CACHE_LINE_SIZE);
+    ASSERT_EQUAL(sizeof(StatCounters) % CACHE_LINE_SIZE, 0U);
+}
+
+}  // namespace
+
+void RunStatsTests(TestRunner& tr) {
+    RUN_TEST(tr, runtime::TestCounters);
+    RUN_TEST(tr, runtime::TestDisabled);
+    RUN_TEST(tr, runtime::TestLiveObjects);
+    RUN_TEST(tr, runtime::TestThreads);
+    RUN_TEST(tr, runtime::TestCountersArePadded);
+}
+
+}  // namespace runtime
@@ -0,0 +1,21 @@
+#include "stats.h"
+#include "test_runner_p.h"
+
+#include <iostream>
+
+using namespace std;
+
+namespace runtime {
+void RunStatsTests(TestRunner& tr);
+}
+
+int main() {
+    try {
+        TestRunner tr;
+        runtime::RunStatsTests(tr);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include "symbol.h"
+
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+
+namespace runtime {
+
+namespace {
+
+// Глобальная таблица интернированных имён. Строки никогда не удаляются, поэтому
+// адреса строк остаются действительными всё время работы программы
+class SymbolTable {
+public:
+    static SymbolTable& Instance() {
+        static SymbolTable table;
+        return table;
+    }
+
+    const std::string* Intern(std::string_view name) {
+        std::lock_guard guard(mutex_);
+        auto it = names_.find(name);
+        if (it == names_.end()) {
+            auto stored = std::make_unique<const std::string>(name);
+            it = names_.emplace(*stored, std::move(stored)).first;
+        }
+        return it->second.get();
+    }
+
+private:
+    std::mutex mutex_;
+    // ключи ссылаются на строки, которыми владеют значения
+    std::unordered_map<std::string_view, std::unique_ptr<const std::string>> names_;
+};
+
+// Возвращает интернированную строку name. Строки, уже интернированные текущим потоком,
+// находятся в его собственном кэше без захвата общей блокировки таблицы, поэтому потоки,
+// параллельно разбирающие части программы, не ждут друг друга
+const std::string* InternCached(std::string_view name) {
+    thread_local std::unordered_map<std::string_view, const std::string*> cache;
+    if (auto it = cache.find(name); it != cache.end()) {
+        return it->second;
+    }
+    const std::string* interned = SymbolTable::Instance().Intern(name);
+    cache.emplace(*interned, interned);
+    return interned;
+}
+
+}  // namespace
+
+Symbol::Symbol() {
+    static const std::string* const empty = SymbolTable::Instance().Intern({});
+    name_ = empty;
+}
+
+Symbol::Symbol(std::string_view name) : name_(InternCached(name)) {
+}
+
+std::ostream& operator<<(std::ostream& os, const Symbol& symbol) {
+    return os << symbol.Name();
+}
+
+}  // namespace runtime
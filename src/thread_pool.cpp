@@ -0,0 +1,87 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+
+using namespace std;
+
+namespace mython {
+
+WorkStealingPool::WorkStealingPool(size_t thread_count)
+    : thread_count_(thread_count > 0 ? thread_count
+                                     : max<size_t>(thread::hardware_concurrency(), 1)) {
+}
+
+bool WorkStealingPool::Pop(vector<Queue>& queues, size_t worker, size_t& task, bool& stolen) {
+    {
+        auto& own = queues[worker];
+        lock_guard lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            stolen = false;
+            return true;
+        }
+    }
+    // очереди других потоков просматриваются начиная со следующей, чтобы потоки
+    // не выбирали одну и ту же жертву
+    for (size_t offset = 1; offset < queues.size(); ++offset) {
+        auto& victim = queues[(worker + offset) % queues.size()];
+        lock_guard lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            stolen = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::Run(size_t count, const function<void(size_t)>& task) {
+    size_t workers = min(thread_count_, max<size_t>(count, 1));
+    vector<Queue> queues(workers);
+    // соседние задачи достаются одному потоку: обычно они похожи по длительности
+    for (size_t index = 0; index < count; ++index) {
+        queues[index * workers / count].tasks.push_front(index);
+    }
+
+    atomic<size_t> stolen{0};
+    mutex error_mutex;
+    exception_ptr error;
+    auto work = [&](size_t worker) {
+        size_t index = 0;
+        bool was_stolen = false;
+        while (Pop(queues, worker, index, was_stolen)) {
+            if (was_stolen) {
+                stolen.fetch_add(1, memory_order_relaxed);
+            }
+            try {
+                task(index);
+            } catch (...) {
+                lock_guard lock(error_mutex);
+                if (!error) {
+                    error = current_exception();
+                }
+            }
+        }
+    };
+
+    vector<thread> threads;
+    threads.reserve(workers - 1);
+    for (size_t worker = 1; worker < workers; ++worker) {
+        threads.emplace_back(work, worker);
+    }
+    work(0);
+    for (auto& t : threads) {
+        t.join();
+    }
+    stolen_ = stolen.load(memory_order_relaxed);
+    if (error) {
+        rethrow_exception(error);
+    }
+}
+
+}  // namespace mython
@@ -0,0 +1,495 @@
+#include "vm.h"
+
+#include "budget.h"
+#include "profiler.h"
+
+#include <optional>
+#include <ostream>
+#include <sstream>
+
+using namespace std;
+
+#if defined(__GNUC__) || defined(__clang__)
+// Диспетчеризация через таблицу адресов меток (расширение GCC/Clang) вместо switch
+#define MYTHON_COMPUTED_GOTO 1
+#endif
+
+namespace vm {
+
+using runtime::ClassInstance;
+using runtime::Closure;
+using runtime::ObjectHolder;
+
+namespace {
+const runtime::Symbol ADD_METHOD{"__add__"sv};
+const runtime::Symbol INIT_METHOD{"__init__"sv};
+const runtime::Symbol STR_METHOD{"__str__"sv};
+const runtime::Symbol EQ_METHOD{"__eq__"sv};
+const runtime::Symbol LESS_METHOD{"__lt__"sv};
+}  // namespace
+
+VirtualMachine::VirtualMachine(const Program& program, runtime::Context& context)
+    : program_(program),
+      context_(context),
+      counters_(context.GetStatCounters()),
+      budget_(context.GetBudget()) {
+}
+
+void VirtualMachine::Run(Closure& globals) {
+    Execute(program_.Main(), 0, &globals);
+    stack_.clear();
+}
+
+void VirtualMachine::Reserve(size_t size) {
+    if (stack_.size() < size) {
+        stack_.resize(std::max(size, stack_.size() * 2));
+    }
+}
+
+ObjectHolder VirtualMachine::Execute(const Chunk& entry, size_t base, Closure* globals) {
+    // хвостовой вызов заменяет chunk кадра и начинает выполнение заново
+    const Chunk* chunk = &entry;
+    size_t frame_end = 0;
+    const Instruction* code = nullptr;
+    const Instruction* ip = nullptr;
+    size_t sp = 0;
+    auto enter_frame = [&]() {
+        frame_end = base + chunk->locals_count + chunk->max_stack;
+        Reserve(frame_end + 1);
+        for (size_t i = base + 1 + chunk->params_count; i < base + chunk->locals_count; ++i) {
+            stack_[i] = runtime::Undefined();
+        }
+        code = chunk->code.data();
+        ip = code;
+        sp = base + chunk->locals_count;
+        // без переходов назад байт-код выполняется не дольше своей длины,
+        // поэтому бюджет шагов учитывается один раз при входе
+        if (budget_ != nullptr) {
+            budget_->Step(static_cast<uint32_t>(chunk->code.size()));
+        }
+    };
+    enter_frame();
+
+    // освобождает значения, оставшиеся в кадре начиная с позиции from
+    auto release_frame = [this, &frame_end](size_t from) {
+        for (size_t i = from; i <= frame_end; ++i) {
+            stack_[i] = ObjectHolder::None();
+        }
+    };
+
+#ifdef MYTHON_COMPUTED_GOTO
+    static void* const dispatch_table[] = {
+#define MYTHON_OPCODE_LABEL(name) &&op_##name,
+        MYTHON_OPCODES(MYTHON_OPCODE_LABEL)
+#undef MYTHON_OPCODE_LABEL
+    };
+#define VM_CASE(name) op_##name:
+#define VM_DISPATCH() goto* dispatch_table[static_cast<size_t>(ip->op)]
+#define VM_LOOP_BEGIN VM_DISPATCH();
+#define VM_LOOP_END
+#else
+#define VM_CASE(name) case OpCode::name:
+#define VM_DISPATCH() continue
+#define VM_LOOP_BEGIN \
+    for (;;) {        \
+        switch (ip->op) {
+#define VM_LOOP_END \
+    }               \
+    }
+#endif
+#define VM_NEXT() \
+    ++ip;         \
+    VM_DISPATCH()
+#define VM_JUMP(target)    \
+    ip = code + (target); \
+    VM_DISPATCH()
+
+#define VM_ARITHMETIC(op, message)                                                    \
+    {                                                                                 \
+        auto l = stack_[sp - 2].TryAs<runtime::Number>();                             \
+        auto r = stack_[sp - 1].TryAs<runtime::Number>();                             \
+        if (!l || !r) {                                                               \
+            throw std::runtime_error(message);                                        \
+        }                                                                             \
+        stack_[sp - 2] = runtime::MakeNumber(l->GetValue() op r->GetValue());         \
+        --sp;                                                                         \
+    }
+
+#define VM_COMPARISON(expr)                       \
+    {                                             \
+        bool result = (expr);                     \
+        stack_[sp - 2] = runtime::MakeBool(result);        \
+        --sp;                                     \
+    }
+
+    VM_LOOP_BEGIN
+
+    VM_CASE(Const) {
+        stack_[sp++] = chunk->constants[ip->a];
+        VM_NEXT();
+    }
+    VM_CASE(None) {
+        stack_[sp++] = ObjectHolder::None();
+        VM_NEXT();
+    }
+    VM_CASE(True) {
+        stack_[sp++] = runtime::MakeBool(true);
+        VM_NEXT();
+    }
+    VM_CASE(False) {
+        stack_[sp++] = runtime::MakeBool(false);
+        VM_NEXT();
+    }
+    VM_CASE(LoadGlobal) {
+        CountClosureLookup();
+        auto it = globals->find(chunk->names[ip->a]);
+        if (it == globals->end()) {
+            throw std::runtime_error("Variable "s + chunk->names[ip->a].Name() + " not found"s);
+        }
+        stack_[sp++] = it->second;
+        VM_NEXT();
+    }
+    VM_CASE(StoreGlobal) {
+        CountClosureLookup();
+        auto& variable = (*globals)[chunk->names[ip->a]];
+        variable = stack_[sp - 1];
+        // глобальная переменная может пережить программу, которой принадлежит константа
+        variable.MakeOwning();
+        VM_NEXT();
+    }
+    VM_CASE(LoadLocal) {
+        const auto& value = stack_[base + ip->a];
+        if (runtime::IsUndefined(value)) {
+            throw std::runtime_error("Variable "s + chunk->names[ip->b].Name() + " not found"s);
+        }
+        stack_[sp++] = value;
+        VM_NEXT();
+    }
+    VM_CASE(StoreLocal) {
+        stack_[base + ip->a] = stack_[sp - 1];
+        VM_NEXT();
+    }
+    VM_CASE(LoadField) {
+        auto* object = stack_[sp - 1].TryAs<ClassInstance>();
+        if (object == nullptr) {
+            throw std::runtime_error("Variable "s + chunk->names[ip->b].Name() + " is not class"s);
+        }
+        auto* field = object->FindField(chunk->names[ip->a],
+                                        chunk->field_caches[ip - code]);
+        if (field == nullptr) {
+            throw std::runtime_error("Variable "s + chunk->names[ip->a].Name() + " not found"s);
+        }
+        // значение копируется до того, как stack_[sp - 1] перестанет владеть объектом
+        ObjectHolder value = *field;
+        stack_[sp - 1] = std::move(value);
+        VM_NEXT();
+    }
+    VM_CASE(StoreField) {
+        auto* object = stack_[sp - 2].TryAs<ClassInstance>();
+        if (object == nullptr) {
+            throw std::runtime_error("Object is not class!"s);
+        }
+        object->SetField(chunk->names[ip->a], stack_[sp - 1],
+                         chunk->field_caches[ip - code]);
+        stack_[sp - 2] = std::move(stack_[sp - 1]);
+        --sp;
+        VM_NEXT();
+    }
+    VM_CASE(Pop) {
+        --sp;
+        VM_NEXT();
+    }
+    VM_CASE(Add) {
+        const auto& lhs = stack_[sp - 2];
+        const auto& rhs = stack_[sp - 1];
+        if (auto l = lhs.TryAs<runtime::Number>(), r = rhs.TryAs<runtime::Number>(); l && r) {
+            stack_[sp - 2] = runtime::MakeNumber(l->GetValue() + r->GetValue());
+        } else if (auto ls = lhs.TryAs<runtime::String>(), rs = rhs.TryAs<runtime::String>();
+                   ls && rs) {
+            stack_[sp - 2] = runtime::String::Concat(*ls, *rs);
+            if (budget_ != nullptr) {
+                budget_->CheckHeap();
+            }
+        } else if (lhs.TryAs<ClassInstance>()) {
+            CallMethod(sp - 2, ADD_METHOD, 1);
+        } else {
+            throw std::runtime_error(
+                "Can add only numbers, strings and class instances with "s + ADD_METHOD.Name());
+        }
+        --sp;
+        VM_NEXT();
+    }
+    VM_CASE(Sub) {
+        VM_ARITHMETIC(-, "Can subtract only numbers"s);
+        VM_NEXT();
+    }
+    VM_CASE(Mult) {
+        VM_ARITHMETIC(*, "Can multiply only numbers"s);
+        VM_NEXT();
+    }
+    VM_CASE(Div) {
+        if (auto r = stack_[sp - 1].TryAs<runtime::Number>(); r && r->GetValue() == 0) {
+            throw std::runtime_error("Division by zero"s);
+        }
+        VM_ARITHMETIC(/, "Can divide only numbers"s);
+        VM_NEXT();
+    }
+    VM_CASE(Equal) {
+        VM_COMPARISON(Equal(sp, sp - 2, sp - 1));
+        VM_NEXT();
+    }
+    VM_CASE(NotEqual) {
+        VM_COMPARISON(!Equal(sp, sp - 2, sp - 1));
+        VM_NEXT();
+    }
+    VM_CASE(Less) {
+        VM_COMPARISON(Less(sp, sp - 2, sp - 1));
+        VM_NEXT();
+    }
+    VM_CASE(Greater) {
+        VM_COMPARISON(!(Less(sp, sp - 2, sp - 1) || Equal(sp, sp - 2, sp - 1)));
+        VM_NEXT();
+    }
+    VM_CASE(LessOrEqual) {
+        VM_COMPARISON(Less(sp, sp - 2, sp - 1) || Equal(sp, sp - 2, sp - 1));
+        VM_NEXT();
+    }
+    VM_CASE(GreaterOrEqual) {
+        VM_COMPARISON(!Less(sp, sp - 2, sp - 1));
+        VM_NEXT();
+    }
+    VM_CASE(Compare) {
+        VM_COMPARISON(chunk->comparators[ip->a](stack_[sp - 2], stack_[sp - 1], context_));
+        VM_NEXT();
+    }
+    VM_CASE(Not) {
+        stack_[sp - 1] = runtime::MakeBool(!runtime::IsTrue(stack_[sp - 1]));
+        VM_NEXT();
+    }
+    VM_CASE(ToBool) {
+        stack_[sp - 1] = runtime::MakeBool(runtime::IsTrue(stack_[sp - 1]));
+        VM_NEXT();
+    }
+    VM_CASE(Jump) {
+        VM_JUMP(ip->a);
+    }
+    VM_CASE(JumpIfFalse) {
+        if (!runtime::IsTrue(stack_[--sp])) {
+            VM_JUMP(ip->a);
+        }
+        VM_NEXT();
+    }
+    VM_CASE(JumpIfTrue) {
+        if (runtime::IsTrue(stack_[--sp])) {
+            VM_JUMP(ip->a);
+        }
+        VM_NEXT();
+    }
+    VM_CASE(PrintSpace) {
+        context_.GetOutputStream().put(' ');
+        VM_NEXT();
+    }
+    VM_CASE(PrintItem) {
+        PrintValue(sp, context_.GetOutputStream(), stack_[sp - 1]);
+        --sp;
+        VM_NEXT();
+    }
+    VM_CASE(PrintEnd) {
+        context_.GetOutputStream().put('\n');
+        context_.CountOutput();
+        if (auto* buffer = context_.GetOutputBuffer()) {
+            buffer->EndLine();
+        }
+        stack_[sp++] = ObjectHolder::None();
+        VM_NEXT();
+    }
+    VM_CASE(Stringify) {
+        // строки неизменяемы, поэтому str от строки возвращает её саму
+        if (stack_[sp - 1].TryAs<runtime::String>() == nullptr) {
+            stack_[sp - 1] = ObjectHolder::Own(runtime::String(ToString(sp, stack_[sp - 1])));
+        }
+        VM_NEXT();
+    }
+    VM_CASE(CallMethod) {
+        size_t receiver = sp - ip->b - 1;
+        CallMethod(receiver, chunk->names[ip->a], ip->b, &chunk->method_caches[ip - code]);
+        sp = receiver + 1;
+        VM_NEXT();
+    }
+    VM_CASE(TailCall) {
+        const size_t receiver = sp - ip->b - 1;
+        const uint32_t argc = ip->b;
+        auto& cache = chunk->method_caches[ip - code];
+        const runtime::Method& mtd = LookupMethod(receiver, chunk->names[ip->a], argc, &cache);
+        const Chunk* callee = program_.FindMethod(mtd.body.get());
+        if (callee == nullptr || mtd.memo != nullptr || context_.GetProfiler() != nullptr) {
+            // вызов, который нельзя выполнить в текущем кадре, выполняется как обычный
+            CallMethod(receiver, chunk->names[ip->a], argc, &cache);
+            ObjectHolder result = std::move(stack_[receiver]);
+            release_frame(base + 1);
+            return result;
+        }
+        if (counters_ != nullptr) {
+            counters_->CountMethodCall();
+        }
+        // объект и аргументы вызова занимают место self и параметров текущего метода
+        for (size_t i = 0; i <= argc; ++i) {
+            stack_[base + i] = std::move(stack_[receiver + i]);
+            stack_[base + i].MakeOwning();
+        }
+        release_frame(base + argc + 1);
+        chunk = callee;
+        enter_frame();
+        VM_DISPATCH();
+    }
+    VM_CASE(NewInstance) {
+        stack_[sp++] = chunk->classes[ip->a]->CreateInstance();
+        VM_NEXT();
+    }
+    VM_CASE(Construct) {
+        size_t receiver = sp - ip->a - 1;
+        ObjectHolder instance = stack_[receiver];
+        CallMethod(receiver, INIT_METHOD, ip->a, &chunk->method_caches[ip - code]);
+        stack_[receiver] = std::move(instance);
+        sp = receiver + 1;
+        VM_NEXT();
+    }
+    VM_CASE(DefineClass) {
+        CountClosureLookup();
+        (*globals)[chunk->names[ip->b]] = chunk->constants[ip->a];
+        stack_[sp++] = ObjectHolder::None();
+        VM_NEXT();
+    }
+    VM_CASE(Return) {
+        ObjectHolder result = std::move(stack_[sp - 1]);
+        release_frame(base + 1);
+        return result;
+    }
+    VM_CASE(ReturnNone) {
+        release_frame(base + 1);
+        return ObjectHolder::None();
+    }
+
+    VM_LOOP_END
+
+#undef VM_COMPARISON
+#undef VM_ARITHMETIC
+#undef VM_JUMP
+#undef VM_NEXT
+#undef VM_LOOP_END
+#undef VM_LOOP_BEGIN
+#undef VM_DISPATCH
+#undef VM_CASE
+}
+
+const runtime::Method& VirtualMachine::LookupMethod(size_t base, runtime::Symbol method,
+                                                    uint32_t argc, runtime::MethodCache* cache) {
+    auto* instance = stack_[base].TryAs<ClassInstance>();
+    if (instance == nullptr) {
+        throw std::runtime_error("Object is not class instance"s);
+    }
+    const runtime::Method* mtd = cache != nullptr
+                                     ? cache->Find(instance->GetClass(), method, argc)
+                                     : instance->GetClass().GetMethod(method);
+    if (mtd == nullptr || mtd->formal_params.size() != argc) {
+        throw std::runtime_error("No method "s + method.Name() + " in class "s
+                                 + instance->GetClass().GetName() + " with "s
+                                 + std::to_string(argc) + " arguments."s);
+    }
+    return *mtd;
+}
+
+void VirtualMachine::CallMethod(size_t base, runtime::Symbol method, uint32_t argc,
+                                runtime::MethodCache* cache) {
+    const runtime::Method* mtd = &LookupMethod(base, method, argc, cache);
+    auto* instance = stack_[base].TryAs<ClassInstance>();
+    if (const Chunk* chunk = program_.FindMethod(mtd->body.get())) {
+        ObjectHolder result;
+        if (counters_ != nullptr) {
+            counters_->CountMethodCall();
+        }
+        std::optional<runtime::Budget::CallScope> call_scope;
+        if (budget_ != nullptr) {
+            call_scope.emplace(*budget_);
+        }
+        std::string key;
+        bool memoized = mtd->memo != nullptr
+                        && runtime::MemoCache::MakeKey(stack_.data() + base + 1, argc, key);
+        if (memoized) {
+            if (auto cached = mtd->memo->Find(key)) {
+                for (size_t i = base + 1; i <= base + argc; ++i) {
+                    stack_[i] = ObjectHolder::None();
+                }
+                stack_[base] = std::move(*cached);
+                return;
+            }
+        }
+        if (runtime::Profiler* profiler = context_.GetProfiler(); profiler != nullptr) {
+            runtime::Profiler::Scope scope(*profiler, instance->GetClass(), *mtd);
+            result = Execute(*chunk, base, nullptr);
+        } else {
+            result = Execute(*chunk, base, nullptr);
+        }
+        result.MakeOwning();
+        if (memoized) {
+            mtd->memo->Insert(std::move(key), result);
+        }
+        stack_[base] = std::move(result);
+    } else {
+        // аргументы перемещаются со стека в кадр метода до того, как стек может измениться
+        ObjectHolder result = instance->Call(
+            *mtd, runtime::Arguments::Move(stack_.data() + base + 1, argc), context_);
+        stack_[base] = std::move(result);
+    }
+}
+
+ObjectHolder VirtualMachine::Invoke(size_t top, runtime::Symbol method,
+                                    std::initializer_list<ObjectHolder> values) {
+    Reserve(top + values.size());
+    size_t index = top;
+    for (const auto& value : values) {
+        stack_[index++] = value;
+    }
+    CallMethod(top, method, static_cast<uint32_t>(values.size() - 1));
+    return std::move(stack_[top]);
+}
+
+bool VirtualMachine::Equal(size_t top, size_t lhs, size_t rhs) {
+    if (stack_[lhs].TryAs<ClassInstance>()) {
+        return runtime::IsTrue(Invoke(top, EQ_METHOD, {stack_[lhs], stack_[rhs]}));
+    }
+    return runtime::Equal(stack_[lhs], stack_[rhs], context_);
+}
+
+bool VirtualMachine::Less(size_t top, size_t lhs, size_t rhs) {
+    if (stack_[lhs].TryAs<ClassInstance>()) {
+        return runtime::IsTrue(Invoke(top, LESS_METHOD, {stack_[lhs], stack_[rhs]}));
+    }
+    return runtime::Less(stack_[lhs], stack_[rhs], context_);
+}
+
+void VirtualMachine::PrintValue(size_t top, std::ostream& os, const ObjectHolder& value) {
+    if (auto* instance = value.TryAs<ClassInstance>()) {
+        if (instance->HasMethod(STR_METHOD, 0U)) {
+            ObjectHolder str = Invoke(top, STR_METHOD, {value});
+            PrintValue(top, os, str);
+        } else {
+            os << value.Get();
+        }
+    } else {
+        runtime::PrintValue(value, os, context_);
+    }
+}
+
+std::string VirtualMachine::ToString(size_t top, const ObjectHolder& value) {
+    if (auto* instance = value.TryAs<ClassInstance>(); instance && instance->HasMethod(STR_METHOD, 0U)) {
+        return ToString(top, Invoke(top, STR_METHOD, {value}));
+    }
+    return runtime::ToString(value, context_);
+}
+
+void Run(const Program& program, Closure& globals, runtime::Context& context) {
+    VirtualMachine(program, context).Run(globals);
+}
+
+}  // namespace vm
@@ -0,0 +1,328 @@
+#include "bytecode.h"
+#include "lexer.h"
+#include "parse.h"
+#include "statement.h"
+#include "vm.h"
+
+#include <test_runner_p.h>
+
+using namespace std;
+
+namespace vm {
+
+namespace {
+
+string RunAst(const string& program) {
+    istringstream is(program);
+    parse::Lexer lexer(is);
+    auto tree = ParseProgram(lexer);
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    tree->Execute(closure, context);
+    return context.output.str();
+}
+
+string RunVm(const string& program) {
+    istringstream is(program);
+    parse::Lexer lexer(is);
+    auto tree = ParseProgram(lexer);
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    Run(Compile(*tree), closure, context);
+    return context.output.str();
+}
+
+// Проверяет, что виртуальная машина выводит то же, что и интерпретатор дерева
+void AssertSameOutput(const string& program, const string& expected) {
+    ASSERT_EQUAL(RunAst(program), expected);
+    ASSERT_EQUAL(RunVm(program), expected);
+}
+
+void TestPrintsAndArithmetics() {
+    AssertSameOutput(R"(
+print 57
+print 10, 24, -8
+print 'hello', "world"
+print True, False
+print
+print None
+print 1+2+3+4+5, 1*2*3*4*5, 1-2-3-4-5, 36/4/3, 2*5+10/2
+print str(42) + str(None) + str(True)
+)",
+                     "57\n10 24 -8\nhello world\nTrue False\n\nNone\n15 120 -13 3 15\n42NoneTrue\n"s);
+}
+
+void TestGlobalsAndConditions() {
+    AssertSameOutput(R"(
+x = 4
+y = 5
+if x > y:
+  print "x > y"
+else:
+  print "x <= y"
+if x > 0:
+  if y < 0:
+    print "y < 0"
+  else:
+    print "y >= 0"
+print x == 4, x != 4, x <= 4, x >= 5, x < y
+print x > 1 and y > 1, x > 10 or y > 10, not x > 1
+print 'abc' < 'abd', True > False
+)",
+                     "x <= y\ny >= 0\nTrue False True False True\nTrue False False\nTrue True\n"s);
+}
+
+void TestClassesAndRecursion() {
+    AssertSameOutput(R"(
+class GCD:
+  def __init__():
+    self.call_count = 0
+
+  def calc(a, b):
+    self.call_count = self.call_count + 1
+    if a < b:
+      return self.calc(b, a)
+    if b == 0:
+      return a
+    return self.calc(a - b, b)
+
+x = GCD()
+print x.calc(510510, 18629977)
+print x.calc(22, 17)
+print x.call_count
+)",
+                     "17\n1\n115\n"s);
+}
+
+void TestPolymorphismAndSpecialMethods() {
+    AssertSameOutput(R"(
+class Shape:
+  def __str__():
+    return "Shape"
+
+  def area():
+    return 0
+
+class Rect(Shape):
+  def __init__(w, h):
+    self.w = w
+    self.h = h
+
+  def __str__():
+    return "Rect(" + str(self.w) + 'x' + str(self.h) + ')'
+
+  def area():
+    return self.w * self.h
+
+  def __eq__(other):
+    return self.area() == other.area()
+
+  def __lt__(other):
+    return self.area() < other.area()
+
+  def __add__(other):
+    return self.area() + other.area()
+
+class Square(Rect):
+  def __init__(a):
+    self.w = a
+    self.h = a
+
+r = Rect(2, 8)
+s = Square(4)
+print r, s, Shape(), str(s)
+print r == s, r != s, r < s, r > s, r <= s, r >= s
+print r + s
+)",
+                     "Rect(2x8) Rect(4x4) Shape Rect(4x4)\n"
+                     "True False False False True True\n32\n"s);
+}
+
+void TestFieldChains() {
+    AssertSameOutput(R"(
+class Node:
+  def __init__(value):
+    self.value = value
+    self.next = None
+
+  def link(node):
+    self.next = node
+    return self
+
+  def local_vars(x):
+    y = x + 1
+    z = y * 2
+    return y + z
+
+third = Node(3)
+second = Node(2)
+head = Node(1)
+second.link(third)
+head.link(second)
+print head.value, head.next.value, head.next.next.value, head.next.next.next
+print head.local_vars(10)
+)",
+                     "1 2 3 None\n33\n"s);
+}
+
+void TestPrintOrder() {
+    // аргументы print вычисляются и выводятся по очереди
+    AssertSameOutput(R"(
+class Logger:
+  def log(message):
+    print message
+    return message
+
+l = Logger()
+print l.log('a'), l.log('b')
+)",
+                     "a\na b\nb\n"s);
+}
+
+void TestRuntimeErrors() {
+    auto assert_throws_everywhere = [](const string& program) {
+        ASSERT_THROWS(RunAst(program), std::runtime_error);
+        ASSERT_THROWS(RunVm(program), std::runtime_error);
+    };
+    assert_throws_everywhere("print 1 / 0\n"s);
+    assert_throws_everywhere("print unknown\n"s);
+    assert_throws_everywhere("print 1 + 'a'\n"s);
+    assert_throws_everywhere(R"(
+class A:
+  def f():
+    return y
+
+A().f()
+)"s);
+    assert_throws_everywhere(R"(
+class A:
+  def f(x):
+    return x
+
+A().f()
+)"s);
+}
+
+void TestMemoizedMethods() {
+    // аргументы-объекты не запоминаются, и метод каждый раз выполняется заново
+    AssertSameOutput(R"(
+class Counter:
+  def __init__():
+    self.n = 0
+
+class Math:
+  @memoize
+  def binomial(n, k):
+    if k == 0 or k == n:
+      return 1
+    return self.binomial(n - 1, k - 1) + self.binomial(n - 1, k)
+
+  @memoize
+  def bump(counter):
+    counter.n = counter.n + 1
+    return counter.n
+
+m = Math()
+c = Counter()
+print m.binomial(30, 15), m.binomial(30, 15)
+print m.bump(c), m.bump(c)
+)"s,
+                     "155117520 155117520\n1 2\n"s);
+}
+
+void TestTailCalls() {
+    // глубина цепочки хвостовых вызовов не ограничена размером стека
+    AssertSameOutput(R"(
+class Step:
+  def __init__(value):
+    self.value = value
+
+  def run(n, acc):
+    if n == 0:
+      return acc + self.value
+    return self.run(n - 1, acc + 1)
+
+class Loop:
+  def count(n, acc):
+    if n == 0:
+      return acc
+    return self.count(n - 1, acc + 1)
+
+  def even(n):
+    if n == 0:
+      return True
+    else:
+      return self.odd(n - 1)
+
+  def odd(n):
+    if n == 0:
+      return False
+    return self.even(n - 1)
+
+  def delegate(n):
+    step = Step(n)
+    return step.run(n, 0)
+
+  def nested(n):
+    return self.count(self.count(n, 0), 1)
+
+  def me():
+    return self
+
+  @memoize
+  def fib(n):
+    if n < 2:
+      return n
+    return self.fib(n - 1) + self.fib(n - 2)
+
+  def tail_fib(n):
+    return self.fib(n)
+
+l = Loop()
+print l.count(200000, 0), l.even(200001), l.odd(200001)
+print l.delegate(100000), l.nested(1000), l.tail_fib(40)
+m = l.me()
+print m.count(3, 0)
+if l.even(2):
+  return l.count(5, 0)
+print 'unreachable'
+)"s,
+                     "200000 False True\n200000 1001 102334155\n3\n"s);
+
+    istringstream is("class A:\n  def f(n):\n    return self.f(n)\n"s);
+    parse::Lexer lexer(is);
+    ostringstream listing;
+    Compile(*ParseProgram(lexer)).Disassemble(listing);
+    ASSERT(listing.str().find("TailCall"s) != string::npos);
+}
+
+void TestDisassemble() {
+    istringstream is("x = 1 + 2\nprint x\n"s);
+    parse::Lexer lexer(is);
+    auto program = Compile(*ParseProgram(lexer));
+
+    ostringstream listing;
+    program.Disassemble(listing);
+    ASSERT(listing.str().find("Add"s) != string::npos);
+    ASSERT(listing.str().find("StoreGlobal"s) != string::npos);
+    ASSERT(listing.str().find("PrintEnd"s) != string::npos);
+}
+
+}  // namespace
+
+void RunVmTests(TestRunner& tr) {
+    RUN_TEST(tr, vm::TestPrintsAndArithmetics);
+    RUN_TEST(tr, vm::TestGlobalsAndConditions);
+    RUN_TEST(tr, vm::TestClassesAndRecursion);
+    RUN_TEST(tr, vm::TestPolymorphismAndSpecialMethods);
+    RUN_TEST(tr, vm::TestFieldChains);
+    RUN_TEST(tr, vm::TestPrintOrder);
+    RUN_TEST(tr, vm::TestRuntimeErrors);
+    RUN_TEST(tr, vm::TestMemoizedMethods);
+    RUN_TEST(tr, vm::TestTailCalls);
+    RUN_TEST(tr, vm::TestDisassemble);
+}
+
+}  // namespace vm
@@ -0,0 +1,21 @@
+#include "vm.h"
+#include "test_runner_p.h"
+
+#include <iostream>
+
+using namespace std;
+
+namespace vm {
+void RunVmTests(TestRunner& tr);
+}
+
+int main() {
+    try {
+        TestRunner tr;
+        vm::RunVmTests(tr);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}